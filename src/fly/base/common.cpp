@@ -22,6 +22,7 @@
 #include <random>
 #include <netinet/in.h>
 #include <sys/stat.h>
+#include <time.h>
 #include "fly/base/common.hpp"
 #include "cryptopp/base64.h"
 #include "cryptopp/sha.h"
@@ -260,5 +261,29 @@ uint64 ntohll(uint64 n)
     return (((uint64)ntohl((uint32)n)) << 32) | ntohl(n >> 32);
 }
 
+uint64 monotonic_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64 monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64 monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 }
 }
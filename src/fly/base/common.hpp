@@ -96,6 +96,9 @@ void split_string(const std::string &str, const char *split, std::vector<std::st
 int32 mkpath(std::string s, mode_t mode = 0755);
 uint64 htonll(uint64 n);
 uint64 ntohll(uint64 n);
+uint64 monotonic_ms();
+uint64 monotonic_us();
+uint64 monotonic_ns();
 
 }
 }
@@ -0,0 +1,215 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 15:10:26                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <cstdio>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "fly/base/cpu_topology.hpp"
+
+namespace fly {
+namespace base {
+
+//parses the sysfs cpu list format, e.g. "0-3,8,10-11"
+static std::vector<uint32> parse_cpu_list(const std::string &list)
+{
+    std::vector<uint32> cpus;
+    std::stringstream ss(list);
+    std::string range;
+
+    while(std::getline(ss, range, ','))
+    {
+        uint32 first = 0, last = 0;
+        int32 num = sscanf(range.c_str(), "%u-%u", &first, &last);
+
+        if(num < 1)
+        {
+            continue;
+        }
+
+        if(num == 1)
+        {
+            last = first;
+        }
+        
+        for(uint32 cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+std::vector<uint32> allowed_cpus()
+{
+    std::vector<uint32> cpus;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+
+    if(sched_getaffinity(0, sizeof(cpu_set), &cpu_set) < 0)
+    {
+        return cpus;
+    }
+
+    for(uint32 cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if(CPU_ISSET(cpu, &cpu_set))
+        {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+std::vector<uint32> physical_cores()
+{
+    std::vector<uint32> allowed = allowed_cpus();
+    std::vector<uint32> cores;
+    std::vector<uint32> seen;
+
+    for(auto cpu : allowed)
+    {
+        if(std::find(seen.begin(), seen.end(), cpu) != seen.end())
+        {
+            continue;
+        }
+        
+        std::ifstream file("/sys/devices/system/cpu/cpu" + to_string(cpu) + "/topology/thread_siblings_list");
+        std::string list;
+        std::getline(file, list);
+        std::vector<uint32> siblings = parse_cpu_list(list);
+        seen.insert(seen.end(), siblings.begin(), siblings.end());
+        cores.push_back(cpu);
+    }
+
+    return cores;
+}
+
+int32 cpu_node(uint32 cpu)
+{
+    DIR *dir = opendir(("/sys/devices/system/cpu/cpu" + to_string(cpu)).c_str());
+
+    if(dir == NULL)
+    {
+        return -1;
+    }
+
+    int32 node = -1;
+    
+    while(struct dirent *entry = readdir(dir))
+    {
+        if(sscanf(entry->d_name, "node%d", &node) == 1)
+        {
+            break;
+        }
+    }
+
+    closedir(dir);
+
+    return node;
+}
+
+bool pin_thread(const std::vector<uint32> &cpus)
+{
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+
+    for(auto cpu : cpus)
+    {
+        CPU_SET(cpu, &cpu_set);
+    }
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+}
+
+//set_mempolicy is called directly, so libnuma isn't needed
+bool prefer_node(int32 node)
+{
+    if(node < 0)
+    {
+        return syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0) == 0;
+    }
+
+    unsigned long node_mask[16] = {0};
+    const uint32 BITS = sizeof(unsigned long) * 8;
+
+    if((uint32)node >= 16 * BITS)
+    {
+        return false;
+    }
+    
+    node_mask[node / BITS] = 1UL << (node % BITS);
+
+    return syscall(SYS_set_mempolicy, MPOL_PREFERRED, node_mask, 16 * BITS) == 0;
+}
+
+bool save_mempolicy(Mem_Policy &policy)
+{
+    const uint32 BITS = sizeof(unsigned long) * 8;
+
+    return syscall(SYS_get_mempolicy, &policy.m_mode, policy.m_node_mask, 16 * BITS, NULL, 0) == 0;
+}
+
+bool restore_mempolicy(const Mem_Policy &policy)
+{
+    const uint32 BITS = sizeof(unsigned long) * 8;
+    
+    if(policy.m_mode == MPOL_DEFAULT)
+    {
+        return syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0) == 0;
+    }
+
+    return syscall(SYS_set_mempolicy, policy.m_mode, policy.m_node_mask, 16 * BITS) == 0;
+}
+
+std::vector<std::vector<uint32>> cpu_layout(uint32 num)
+{
+    std::vector<std::vector<uint32>> layout;
+    std::vector<uint32> cores = physical_cores();
+
+    if(cores.empty())
+    {
+        return layout;
+    }
+
+    if(num == 0)
+    {
+        num = cores.size();
+    }
+    
+    for(uint32 i = 0; i < num; ++i)
+    {
+        layout.push_back({cores[i % cores.size()]});
+    }
+
+    return layout;
+}
+
+}
+}
@@ -0,0 +1,63 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 15:10:26                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__BASE__CPU_TOPOLOGY
+#define FLY__BASE__CPU_TOPOLOGY
+
+#include <vector>
+#include "fly/base/common.hpp"
+
+namespace fly {
+namespace base {
+
+//logical cpus the process is allowed to run on
+std::vector<uint32> allowed_cpus();
+
+//one allowed logical cpu per physical core, smt siblings are skipped
+std::vector<uint32> physical_cores();
+
+//numa node of a logical cpu, -1 if the system doesn't report it
+int32 cpu_node(uint32 cpu);
+
+//pins the calling thread to the cpus
+bool pin_thread(const std::vector<uint32> &cpus);
+
+//the following page faults of the calling thread prefer the node, -1 restores the default local policy
+bool prefer_node(int32 node);
+
+//memory policy of a thread, as saved by save_mempolicy
+struct Mem_Policy
+{
+    int32 m_mode = 0;
+    unsigned long m_node_mask[16] = {0};
+};
+
+//saves the memory policy of the calling thread, so it can be put back after prefer_node
+bool save_mempolicy(Mem_Policy &policy);
+bool restore_mempolicy(const Mem_Policy &policy);
+
+//one physical core per executor, num == 0 means one executor per physical core
+std::vector<std::vector<uint32>> cpu_layout(uint32 num = 0);
+
+}
+}
+
+#endif
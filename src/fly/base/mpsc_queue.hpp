@@ -0,0 +1,265 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 13:40:05                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__BASE__MPSC_QUEUE
+#define FLY__BASE__MPSC_QUEUE
+
+#include <atomic>
+#include <vector>
+#include <new>
+#include <type_traits>
+#include "fly/base/common.hpp"
+
+namespace fly {
+namespace base {
+
+//lock-free multi-producer single-consumer queue on a chain of fixed size segments. a producer claims a slot with
+//one fetch_add and publishes it with a release store, the consumer takes the finished slots in claim order.
+//drained segments are kept by the consumer and linked back in as spares, so once the chain has grown to the
+//peak backlog a push allocates nothing. segments are only freed with the queue, a producer may still hold a
+//stale pointer to one it found as the tail
+template<typename T, uint32 SEGMENT_SIZE = 64>
+class MPSC_Queue
+{
+public:
+    MPSC_Queue()
+    {
+        m_head = new Segment;
+        m_tail.store(m_head, std::memory_order_relaxed);
+    }
+    
+    MPSC_Queue(const MPSC_Queue&) = delete;
+    MPSC_Queue& operator=(const MPSC_Queue&) = delete;
+
+    ~MPSC_Queue()
+    {
+        Segment *segment = m_head;
+        uint32 pos = m_pos;
+        
+        while(segment != nullptr)
+        {
+            for(; pos < SEGMENT_SIZE; ++pos)
+            {
+                if(segment->m_slots[pos].m_ready.load(std::memory_order_acquire))
+                {
+                    segment->m_slots[pos].value()->~T();
+                }
+            }
+            
+            Segment *next = segment->m_next.load(std::memory_order_acquire);
+            delete segment;
+            segment = next;
+            pos = 0;
+        }
+
+        for(auto *retired : m_retired)
+        {
+            delete retired;
+        }
+
+        for(auto *spare : m_spares)
+        {
+            delete spare;
+        }
+    }
+    
+    void push(T element)
+    {
+        while(true)
+        {
+            Segment *segment = m_tail.load();
+
+            //announce the use first, the consumer won't recycle a segment somebody is in
+            segment->m_users.fetch_add(1);
+            
+            if(m_tail.load() != segment)
+            {
+                segment->m_users.fetch_sub(1, std::memory_order_release);
+
+                continue;
+            }
+            
+            uint32 idx = segment->m_claimed.fetch_add(1, std::memory_order_relaxed);
+
+            if(idx < SEGMENT_SIZE)
+            {
+                Slot &slot = segment->m_slots[idx];
+                new (&slot.m_storage) T(std::move(element));
+                slot.m_ready.store(true, std::memory_order_release);
+                segment->m_users.fetch_sub(1, std::memory_order_release);
+
+                return;
+            }
+
+            //full, move the tail on, linking a new segment if the consumer left no spare
+            Segment *next = segment->m_next.load(std::memory_order_acquire);
+
+            if(next == nullptr)
+            {
+                Segment *fresh = new Segment;
+
+                if(segment->m_next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+                {
+                    next = fresh;
+                }
+                else
+                {
+                    delete fresh;
+                }
+            }
+
+            Segment *expected = segment;
+            m_tail.compare_exchange_strong(expected, next);
+            segment->m_users.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    //appends all the elements finished so far to queue, in claim order. a slot still being written stops the
+    //take, its producer hasn't returned from push yet and signals the consumer after it
+    bool pop(std::vector<T> &queue)
+    {
+        std::size_t size = queue.size();
+        
+        while(true)
+        {
+            if(m_pos == SEGMENT_SIZE)
+            {
+                Segment *next = m_head->m_next.load(std::memory_order_acquire);
+
+                if(next == nullptr)
+                {
+                    break;
+                }
+
+                m_retired.push_back(m_head);
+                m_head = next;
+                m_pos = 0;
+            }
+
+            Slot &slot = m_head->m_slots[m_pos];
+
+            if(!slot.m_ready.load(std::memory_order_acquire))
+            {
+                break;
+            }
+
+            queue.push_back(std::move(*slot.value()));
+            slot.value()->~T();
+            slot.m_ready.store(false, std::memory_order_relaxed);
+            ++m_pos;
+        }
+
+        if(!m_retired.empty())
+        {
+            recycle();
+        }
+        
+        return queue.size() > size;
+    }
+
+    //only meaningful on the consumer thread
+    bool empty()
+    {
+        Segment *segment = m_head;
+        uint32 pos = m_pos;
+
+        if(pos == SEGMENT_SIZE)
+        {
+            segment = segment->m_next.load(std::memory_order_acquire);
+            pos = 0;
+
+            if(segment == nullptr)
+            {
+                return true;
+            }
+        }
+
+        return !segment->m_slots[pos].m_ready.load(std::memory_order_acquire);
+    }
+    
+private:
+    struct Slot
+    {
+        T* value()
+        {
+            return reinterpret_cast<T*>(&m_storage);
+        }
+        
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+        std::atomic<bool> m_ready {false};
+    };
+
+    struct Segment
+    {
+        std::atomic<uint32> m_claimed {0};
+        std::atomic<uint32> m_users {0};
+        std::atomic<Segment*> m_next {nullptr};
+        Slot m_slots[SEGMENT_SIZE];
+    };
+
+    //a drained segment is reusable once the tail has moved past it and no producer is in it. the spares are
+    //linked after the tail in one chain, the producer filling it up moves straight on
+    void recycle()
+    {
+        Segment *tail = m_tail.load();
+        
+        for(auto iter = m_retired.begin(); iter != m_retired.end();)
+        {
+            Segment *segment = *iter;
+            
+            if(segment == tail || segment->m_users.load() != 0)
+            {
+                ++iter;
+
+                continue;
+            }
+
+            segment->m_claimed.store(0, std::memory_order_relaxed);
+            segment->m_next.store(m_spares.empty() ? nullptr : m_spares.back(), std::memory_order_relaxed);
+            m_spares.push_back(segment);
+            iter = m_retired.erase(iter);
+        }
+
+        if(m_spares.empty())
+        {
+            return;
+        }
+
+        Segment *expected = nullptr;
+
+        //a producer may have linked a new one first, then the spares wait for the next time
+        if(tail->m_next.compare_exchange_strong(expected, m_spares.back(), std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+            m_spares.clear();
+        }
+    }
+    
+    std::atomic<Segment*> m_tail;
+    Segment *m_head;
+    uint32 m_pos = 0;
+    std::vector<Segment*> m_retired;
+    std::vector<Segment*> m_spares;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,260 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 10:12:37                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "fly/base/timer_wheel.hpp"
+
+namespace fly {
+namespace base {
+
+Timer_Wheel::Timer_Wheel(uint32 tick_ms)
+{
+    m_tick_ms = tick_ms == 0 ? 1 : tick_ms;
+    m_current = monotonic_ms() / m_tick_ms;
+}
+
+Timer_Wheel::~Timer_Wheel()
+{
+    for(auto &iter : m_nodes)
+    {
+        delete iter.second;
+    }
+}
+
+//interval_ms > 0 makes a repeating timer, the id is chosen by the caller
+void Timer_Wheel::add(uint64 id, uint32 delay_ms, uint32 interval_ms, std::function<void()> cb)
+{
+    cancel(id);
+    Timer_Node *node = new Timer_Node;
+    node->m_id = id;
+    node->m_expire = (monotonic_ms() + delay_ms + m_tick_ms - 1) / m_tick_ms;
+    node->m_interval = (interval_ms + m_tick_ms - 1) / m_tick_ms;
+
+    if(interval_ms > 0 && node->m_interval == 0)
+    {
+        node->m_interval = 1;
+    }
+    
+    node->m_cb = cb;
+    m_nodes[id] = node;
+    insert(node);
+}
+
+bool Timer_Wheel::cancel(uint64 id)
+{
+    auto iter = m_nodes.find(id);
+
+    if(iter == m_nodes.end())
+    {
+        return false;
+    }
+
+    Timer_Node *node = iter->second;
+    m_nodes.erase(iter);
+
+    //canceled from inside its own callback, freed once the callback returns
+    if(node == m_running)
+    {
+        m_running_canceled = true;
+
+        return true;
+    }
+    
+    unlink(node);
+    delete node;
+
+    return true;
+}
+
+void Timer_Wheel::link(Timer_Node **head, Timer_Node *node)
+{
+    node->m_head = head;
+    node->m_prev = nullptr;
+    node->m_next = *head;
+
+    if(*head != nullptr)
+    {
+        (*head)->m_prev = node;
+    }
+
+    *head = node;
+}
+
+void Timer_Wheel::unlink(Timer_Node *node)
+{
+    if(node->m_prev != nullptr)
+    {
+        node->m_prev->m_next = node->m_next;
+    }
+    else
+    {
+        *node->m_head = node->m_next;
+    }
+
+    if(node->m_next != nullptr)
+    {
+        node->m_next->m_prev = node->m_prev;
+    }
+}
+
+void Timer_Wheel::insert(Timer_Node *node)
+{
+    uint64 expire = node->m_expire < m_current ? m_current : node->m_expire;
+    uint64 delta = expire - m_current;
+
+    if(delta < (1ULL << ROOT_BITS))
+    {
+        link(&m_slots[0][expire & ((1 << ROOT_BITS) - 1)], node);
+
+        return;
+    }
+
+    for(uint32 level = 1; level < LEVEL_NUM; ++level)
+    {
+        uint32 shift = ROOT_BITS + LEVEL_BITS * level;
+
+        //too far away, park it in the last level, it will be put back when cascaded down
+        if(level == LEVEL_NUM - 1 && delta >= (1ULL << shift))
+        {
+            expire = m_current + (1ULL << shift) - 1;
+        }
+        
+        if(delta < (1ULL << shift) || level == LEVEL_NUM - 1)
+        {
+            link(&m_slots[level][(expire >> (shift - LEVEL_BITS)) & ((1 << LEVEL_BITS) - 1)], node);
+
+            return;
+        }
+    }
+}
+
+//moves the timers of the current slot of level down to the lower levels
+uint32 Timer_Wheel::cascade(uint32 level)
+{
+    uint32 index = (m_current >> (ROOT_BITS + LEVEL_BITS * (level - 1))) & ((1 << LEVEL_BITS) - 1);
+    Timer_Node *node = m_slots[level][index];
+    m_slots[level][index] = nullptr;
+
+    while(node != nullptr)
+    {
+        Timer_Node *next = node->m_next;
+        insert(node);
+        node = next;
+    }
+
+    return index;
+}
+
+void Timer_Wheel::advance(uint64 now_ms)
+{
+    uint64 now_tick = now_ms / m_tick_ms;
+    
+    while(m_current <= now_tick)
+    {
+        uint32 index = m_current & ((1 << ROOT_BITS) - 1);
+
+        if(index == 0)
+        {
+            for(uint32 level = 1; level < LEVEL_NUM && cascade(level) == 0; ++level);
+        }
+
+        //detach the slot first, callbacks may add timers which land in it again
+        Timer_Node *node = m_slots[0][index];
+        m_slots[0][index] = nullptr;
+        uint64 tick = m_current++;
+
+        while(node != nullptr)
+        {
+            Timer_Node *next = node->m_next;
+            link(&m_expired, node);
+            node = next;
+        }
+
+        while((node = m_expired) != nullptr)
+        {
+            unlink(node);
+
+            if(node->m_expire > tick)
+            {
+                insert(node);
+
+                continue;
+            }
+
+            m_running = node;
+            m_running_canceled = false;
+            node->m_cb();
+            m_running = nullptr;
+
+            if(m_running_canceled)
+            {
+                delete node;
+            }
+            else if(node->m_interval > 0)
+            {
+                node->m_expire = tick + node->m_interval;
+                insert(node);
+            }
+            else
+            {
+                m_nodes.erase(node->m_id);
+                delete node;
+            }
+        }
+    }
+}
+
+//ms to wait before the next slot holding timers (or the next cascade) is due, -1 if no timer
+int32 Timer_Wheel::next_timeout(uint64 now_ms)
+{
+    if(m_nodes.empty())
+    {
+        return -1;
+    }
+
+    uint64 tick = m_current;
+
+    for(uint32 i = 0; i < (1 << ROOT_BITS); ++i, ++tick)
+    {
+        uint32 index = tick & ((1 << ROOT_BITS) - 1);
+
+        if(m_slots[0][index] != nullptr || (index == 0 && i > 0))
+        {
+            break;
+        }
+    }
+    
+    uint64 expire_ms = tick * m_tick_ms;
+
+    return expire_ms > now_ms ? expire_ms - now_ms : 0;
+}
+
+uint32 Timer_Wheel::size()
+{
+    return m_nodes.size();
+}
+
+bool Timer_Wheel::empty()
+{
+    return m_nodes.empty();
+}
+
+}
+}
@@ -0,0 +1,78 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 10:12:37                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__BASE__TIMER_WHEEL
+#define FLY__BASE__TIMER_WHEEL
+
+#include <unordered_map>
+#include "fly/base/common.hpp"
+
+namespace fly {
+namespace base {
+
+//hierarchical timer wheel (256 + 3 * 64 slots), add/cancel/expire are O(1)
+//not thread safe, it's owned and driven by a single loop thread
+class Timer_Wheel
+{
+public:
+    Timer_Wheel(uint32 tick_ms = 10);
+    Timer_Wheel(const Timer_Wheel&) = delete;
+    Timer_Wheel& operator=(const Timer_Wheel&) = delete;
+    ~Timer_Wheel();
+    void add(uint64 id, uint32 delay_ms, uint32 interval_ms, std::function<void()> cb);
+    bool cancel(uint64 id);
+    void advance(uint64 now_ms);
+    int32 next_timeout(uint64 now_ms);
+    uint32 size();
+    bool empty();
+    static const uint32 ROOT_BITS = 8;
+    static const uint32 LEVEL_BITS = 6;
+    static const uint32 LEVEL_NUM = 4;
+    
+private:
+    struct Timer_Node
+    {
+        uint64 m_id;
+        uint64 m_expire;
+        uint32 m_interval;
+        std::function<void()> m_cb;
+        Timer_Node **m_head;
+        Timer_Node *m_prev;
+        Timer_Node *m_next;
+    };
+
+    void insert(Timer_Node *node);
+    void link(Timer_Node **head, Timer_Node *node);
+    void unlink(Timer_Node *node);
+    uint32 cascade(uint32 level);
+    uint32 m_tick_ms;
+    uint64 m_current;
+    Timer_Node *m_slots[LEVEL_NUM][1 << ROOT_BITS] = {};
+    Timer_Node *m_expired = nullptr;
+    Timer_Node *m_running = nullptr;
+    bool m_running_canceled = false;
+    std::unordered_map<uint64, Timer_Node*> m_nodes;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,63 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 09:12:40                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <algorithm>
+#include "fly/base/token_bucket.hpp"
+
+namespace fly {
+namespace base {
+
+//takes cost_ns worth of tokens and returns 0, or returns how many ns to wait until they are there
+//a cost above the burst is let through once the bucket is full, it would never fit otherwise
+uint64 Token_Bucket::consume(uint64 cost_ns, uint64 burst_ns, uint64 now_ns)
+{
+    uint64 limit = now_ns + std::max(cost_ns, burst_ns);
+    uint64 tat = m_tat.load(std::memory_order_relaxed);
+
+    while(true)
+    {
+        uint64 new_tat = std::max(tat, now_ns) + cost_ns;
+
+        if(new_tat > limit)
+        {
+            return new_tat - limit;
+        }
+
+        if(m_tat.compare_exchange_weak(tat, new_tat, std::memory_order_relaxed))
+        {
+            return 0;
+        }
+    }
+}
+
+//gives back tokens taken by a consume() whose message was rejected by another bucket
+void Token_Bucket::refund(uint64 cost_ns)
+{
+    m_tat.fetch_sub(cost_ns, std::memory_order_relaxed);
+}
+
+void Token_Bucket::reset()
+{
+    m_tat.store(0, std::memory_order_relaxed);
+}
+
+}
+}
@@ -0,0 +1,50 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 09:12:40                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__BASE__TOKEN_BUCKET
+#define FLY__BASE__TOKEN_BUCKET
+
+#include <atomic>
+#include "fly/base/common.hpp"
+
+namespace fly {
+namespace base {
+
+//token bucket kept as a single theoretical arrival time (gcra), so consume() is one cas and
+//may be called from any thread. costs are in ns: cost = tokens * 1e9 / rate, burst = burst_tokens * 1e9 / rate
+class Token_Bucket
+{
+public:
+    Token_Bucket() = default;
+    Token_Bucket(const Token_Bucket&) = delete;
+    Token_Bucket& operator=(const Token_Bucket&) = delete;
+    uint64 consume(uint64 cost_ns, uint64 burst_ns, uint64 now_ns);
+    void refund(uint64 cost_ns);
+    void reset();
+    
+private:
+    std::atomic<uint64> m_tat {0};
+};
+
+}
+}
+
+#endif
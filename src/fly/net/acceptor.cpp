@@ -27,6 +27,8 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include "fly/base/logger.hpp"
@@ -42,66 +44,166 @@ Acceptor<T>::Acceptor(const Addr &addr, std::function<void(std::shared_ptr<Conne
     m_cb = cb;
 }
 
+//only creates the nonblocking listen sockets, accept can then be driven by start() or by the pollers
+//more than one socket are bound to the same addr with SO_REUSEPORT, the kernel spreads connections among them
 template<typename T>
-bool Acceptor<T>::start()
+bool Acceptor<T>::listen(uint32 num)
 {
-    int32 listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    for(uint32 i = 0; i < num; ++i)
+    {
+        int32 listen_fd = new_listen_fd(num > 1);
+
+        if(listen_fd < 0)
+        {
+            return false;
+        }
+
+        m_listen_fds.push_back(listen_fd);
+    }
+
+    return true;
+}
+
+template<typename T>
+int32 Acceptor<T>::new_listen_fd(bool reuse_port)
+{
+    struct sockaddr_storage server_addr;
+    socklen_t server_addr_length = m_listen_addr.sock_addr(&server_addr);
+
+    if(server_addr_length == 0)
+    {
+        LOG_FATAL("listen addr %s is not an ip address or a valid unix socket path in Acceptor::listen", m_listen_addr.to_string().c_str());
+
+        return -1;
+    }
+
+    //unix sockets have no SO_REUSEPORT, a second bind would fail or replace the first socket file
+    if(reuse_port && m_listen_addr.family() == AF_UNIX)
+    {
+        LOG_FATAL("SO_REUSEPORT is not supported by unix sockets in Acceptor::listen, listen addr is %s", m_listen_addr.to_string().c_str());
+
+        return -1;
+    }
+    
+    int32 listen_fd = socket(m_listen_addr.family(), SOCK_STREAM, 0);
     
     if(listen_fd < 0)
     {
-        LOG_FATAL("socket failed in Acceptor::start, listen addr is %s:%d", m_listen_addr.m_host.c_str(), m_listen_addr.m_port);
+        LOG_FATAL("socket failed in Acceptor::listen, listen addr is %s", m_listen_addr.to_string().c_str());
         
-        return false;
+        return -1;
     }
     
+    //inherited by the accepted sockets, the receive buffer has to be set before listen for the window scale
+    m_socket_options.apply(listen_fd);
     int32 opt = 1;
     int32 opt_len = sizeof(opt);
 
     if(setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, opt_len) < 0)
     {
-        LOG_FATAL("setsockopt failed in Acceptor::start, listen addr is %s:%d", m_listen_addr.m_host.c_str(), m_listen_addr.m_port);
+        LOG_FATAL("setsockopt failed in Acceptor::listen, listen addr is %s", m_listen_addr.to_string().c_str());
         
-        return false;
+        return -1;
     }
-    
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    inet_pton(AF_INET, m_listen_addr.m_host.c_str(), &server_addr.sin_addr);
-    server_addr.sin_port = htons(m_listen_addr.m_port);
 
-    if(bind(listen_fd, (sockaddr*)&server_addr, sizeof(server_addr)) < 0)
+    if(reuse_port && setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, opt_len) < 0)
     {
-        LOG_FATAL("bind failed in Acceptor::start, listen addr is %s:%d", m_listen_addr.m_host.c_str(), m_listen_addr.m_port);
+        LOG_FATAL("setsockopt SO_REUSEPORT failed in Acceptor::listen, listen addr is %s", m_listen_addr.to_string().c_str());
         
-        return false;
+        return -1;
+    }
+    
+    if(m_listen_addr.family() == AF_UNIX)
+    {
+        remove_stale_socket_file((sockaddr*)&server_addr, server_addr_length);
     }
     
-    if(listen(listen_fd, SOMAXCONN) < 0)
+    if(bind(listen_fd, (sockaddr*)&server_addr, server_addr_length) < 0)
     {
-        LOG_FATAL("listen failed in Acceptor::start, listen addr is %s:%d", m_listen_addr.m_host.c_str(), m_listen_addr.m_port);
+        LOG_FATAL("bind failed in Acceptor::listen, listen addr is %s", m_listen_addr.to_string().c_str());
         
-        return false;
+        return -1;
+    }
+    
+    if(::listen(listen_fd, SOMAXCONN) < 0)
+    {
+        LOG_FATAL("listen failed in Acceptor::listen, listen addr is %s", m_listen_addr.to_string().c_str());
+        
+        return -1;
     }
 
     int32 flags = fcntl(listen_fd, F_GETFL, 0);
 
     if(flags == -1)
     {
-        LOG_FATAL("set listen fd to nonblock failed 1 in Acceptor::start, listen addr is %s:%d", m_listen_addr.m_host.c_str(), m_listen_addr.m_port);
+        LOG_FATAL("set listen fd to nonblock failed 1 in Acceptor::listen, listen addr is %s", m_listen_addr.to_string().c_str());
 
-        return false;
+        return -1;
     }
 
     flags |= O_NONBLOCK;
 
     if(fcntl(listen_fd, F_SETFL, flags) == -1)
     {
-        LOG_FATAL("set listen fd to nonblock failed 2 in Acceptor::start, listen addr is %s:%d", m_listen_addr.m_host.c_str(), m_listen_addr.m_port);
+        LOG_FATAL("set listen fd to nonblock failed 2 in Acceptor::listen, listen addr is %s", m_listen_addr.to_string().c_str());
         
+        return -1;
+    }
+    
+    return listen_fd;
+}
+
+//the socket file left behind by a server which didn't exit cleanly makes bind fail with EADDRINUSE. it's only
+//removed when nobody accepts on it anymore, a running server keeps its path
+template<typename T>
+void Acceptor<T>::remove_stale_socket_file(const sockaddr *addr, socklen_t length)
+{
+    const char *path = ((const sockaddr_un*)addr)->sun_path;
+    struct stat file_stat;
+    
+    if(path[0] == '\0' || stat(path, &file_stat) < 0 || !S_ISSOCK(file_stat.st_mode))
+    {
+        return;
+    }
+
+    int32 fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(fd < 0)
+    {
+        return;
+    }
+    
+    if(connect(fd, addr, length) < 0 && errno == ECONNREFUSED)
+    {
+        LOG_INFO("remove stale unix socket file %s in Acceptor::listen", path);
+        unlink(path);
+    }
+
+    close(fd);
+}
+
+template<typename T>
+const std::vector<int32>& Acceptor<T>::listen_fds()
+{
+    return m_listen_fds;
+}
+
+//applied to the listen sockets, call it before listen() or start()
+template<typename T>
+void Acceptor<T>::set_socket_options(const Socket_Options &options)
+{
+    m_socket_options = options;
+}
+
+template<typename T>
+bool Acceptor<T>::start()
+{
+    if(!listen())
+    {
         return false;
     }
 
+    int32 listen_fd = m_listen_fds[0];
     std::thread tmp([=]()
     {
         struct pollfd fds;
@@ -137,8 +239,8 @@ bool Acceptor<T>::start()
                 continue;
             }
 
-            struct sockaddr_in client_addr;
-            socklen_t length = sizeof(sockaddr_in);
+            struct sockaddr_storage client_addr;
+            socklen_t length = sizeof(client_addr);
             int32 client_fd = accept4(listen_fd, (sockaddr*)&client_addr, &length, SOCK_NONBLOCK);
 
             if(client_fd < 0)
@@ -153,11 +255,9 @@ bool Acceptor<T>::start()
                 continue;
             }
             
-            char host[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &client_addr.sin_addr, host, INET_ADDRSTRLEN);
-            uint16 port = ntohs(client_addr.sin_port);
-            LOG_DEBUG_INFO("new connection from %s:%d arrived", host, port);
-            m_cb(std::make_shared<Connection<T>>(client_fd, Addr(host, port)));
+            Addr peer_addr((sockaddr*)&client_addr, length);
+            LOG_DEBUG_INFO("new connection from %s arrived", peer_addr.to_string().c_str());
+            m_cb(std::make_shared<Connection<T>>(client_fd, peer_addr));
         }
     });
 
@@ -170,12 +270,24 @@ template<typename T>
 void Acceptor<T>::stop()
 {
     m_running.store(false, std::memory_order_relaxed);
+
+    //accept driven by the pollers, shutdown makes them drop the listen sockets at once
+    if(!m_thread.joinable())
+    {
+        for(auto listen_fd : m_listen_fds)
+        {
+            shutdown(listen_fd, SHUT_RDWR);
+        }
+    }
 }
 
 template<typename T>
 void Acceptor<T>::wait()
 {
-    m_thread.join();
+    if(m_thread.joinable())
+    {
+        m_thread.join();
+    }
 }
 
 template class Acceptor<Json>;
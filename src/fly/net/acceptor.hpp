@@ -24,7 +24,9 @@
 
 #include <memory>
 #include <thread>
+#include <vector>
 #include "fly/net/connection.hpp"
+#include "fly/net/socket_options.hpp"
 
 namespace fly {
 namespace net {
@@ -34,14 +36,21 @@ class Acceptor
 {
 public:
     Acceptor(const Addr &addr, std::function<void(std::shared_ptr<Connection<T>>)> cb);
+    bool listen(uint32 num = 1);
+    const std::vector<int32>& listen_fds();
+    void set_socket_options(const Socket_Options &options);
     bool start();
     void stop();
     void wait();
     
 private:
+    int32 new_listen_fd(bool reuse_port);
+    void remove_stale_socket_file(const sockaddr *addr, socklen_t length);
     std::function<void(std::shared_ptr<Connection<T>>)> m_cb;
     std::atomic<bool> m_running {true};
+    std::vector<int32> m_listen_fds;
     Addr m_listen_addr;
+    Socket_Options m_socket_options;
     std::thread m_thread;
 };
 
@@ -0,0 +1,236 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 14:52:10                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include "fly/net/addr.hpp"
+
+namespace fly {
+namespace net {
+
+Addr::Addr()
+{
+    memset(&m_in6, 0, sizeof(m_in6));
+    m_sa.sa_family = AF_UNSPEC;
+}
+
+//ipv4 or ipv6 literals (with or without brackets) are parsed right away, anything else is kept as a host name
+Addr::Addr(const std::string &host, uint16 port) : Addr()
+{
+    std::string literal = host.size() > 2 && host.front() == '[' && host.back() == ']' ? host.substr(1, host.size() - 2) : host;
+    
+    if(inet_pton(AF_INET, literal.c_str(), &m_in.sin_addr) == 1)
+    {
+        m_sa.sa_family = AF_INET;
+    }
+    else if(inet_pton(AF_INET6, literal.c_str(), &m_in6.sin6_addr) == 1)
+    {
+        m_sa.sa_family = AF_INET6;
+    }
+    else
+    {
+        m_path = host;
+    }
+
+    //sin_port and sin6_port share the offset, also used for the port of a host name
+    m_in.sin_port = htons(port);
+}
+
+Addr::Addr(const sockaddr *addr, socklen_t length) : Addr()
+{
+    if(addr->sa_family == AF_INET && length >= sizeof(sockaddr_in))
+    {
+        memcpy(&m_in, addr, sizeof(sockaddr_in));
+    }
+    else if(addr->sa_family == AF_INET6 && length >= sizeof(sockaddr_in6))
+    {
+        memcpy(&m_in6, addr, sizeof(sockaddr_in6));
+    }
+    else if(addr->sa_family == AF_UNIX)
+    {
+        m_sa.sa_family = AF_UNIX;
+        const sockaddr_un *un = (const sockaddr_un*)addr;
+        socklen_t path_length = length > offsetof(sockaddr_un, sun_path) ? length - offsetof(sockaddr_un, sun_path) : 0;
+
+        //an unbound peer has no path
+        if(path_length == 0)
+        {
+            return;
+        }
+        
+        if(un->sun_path[0] == '\0')
+        {
+            m_path = "@" + std::string(un->sun_path + 1, path_length - 1);
+        }
+        else
+        {
+            m_path.assign(un->sun_path, strnlen(un->sun_path, path_length));
+        }
+    }
+}
+
+//path starting with @ lives in the linux abstract namespace, it's not a file and vanishes with the last socket
+Addr Addr::unix_socket(const std::string &path)
+{
+    Addr addr;
+    addr.m_sa.sa_family = AF_UNIX;
+    addr.m_path = path;
+
+    return addr;
+}
+
+int32 Addr::family() const
+{
+    return m_sa.sa_family;
+}
+
+//the length of the sockaddr written to storage, 0 for an unresolved host name or a too long unix path
+socklen_t Addr::sock_addr(sockaddr_storage *storage) const
+{
+    if(m_sa.sa_family == AF_INET)
+    {
+        memcpy(storage, &m_in, sizeof(sockaddr_in));
+
+        return sizeof(sockaddr_in);
+    }
+
+    if(m_sa.sa_family == AF_INET6)
+    {
+        memcpy(storage, &m_in6, sizeof(sockaddr_in6));
+
+        return sizeof(sockaddr_in6);
+    }
+
+    if(m_sa.sa_family != AF_UNIX)
+    {
+        return 0;
+    }
+    
+    sockaddr_un *un = (sockaddr_un*)storage;
+
+    if(m_path.size() >= sizeof(un->sun_path))
+    {
+        return 0;
+    }
+    
+    memset(un, 0, sizeof(sockaddr_un));
+    un->sun_family = AF_UNIX;
+    memcpy(un->sun_path, m_path.data(), m_path.size());
+
+    //the abstract name is counted by the length, not terminated
+    if(!m_path.empty() && m_path[0] == '@')
+    {
+        un->sun_path[0] = '\0';
+
+        return offsetof(sockaddr_un, sun_path) + m_path.size();
+    }
+
+    return offsetof(sockaddr_un, sun_path) + m_path.size() + 1;
+}
+
+std::string Addr::host() const
+{
+    char host[INET6_ADDRSTRLEN];
+    
+    if(m_sa.sa_family == AF_INET)
+    {
+        return inet_ntop(AF_INET, &m_in.sin_addr, host, sizeof(host));
+    }
+
+    if(m_sa.sa_family == AF_INET6)
+    {
+        return inet_ntop(AF_INET6, &m_in6.sin6_addr, host, sizeof(host));
+    }
+
+    return m_path;
+}
+
+uint16 Addr::port() const
+{
+    return m_sa.sa_family == AF_UNIX ? 0 : ntohs(m_in.sin_port);
+}
+
+std::string Addr::to_string() const
+{
+    if(m_sa.sa_family == AF_UNIX)
+    {
+        return "unix:" + m_path;
+    }
+    
+    if(m_sa.sa_family == AF_INET6)
+    {
+        return "[" + host() + "]:" + fly::base::to_string(port());
+    }
+
+    return host() + ":" + fly::base::to_string(port());
+}
+
+//fnv-1a over the address bytes, the port is left out: all connections from one peer hash the same
+uint64 Addr::host_hash() const
+{
+    const uint8 *data = (const uint8*)m_path.data();
+    uint32 length = m_path.size();
+
+    if(m_sa.sa_family == AF_INET)
+    {
+        data = (const uint8*)&m_in.sin_addr;
+        length = sizeof(m_in.sin_addr);
+    }
+    else if(m_sa.sa_family == AF_INET6)
+    {
+        data = (const uint8*)&m_in6.sin6_addr;
+        length = sizeof(m_in6.sin6_addr);
+    }
+    
+    uint64 hash = 14695981039346656037ULL;
+
+    for(uint32 i = 0; i < length; ++i)
+    {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+bool Addr::operator==(const Addr &other) const
+{
+    if(m_sa.sa_family != other.m_sa.sa_family)
+    {
+        return false;
+    }
+
+    if(m_sa.sa_family == AF_INET)
+    {
+        return m_in.sin_port == other.m_in.sin_port && m_in.sin_addr.s_addr == other.m_in.sin_addr.s_addr;
+    }
+
+    if(m_sa.sa_family == AF_INET6)
+    {
+        return m_in6.sin6_port == other.m_in6.sin6_port && memcmp(&m_in6.sin6_addr, &other.m_in6.sin6_addr, sizeof(in6_addr)) == 0;
+    }
+
+    return m_path == other.m_path && port() == other.port();
+}
+
+}
+}
@@ -23,28 +23,38 @@
 #define FLY__NET__ADDR
 
 #include <string>
+#include <sys/socket.h>
+#include <netinet/in.h>
 #include "fly/base/common.hpp"
 
 namespace fly {
 namespace net {
 
+//a binary socket address: AF_INET, AF_INET6, AF_UNIX or AF_UNSPEC for a host name which Client::connect still
+//has to resolve. accept only copies the sockaddr, the text form is built when host() or to_string() is called
 struct Addr
 {
-    std::string m_host;
-    uint16 m_port;
-
-    Addr() = default;
-
-    Addr(const std::string &host, uint16 port)
+    Addr();
+    Addr(const std::string &host, uint16 port);
+    Addr(const sockaddr *addr, socklen_t length);
+    static Addr unix_socket(const std::string &path);
+    int32 family() const;
+    socklen_t sock_addr(sockaddr_storage *storage) const;
+    std::string host() const;
+    uint16 port() const;
+    std::string to_string() const;
+    uint64 host_hash() const;
+    bool operator==(const Addr &other) const;
+    
+    union
     {
-        m_host = host;
-        m_port = port;
-    }
+        sockaddr m_sa;
+        sockaddr_in m_in;
+        sockaddr_in6 m_in6;
+    };
 
-    bool operator==(const Addr &other)
-    {
-        return m_host == other.m_host && m_port == other.m_port;
-    }
+    //the unix socket path, a leading @ for the abstract namespace, or the unresolved host name
+    std::string m_path;
 };
 
 }
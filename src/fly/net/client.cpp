@@ -48,6 +48,7 @@ Client<T>::Client(const Addr &addr,
     m_close_cb = close_cb;
     m_be_closed_cb = be_closed_cb;
     m_poller = poller;
+    m_resolver = Resolver::instance();
     m_only_check = false;
     m_max_msg_length = max_msg_length;
 }
@@ -56,72 +57,144 @@ template<typename T>
 Client<T>::Client(const Addr &addr)
 {
     m_addr = addr;
+    m_resolver = Resolver::instance();
     m_only_check = true;
 }
 
 template<typename T>
-bool Client<T>::connect(int32 timeout)
+bool Client<T>::resolve(std::vector<Addr> &addrs)
 {
-    struct addrinfo hint;
-    hint.ai_flags = 0;
-    hint.ai_family = AF_INET;
-    hint.ai_socktype = SOCK_STREAM;
-    hint.ai_protocol = 0;
-    struct addrinfo *result, *iter;
-    int32 ret = getaddrinfo(m_addr.m_host.c_str(), base::to_string(m_addr.m_port).c_str(), &hint, &result);
+    //ip literals and unix sockets need no lookup
+    if(m_addr.family() != AF_UNSPEC)
+    {
+        addrs.push_back(m_addr);
+
+        return true;
+    }
+    
+    int32 ret = m_resolver->resolve(m_addr.host(), m_addr.port(), addrs);
 
     if(ret != 0)
     {
-        LOG_DEBUG_FATAL("resolve dns: %s:%u failed in client::connect: %s", m_addr.m_host.c_str(), m_addr.m_port, gai_strerror(ret));
+        LOG_DEBUG_FATAL("resolve dns: %s:%u failed in client::connect: %s", m_addr.host().c_str(), m_addr.port(), gai_strerror(ret));
         
         return false;
     }
-    
-    for(iter = result; iter != NULL; iter = iter->ai_next)
+
+    return true;
+}
+
+//returns a nonblocking socket with the connect to addr started, in_progress tells if it is still going on, -1 on failure
+template<typename T>
+int32 Client<T>::start_connect(const Addr &addr, const Socket_Options &socket_options, bool &in_progress)
+{
+    struct sockaddr_storage peer_addr;
+    socklen_t peer_addr_length = addr.sock_addr(&peer_addr);
+
+    if(peer_addr_length == 0)
     {
-        int32 fd = socket(AF_INET, SOCK_STREAM, 0);
+        LOG_FATAL("invalid addr %s in Client::connect", addr.to_string().c_str());
+
+        return -1;
+    }
+        
+    int32 fd = socket(addr.family(), SOCK_STREAM, 0);
     
-        if(fd < 0)
-        {
-            LOG_FATAL("socket failed in Client::connect: %s", strerror(errno));
+    if(fd < 0)
+    {
+        LOG_FATAL("socket failed in Client::connect: %s", strerror(errno));
 
-            return false;
-        }
+        return -1;
+    }
 
-        int32 flags = fcntl(fd, F_GETFL, 0);
+    int32 flags = fcntl(fd, F_GETFL, 0);
 
-        if(flags == -1)
-        {
-            LOG_FATAL("fcntl F_GETFL failed in Client::connect");
-            close(fd);
+    if(flags == -1)
+    {
+        LOG_FATAL("fcntl F_GETFL failed in Client::connect");
+        close(fd);
         
-            return false;
+        return -1;
+    }
+
+    flags |= O_NONBLOCK;
+
+    if(fcntl(fd, F_SETFL, flags) == -1)
+    {
+        LOG_FATAL("fnctl F_SETFL O_NONBLOCK failed in Client::connect");
+        close(fd);
+        
+        return -1;
+    }
+        
+    //set before connect, the receive buffer decides the window scale offered in the syn
+    socket_options.apply(fd);
+    LOG_DEBUG_INFO("connect to %s in client::connect, host: %s", addr.to_string().c_str(), m_addr.host().c_str());
+    in_progress = false;
+    
+    if(::connect(fd, (sockaddr*)&peer_addr, peer_addr_length) < 0)
+    {
+        if(errno != EINPROGRESS)
+        {        
+            LOG_DEBUG_FATAL("connect failed in Client::connect, host: %s, addr: %s %s", m_addr.host().c_str(), addr.to_string().c_str(), strerror(errno));
+            close(fd);
+                
+            return -1;
         }
 
-        flags |= O_NONBLOCK;
+        in_progress = true;
+    }
+
+    return fd;
+}
+
+template<typename T>
+bool Client<T>::new_connection(int32 fd, const Addr &addr)
+{
+    std::shared_ptr<Connection<T>> connection = std::make_shared<Connection<T>>(fd, addr);
+    m_id = connection->m_id_allocator.new_id();
+    connection->set_passive(false);
+    connection->m_max_msg_length = m_max_msg_length;
+    connection->m_id = m_id;
+    connection->m_init_cb = m_init_cb;
+    connection->m_dispatch_cb = m_dispatch_cb;
+    connection->m_close_cb = m_close_cb;
+    connection->m_be_closed_cb = m_be_closed_cb;
+            
+    if(!m_poller->register_connection(connection))
+    {
+        LOG_DEBUG_INFO("register_connection from %s:%d failed", connection->peer_addr().host().c_str(), connection->peer_addr().port());
+
+        return false;
+    }
+
+    return true;
+}
 
-        if(fcntl(fd, F_SETFL, flags) == -1)
+template<typename T>
+bool Client<T>::connect(int32 timeout)
+{
+    std::vector<Addr> addrs;
+
+    if(!resolve(addrs))
+    {
+        return false;
+    }
+    
+    Socket_Options socket_options = m_only_check ? m_socket_options : m_socket_options.over(m_poller->socket_options());
+    
+    for(const Addr &addr : addrs)
+    {
+        bool in_progress;
+        int32 fd = start_connect(addr, socket_options, in_progress);
+
+        if(fd < 0)
         {
-            LOG_FATAL("fnctl F_SETFL O_NONBLOCK failed in Client::connect");
-            close(fd);
-        
-            return false;
+            continue;
         }
         
-        char ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &((sockaddr_in*)(iter->ai_addr))->sin_addr, ip, INET_ADDRSTRLEN);
-        LOG_DEBUG_INFO("resolve ip success in client::connect host: %s, ip: %s", m_addr.m_host.c_str(), ip);
-        
-        if(::connect(fd, iter->ai_addr, sizeof(sockaddr)) < 0)
+        if(in_progress)
         {
-            if(errno != EINPROGRESS)
-            {        
-                LOG_DEBUG_FATAL("connect failed in Client::connect, host: %s, ip: %s, port: %d %s", m_addr.m_host.c_str(), ip, m_addr.m_port, strerror(errno));
-                close(fd);
-                
-                continue;
-            }
-
             struct pollfd fds;
             fds.fd = fd;
             fds.events = POLLOUT;
@@ -162,31 +235,122 @@ bool Client<T>::connect(int32 timeout)
             }
         }
 
-        if(!m_only_check)
+        if(m_only_check)
         {
-            std::shared_ptr<Connection<T>> connection = std::make_shared<Connection<T>>(fd, m_addr);
-            m_id = connection->m_id_allocator.new_id();
-            connection->set_passive(false);
-            connection->m_max_msg_length = m_max_msg_length;
-            connection->m_id = m_id;
-            connection->m_init_cb = m_init_cb;
-            connection->m_dispatch_cb = m_dispatch_cb;
-            connection->m_close_cb = m_close_cb;
-            connection->m_be_closed_cb = m_be_closed_cb;
-            
-            if(!m_poller->register_connection(connection))
-            {
-                LOG_DEBUG_INFO("register_connection from %s:%d failed", connection->peer_addr().m_host.c_str(), connection->peer_addr().m_port);
-                return false;
-            }
+            close(fd);
+
+            return true;
         }
         
-        return true;
+        return new_connection(fd, addr);
     }
     
     return false;
 }
 
+//returns at once, the poller waits for the connect instead of the calling thread. cb(true) comes after the new
+//connection was registered (init_cb has the connection), cb(false) once every address failed or timed out. cb is
+//called exactly once, on a poller or resolver thread or on the calling thread if no connect could be started.
+//the client is copied, it needn't outlive the call, but its id() isn't updated
+template<typename T>
+void Client<T>::connect_async(std::function<void(bool)> cb, int32 timeout)
+{
+    if(m_only_check)
+    {
+        LOG_FATAL("connect_async needs a poller, use connect() to check an addr");
+        cb(false);
+
+        return;
+    }
+    
+    std::shared_ptr<Client<T>> client = std::make_shared<Client<T>>(*this);
+    uint32 timeout_ms = timeout < 0 ? 0 : timeout;
+    
+    if(m_addr.family() != AF_UNSPEC)
+    {
+        client->connect_next(client, std::make_shared<std::vector<Addr>>(1, m_addr), 0, timeout_ms, cb);
+
+        return;
+    }
+
+    //the lookup doesn't block either, a cached name calls back at once
+    m_resolver->resolve(m_addr.host(), m_addr.port(), [client, timeout_ms, cb](int32 error, const std::vector<Addr> &addrs)
+    {
+        if(error != 0)
+        {
+            LOG_DEBUG_FATAL("resolve dns: %s:%u failed in client::connect_async: %s", client->m_addr.host().c_str(),
+                            client->m_addr.port(), gai_strerror(error));
+            cb(false);
+
+            return;
+        }
+        
+        client->connect_next(client, std::make_shared<std::vector<Addr>>(addrs), 0, timeout_ms, cb);
+    });
+}
+
+//tries the addrs from idx on, the next one once a pending connect fails
+template<typename T>
+void Client<T>::connect_next(std::shared_ptr<Client<T>> self, std::shared_ptr<std::vector<Addr>> addrs, uint32 idx,
+                             uint32 timeout_ms, std::function<void(bool)> cb)
+{
+    Socket_Options socket_options = m_socket_options.over(m_poller->socket_options());
+    
+    for(; idx < addrs->size(); ++idx)
+    {
+        const Addr &addr = (*addrs)[idx];
+        bool in_progress;
+        int32 fd = start_connect(addr, socket_options, in_progress);
+
+        if(fd < 0)
+        {
+            continue;
+        }
+
+        //unix sockets connect at once
+        if(!in_progress)
+        {
+            cb(new_connection(fd, addr));
+
+            return;
+        }
+
+        m_poller->connect(fd, timeout_ms, [self, addrs, idx, timeout_ms, cb, fd](int32 error)
+        {
+            const Addr &addr = (*addrs)[idx];
+
+            if(error != 0)
+            {
+                LOG_DEBUG_ERROR("connect to %s failed in Client::connect_async: %s", addr.to_string().c_str(), strerror(error));
+                close(fd);
+                self->connect_next(self, addrs, idx + 1, timeout_ms, cb);
+
+                return;
+            }
+
+            cb(self->new_connection(fd, addr));
+        });
+
+        return;
+    }
+
+    cb(false);
+}
+
+//overrides the options of the poller, call it before connect()
+template<typename T>
+void Client<T>::set_socket_options(const Socket_Options &options)
+{
+    m_socket_options = options;
+}
+
+//the names are looked up by Resolver::instance() unless another one is set here
+template<typename T>
+void Client<T>::set_resolver(std::shared_ptr<Resolver> resolver)
+{
+    m_resolver = resolver;
+}
+
 template<typename T>
 uint64 Client<T>::id()
 {
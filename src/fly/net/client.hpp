@@ -24,6 +24,7 @@
 
 #include "fly/net/poller.hpp"
 #include "fly/net/message.hpp"
+#include "fly/net/resolver.hpp"
 
 namespace fly {
 namespace net {
@@ -40,13 +41,23 @@ public:
            std::shared_ptr<Poller<T>> poller, uint32 max_msg_length = 1024 * 1024 * 1024);
     Client(const Addr &addr);
     bool connect(int32 timeout = -1);
+    void connect_async(std::function<void(bool)> cb, int32 timeout = -1);
+    void set_socket_options(const Socket_Options &options);
+    void set_resolver(std::shared_ptr<Resolver> resolver);
     uint64 id();
     
 private:
+    bool resolve(std::vector<Addr> &addrs);
+    int32 start_connect(const Addr &addr, const Socket_Options &socket_options, bool &in_progress);
+    bool new_connection(int32 fd, const Addr &addr);
+    void connect_next(std::shared_ptr<Client<T>> self, std::shared_ptr<std::vector<Addr>> addrs, uint32 idx,
+                      uint32 timeout_ms, std::function<void(bool)> cb);
     bool m_only_check;
     uint32 m_max_msg_length;
     uint64 m_id;
     Addr m_addr;
+    Socket_Options m_socket_options;
+    std::shared_ptr<Resolver> m_resolver;
     std::shared_ptr<Poller<T>> m_poller;
     std::function<void(std::shared_ptr<Connection<T>>)> m_close_cb;
     std::function<void(std::shared_ptr<Connection<T>>)> m_be_closed_cb;
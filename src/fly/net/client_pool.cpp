@@ -0,0 +1,429 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 15:06:21                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <algorithm>
+#include "fly/net/client_pool.hpp"
+#include "fly/base/logger.hpp"
+
+namespace fly {
+namespace net {
+
+//the pool has to be owned by a shared_ptr, the connections only keep a weak one to it
+template<typename T>
+Client_Pool<T>::Client_Pool(std::function<bool(std::shared_ptr<Connection<T>>)> init_cb,
+                            std::function<void(std::unique_ptr<Message<T>>)> dispatch_cb,
+                            std::function<void(std::shared_ptr<Connection<T>>)> close_cb,
+                            std::function<void(std::shared_ptr<Connection<T>>)> be_closed_cb,
+                            std::shared_ptr<Poller<T>> poller, uint32 min_size, uint32 max_size, uint32 max_msg_length)
+    : m_random(fly::base::random_32())
+{
+    m_init_cb = init_cb;
+    m_dispatch_cb = dispatch_cb;
+    m_close_cb = close_cb;
+    m_be_closed_cb = be_closed_cb;
+    m_poller = poller;
+    m_min_size = min_size;
+    m_max_size = std::max(min_size, max_size);
+    m_max_msg_length = max_msg_length;
+}
+
+//pre-warms min_size connections to addr, they come up in the background
+template<typename T>
+bool Client_Pool<T>::add_upstream(const Addr &addr)
+{
+    Upstream *upstream;
+    
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if(m_stopped || find(addr) != nullptr)
+        {
+            return false;
+        }
+
+        upstream = new Upstream;
+        upstream->m_addr = addr;
+        upstream->m_connecting = m_min_size;
+        m_upstreams.push_back(std::unique_ptr<Upstream>(upstream));
+    }
+
+    open(upstream, m_min_size);
+
+    return true;
+}
+
+//the live connection to addr with the shortest send queue, nullptr if there is none yet. never blocks
+template<typename T>
+std::shared_ptr<Connection<T>> Client_Pool<T>::checkout(const Addr &addr)
+{
+    uint64 start_ns = fly::base::monotonic_ns();
+    std::shared_ptr<Connection<T>> best;
+    Upstream *grow = nullptr;
+    
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        Upstream *upstream = find(addr);
+
+        if(upstream != nullptr)
+        {
+            uint32 best_length = 0;
+            
+            for(auto &connection : upstream->m_connections)
+            {
+                if(connection->closed())
+                {
+                    continue;
+                }
+
+                uint32 length = connection->send_queue_length();
+                
+                if(!best || length < best_length)
+                {
+                    best = connection;
+                    best_length = length;
+
+                    if(length == 0)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            //all busy, one more at a time. a pending reconnect keeps its backoff
+            if((!best || best_length > 0) && !m_stopped && upstream->m_connecting == 0 && upstream->m_reconnect_timer == 0
+               && upstream->m_connections.size() < m_max_size)
+            {
+                ++upstream->m_connecting;
+                grow = upstream;
+            }
+        }
+    }
+
+    if(grow != nullptr)
+    {
+        open(grow, 1);
+    }
+    
+    uint64 ns = fly::base::monotonic_ns() - start_ns;
+    uint64 max_ns = m_checkout_max_ns.load(std::memory_order_relaxed);
+
+    while(ns > max_ns && !m_checkout_max_ns.compare_exchange_weak(max_ns, ns, std::memory_order_relaxed));
+
+    m_checkout_ns.fetch_add(ns, std::memory_order_relaxed);
+    m_checkout_count.fetch_add(1, std::memory_order_relaxed);
+
+    if(!best)
+    {
+        m_checkout_miss_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    return best;
+}
+
+//closes every connection, nothing is reconnected afterwards
+template<typename T>
+void Client_Pool<T>::stop()
+{
+    std::vector<std::shared_ptr<Connection<T>>> connections;
+    
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stopped = true;
+
+        for(auto &upstream : m_upstreams)
+        {
+            if(upstream->m_reconnect_timer != 0)
+            {
+                m_poller->cancel_timer(upstream->m_reconnect_timer);
+                upstream->m_reconnect_timer = 0;
+            }
+
+            connections.insert(connections.end(), upstream->m_connections.begin(), upstream->m_connections.end());
+        }
+    }
+
+    for(auto &connection : connections)
+    {
+        connection->close();
+    }
+}
+
+//the first retry waits about base_ms, each failure in a row doubles it up to max_ms
+template<typename T>
+void Client_Pool<T>::set_backoff(uint32 base_ms, uint32 max_ms)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_backoff_base = std::max(base_ms, 1u);
+    m_backoff_max = std::max(max_ms, m_backoff_base);
+}
+
+template<typename T>
+void Client_Pool<T>::set_connect_timeout(uint32 timeout_ms)
+{
+    m_connect_timeout = timeout_ms;
+}
+
+//call it before add_upstream
+template<typename T>
+void Client_Pool<T>::set_socket_options(const Socket_Options &options)
+{
+    m_socket_options = options;
+}
+
+template<typename T>
+typename Client_Pool<T>::Upstream* Client_Pool<T>::find(const Addr &addr)
+{
+    for(auto &upstream : m_upstreams)
+    {
+        if(upstream->m_addr == addr)
+        {
+            return upstream.get();
+        }
+    }
+
+    return nullptr;
+}
+
+//num connects to upstream, already counted in m_connecting. called without the lock, connect_async may call back at once
+template<typename T>
+void Client_Pool<T>::open(Upstream *upstream, uint32 num)
+{
+    std::weak_ptr<Client_Pool<T>> self = this->shared_from_this();
+    
+    for(uint32 i = 0; i < num; ++i)
+    {
+        Client<T> client(upstream->m_addr, [self, upstream](std::shared_ptr<Connection<T>> connection)
+        {
+            std::shared_ptr<Client_Pool<T>> pool = self.lock();
+
+            return pool && pool->on_init(upstream, connection);
+        }, m_dispatch_cb, [self, upstream](std::shared_ptr<Connection<T>> connection)
+        {
+            std::shared_ptr<Client_Pool<T>> pool = self.lock();
+
+            if(pool)
+            {
+                pool->on_close(upstream, connection);
+                pool->m_close_cb(connection);
+            }
+        }, [self, upstream](std::shared_ptr<Connection<T>> connection)
+        {
+            std::shared_ptr<Client_Pool<T>> pool = self.lock();
+
+            if(pool)
+            {
+                pool->on_close(upstream, connection);
+                pool->m_be_closed_cb(connection);
+            }
+        }, m_poller, m_max_msg_length);
+        
+        client.set_socket_options(m_socket_options);
+        client.connect_async([self, upstream](bool ok)
+        {
+            std::shared_ptr<Client_Pool<T>> pool = self.lock();
+            
+            if(!ok && pool)
+            {
+                pool->on_connect_failed(upstream);
+            }
+        }, m_connect_timeout);
+    }
+}
+
+//a failed init_cb fails the connect, see on_connect_failed
+template<typename T>
+bool Client_Pool<T>::on_init(Upstream *upstream, std::shared_ptr<Connection<T>> connection)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if(m_stopped)
+        {
+            return false;
+        }
+    }
+    
+    if(!m_init_cb(connection))
+    {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> guard(m_mutex);
+    --upstream->m_connecting;
+    upstream->m_failures = 0;
+    upstream->m_connections.push_back(connection);
+
+    return true;
+}
+
+template<typename T>
+void Client_Pool<T>::on_connect_failed(Upstream *upstream)
+{
+    m_connect_fail_count.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> guard(m_mutex);
+    --upstream->m_connecting;
+    ++upstream->m_failures;
+    LOG_DEBUG_ERROR("connect to upstream %s failed %u times in a row", upstream->m_addr.to_string().c_str(), upstream->m_failures);
+    schedule_reconnect(upstream);
+}
+
+template<typename T>
+void Client_Pool<T>::on_close(Upstream *upstream, std::shared_ptr<Connection<T>> connection)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto iter = std::find(upstream->m_connections.begin(), upstream->m_connections.end(), connection);
+
+    if(iter != upstream->m_connections.end())
+    {
+        upstream->m_connections.erase(iter);
+    }
+
+    schedule_reconnect(upstream);
+}
+
+//called with the lock held. one timer per upstream, it tops up to min_size when it fires
+template<typename T>
+void Client_Pool<T>::schedule_reconnect(Upstream *upstream)
+{
+    if(m_stopped || upstream->m_reconnect_timer != 0 || upstream->m_connections.size() + upstream->m_connecting >= m_min_size)
+    {
+        return;
+    }
+
+    uint64 delay = std::min<uint64>((uint64)m_backoff_base << std::min(upstream->m_failures, 16u), m_backoff_max);
+    
+    //full jitter over the upper half, so upstreams failing together don't retry in lockstep
+    delay = delay / 2 + m_random() % (delay / 2 + 1);
+    std::weak_ptr<Client_Pool<T>> self = this->shared_from_this();
+    upstream->m_reconnect_timer = m_poller->run_after(delay, [self, upstream]
+    {
+        std::shared_ptr<Client_Pool<T>> pool = self.lock();
+
+        if(pool)
+        {
+            pool->reconnect(upstream);
+        }
+    });
+}
+
+template<typename T>
+void Client_Pool<T>::reconnect(Upstream *upstream)
+{
+    uint32 num = 0;
+    
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        upstream->m_reconnect_timer = 0;
+        uint32 size = upstream->m_connections.size() + upstream->m_connecting;
+
+        if(m_stopped || size >= m_min_size)
+        {
+            return;
+        }
+
+        num = m_min_size - size;
+        upstream->m_connecting += num;
+    }
+
+    m_reconnect_count.fetch_add(num, std::memory_order_relaxed);
+    open(upstream, num);
+}
+
+template<typename T>
+uint32 Client_Pool<T>::connection_count()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    uint32 count = 0;
+
+    for(auto &upstream : m_upstreams)
+    {
+        count += upstream->m_connections.size();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint32 Client_Pool<T>::connection_count(const Addr &addr)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    Upstream *upstream = find(addr);
+
+    return upstream != nullptr ? upstream->m_connections.size() : 0;
+}
+
+template<typename T>
+uint32 Client_Pool<T>::connecting_count()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    uint32 count = 0;
+
+    for(auto &upstream : m_upstreams)
+    {
+        count += upstream->m_connecting;
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Client_Pool<T>::checkout_count()
+{
+    return m_checkout_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Client_Pool<T>::checkout_miss_count()
+{
+    return m_checkout_miss_count.load(std::memory_order_relaxed);
+}
+
+//total time spent in checkout, divide by checkout_count for the mean
+template<typename T>
+uint64 Client_Pool<T>::checkout_ns()
+{
+    return m_checkout_ns.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Client_Pool<T>::checkout_max_ns()
+{
+    return m_checkout_max_ns.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Client_Pool<T>::connect_fail_count()
+{
+    return m_connect_fail_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Client_Pool<T>::reconnect_count()
+{
+    return m_reconnect_count.load(std::memory_order_relaxed);
+}
+
+template class Client_Pool<Json>;
+//template class Client_Pool<Wsock>;
+template class Client_Pool<Proto>;
+
+}
+}
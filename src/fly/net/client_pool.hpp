@@ -0,0 +1,105 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 15:06:21                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__NET__CLIENT_POOL
+#define FLY__NET__CLIENT_POOL
+
+#include <mutex>
+#include <random>
+#include "fly/net/client.hpp"
+
+namespace fly {
+namespace net {
+
+//keeps between min_size and max_size registered connections to each upstream addr. connections are shared, not
+//lent out: checkout() picks the one with the shortest send queue and opens one more (up to max_size) if all of
+//them are busy. dead connections are replaced in the background after a jittered exponential backoff
+template<typename T>
+class Client_Pool : public std::enable_shared_from_this<Client_Pool<T>>
+{
+public:
+    Client_Pool(std::function<bool(std::shared_ptr<Connection<T>>)> init_cb,
+                std::function<void(std::unique_ptr<Message<T>>)> dispatch_cb,
+                std::function<void(std::shared_ptr<Connection<T>>)> close_cb,
+                std::function<void(std::shared_ptr<Connection<T>>)> be_closed_cb,
+                std::shared_ptr<Poller<T>> poller, uint32 min_size = 1, uint32 max_size = 8,
+                uint32 max_msg_length = 1024 * 1024 * 1024);
+    bool add_upstream(const Addr &addr);
+    std::shared_ptr<Connection<T>> checkout(const Addr &addr);
+    void stop();
+    void set_backoff(uint32 base_ms, uint32 max_ms);
+    void set_connect_timeout(uint32 timeout_ms);
+    void set_socket_options(const Socket_Options &options);
+    uint32 connection_count();
+    uint32 connection_count(const Addr &addr);
+    uint32 connecting_count();
+    uint64 checkout_count();
+    uint64 checkout_miss_count();
+    uint64 checkout_ns();
+    uint64 checkout_max_ns();
+    uint64 connect_fail_count();
+    uint64 reconnect_count();
+    
+private:
+    struct Upstream
+    {
+        Addr m_addr;
+        std::vector<std::shared_ptr<Connection<T>>> m_connections;
+        uint32 m_connecting = 0;
+        uint32 m_failures = 0;
+        uint64 m_reconnect_timer = 0;
+    };
+    
+    Upstream* find(const Addr &addr);
+    void open(Upstream *upstream, uint32 num);
+    bool on_init(Upstream *upstream, std::shared_ptr<Connection<T>> connection);
+    void on_connect_failed(Upstream *upstream);
+    void on_close(Upstream *upstream, std::shared_ptr<Connection<T>> connection);
+    void schedule_reconnect(Upstream *upstream);
+    void reconnect(Upstream *upstream);
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Upstream>> m_upstreams;
+    std::shared_ptr<Poller<T>> m_poller;
+    std::function<bool(std::shared_ptr<Connection<T>>)> m_init_cb;
+    std::function<void(std::unique_ptr<Message<T>>)> m_dispatch_cb;
+    std::function<void(std::shared_ptr<Connection<T>>)> m_close_cb;
+    std::function<void(std::shared_ptr<Connection<T>>)> m_be_closed_cb;
+    uint32 m_min_size;
+    uint32 m_max_size;
+    uint32 m_max_msg_length;
+    uint32 m_connect_timeout = 3000;
+    uint32 m_backoff_base = 100;
+    uint32 m_backoff_max = 10000;
+    bool m_stopped = false;
+    std::minstd_rand m_random;
+    Socket_Options m_socket_options;
+    std::atomic<uint64> m_checkout_count {0};
+    std::atomic<uint64> m_checkout_miss_count {0};
+    std::atomic<uint64> m_checkout_ns {0};
+    std::atomic<uint64> m_checkout_max_ns {0};
+    std::atomic<uint64> m_connect_fail_count {0};
+    std::atomic<uint64> m_reconnect_count {0};
+};
+
+}
+}
+
+#endif
@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <cstring>
 #include <netinet/in.h>
+#include <sys/socket.h>
 #include "fly/net/connection.hpp"
 #include "fly/net/poller_task.hpp"
 #include "fly/base/logger.hpp"
@@ -31,6 +32,12 @@
 namespace fly {
 namespace net {
 
+//why the reading of a connection is paused
+static const uint8 READ_PAUSE_USER = 1;
+static const uint8 READ_PAUSE_AUTO = 2;
+static const uint8 READ_PAUSE_RATE = 4;
+static const uint8 READ_PAUSE_DRAIN = 8;
+
 //Json
 fly::base::ID_Allocator Connection<Json>::m_id_allocator;
 
@@ -79,277 +86,581 @@ uint64 Connection<Json>::id()
     return m_id;
 }
 
-void Connection<Json>::send(rapidjson::Document &doc)
+bool Connection<Json>::send(rapidjson::Document &doc)
 {
     rapidjson::StringBuffer buffer;
     rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
     doc.Accept(writer);
-    send(buffer.GetString(), buffer.GetSize());
+    return send(buffer.GetString(), buffer.GetSize());
 }
 
-void Connection<Json>::send(const void *data, uint32 size)
+bool Connection<Json>::send(const void *data, uint32 size)
 {
+    if(send_blocked())
+    {
+        return false;
+    }
+    
     Message_Chunk *message_chunk = new Message_Chunk(size + sizeof(uint32));
     uint32 *uint32_ptr = (uint32*)message_chunk->read_ptr();
     *uint32_ptr = htonl(size);
     memcpy(message_chunk->read_ptr() + sizeof(uint32), data, size);
     message_chunk->write_ptr(size + sizeof(uint32));
     m_send_msg_queue.push(message_chunk);
-    m_poller_task->write_connection(shared_from_this());
+    schedule_write();
+
+    return true;
 }
 
-void Connection<Json>::close()
+//data is held until the kernel releases it when sent with MSG_ZEROCOPY, it must not be modified meanwhile
+bool Connection<Json>::send(std::shared_ptr<const std::string> data)
 {
-    m_poller_task->close_connection(shared_from_this());
+    uint32 size = data->size();
+
+    if(m_zerocopy_threshold == 0 || size < m_zerocopy_threshold)
+    {
+        return send(data->data(), size);
+    }
+
+    if(send_blocked())
+    {
+        return false;
+    }
+    
+    Message_Chunk *message_chunks[2];
+    message_chunks[0] = new_frame_header(size);
+    message_chunks[1] = new Message_Chunk(data);
+    m_send_msg_queue.push(message_chunks, 2);
+    schedule_write();
+
+    return true;
 }
 
-bool Connection<Json>::closed()
+//sends length bytes of the file from offset with sendfile, framed like send(data, size)
+//fd is dup'ed, the caller may close it right away, the file must not shrink meanwhile
+bool Connection<Json>::send_file(int32 fd, uint64 offset, uint32 length)
 {
-    return m_closed.load(std::memory_order_relaxed);
+    if(send_blocked())
+    {
+        return false;
+    }
+    
+    int32 file_fd = dup(fd);
+
+    if(file_fd < 0)
+    {
+        LOG_ERROR("dup failed in Connection::send_file: %s", strerror(errno));
+
+        return false;
+    }
+    
+    Message_Chunk *message_chunks[2];
+    message_chunks[0] = new_frame_header(length);
+    message_chunks[1] = new Message_Chunk(file_fd, offset, length);
+    m_send_msg_queue.push(message_chunks, 2);
+    schedule_write();
+
+    return true;
 }
 
-const Addr& Connection<Json>::peer_addr()
+//only the length prefix of a frame, the payload follows in its own chunk
+Message_Chunk* Connection<Json>::new_frame_header(uint32 size)
 {
-    return m_peer_addr;
+    Message_Chunk *message_chunk = new Message_Chunk(sizeof(uint32));
+    uint32 *uint32_ptr = (uint32*)message_chunk->read_ptr();
+    *uint32_ptr = htonl(size);
+    message_chunk->write_ptr(sizeof(uint32));
+
+    return message_chunk;
 }
 
-void Connection<Json>::parse()
+//stops reading after the current batch, the unread bytes stay in the socket so tcp pushes back on the peer
+void Connection<Json>::pause_read()
 {
-    while(true)
+    m_read_pause.fetch_or(READ_PAUSE_USER);
+}
+
+void Connection<Json>::resume_read()
+{
+    unpause_read(READ_PAUSE_USER);
+}
+
+bool Connection<Json>::read_paused()
+{
+    return m_read_pause.load(std::memory_order_relaxed) != 0;
+}
+
+//reading pauses while more than max dispatched messages are alive and resumes once half of them are destroyed
+//0 disables it, set it in init_cb
+void Connection<Json>::set_max_pending_messages(uint32 max)
+{
+    m_max_pending_msgs = max;
+}
+
+uint32 Connection<Json>::pending_messages()
+{
+    return m_pending_msgs.load(std::memory_order_relaxed);
+}
+
+void Connection<Json>::unpause_read(uint8 reason)
+{
+    //only the one clearing the last reason resumes
+    if(m_read_pause.fetch_and(~reason) == reason)
     {
-        char *msg_length_buf = (char*)(&m_cur_msg_length);
-        uint32 remain_bytes = sizeof(uint32);
-        
-        if(m_cur_msg_length != 0)
-        {
-            goto after_parse_length;
-        }
-        
-        if(m_recv_msg_queue.length() < sizeof(uint32))
-        {
-            break;
-        }
-        
-        while(auto *message_chunk = m_recv_msg_queue.pop())
-        {
-            uint32 length = message_chunk->length();
-            
-            if(length < remain_bytes)
-            {
-                memcpy(msg_length_buf + sizeof(uint32) - remain_bytes, message_chunk->read_ptr(), length);
-                remain_bytes -= length;
-                delete message_chunk;
-            }
-            else
-            {
-                memcpy(msg_length_buf + sizeof(uint32) - remain_bytes, message_chunk->read_ptr(), remain_bytes);
+        poller_task()->resume_read(shared_from_this());
+    }
+}
 
-                if(length == remain_bytes)
-                {
-                    delete message_chunk;
-                }
-                else
-                {
-                    message_chunk->read_ptr(remain_bytes);
-                    m_recv_msg_queue.push_front(message_chunk);
-                }
-                
-                break;
-            }
-        }
-        
-        m_cur_msg_length = ntohl(m_cur_msg_length);
-        
-    after_parse_length:
-        if(m_cur_msg_length > m_max_msg_length)
-        {
-            LOG_DEBUG_ERROR("json message length(%lu) exceed max_msg_length(%u) from %s:%u", m_cur_msg_length, m_max_msg_length, \
-                      m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
-            close();
-            return;
-        }
-        
-        if(m_recv_msg_queue.length() < m_cur_msg_length)
-        {
-            return;
-        }
-        
-        const uint32 MAX_STACK_SIZE = 512 * 1024;
-        char msg_buf[MAX_STACK_SIZE] = {0};
-        char *data = msg_buf;
-        bool is_new_buf = false;
-        remain_bytes = m_cur_msg_length;
-        
-        if(m_cur_msg_length > MAX_STACK_SIZE)
+void Connection<Json>::track_message(Message<Json> *message)
+{
+    if(m_max_pending_msgs == 0)
+    {
+        return;
+    }
+
+    message->m_tracked = true;
+
+    if(m_pending_msgs.fetch_add(1) + 1 > m_max_pending_msgs)
+    {
+        m_read_pause.fetch_or(READ_PAUSE_AUTO);
+
+        //the messages may have been destroyed before the flag was set, see message_done
+        if(m_pending_msgs.load() <= m_max_pending_msgs / 2)
         {
-            data = new char[m_cur_msg_length];
-            is_new_buf = true;
+            unpause_read(READ_PAUSE_AUTO);
         }
-        
-        while(auto *message_chunk = m_recv_msg_queue.pop())
-        {
-            uint32 length = message_chunk->length();
+    }
+}
 
-            if(length < remain_bytes)
-            {
-                memcpy(data + m_cur_msg_length - remain_bytes, message_chunk->read_ptr(), length);
-                remain_bytes -= length;
-                delete message_chunk;
-            }
-            else
-            {
-                memcpy(data + m_cur_msg_length - remain_bytes, message_chunk->read_ptr(), remain_bytes);
+//called by the destructor of a tracked message, from any thread
+void Connection<Json>::message_done()
+{
+    if(m_pending_msgs.fetch_sub(1) - 1 <= m_max_pending_msgs / 2 && (m_read_pause.load() & READ_PAUSE_AUTO))
+    {
+        unpause_read(READ_PAUSE_AUTO);
+    }
+}
 
-                if(length == remain_bytes)
-                {
-                    delete message_chunk;
-                }
-                else
-                {
-                    message_chunk->read_ptr(remain_bytes);
-                    m_recv_msg_queue.push_front(message_chunk);
-                }
+//swapped by a migration while other threads send, see Poller::migrate
+Poller_Task<Json>* Connection<Json>::poller_task()
+{
+    return m_poller_task.load(std::memory_order_acquire);
+}
 
-                std::unique_ptr<Message<Json>> message(new Message<Json>(shared_from_this()));
-                message->m_raw_data.assign(data, m_cur_msg_length);
-                message->m_length = m_cur_msg_length;
-                m_cur_msg_length = 0;
+//the poller is draining: reading stops for good and the read half is shut down, the sends go on
+void Connection<Json>::drain()
+{
+    m_read_pause.fetch_or(READ_PAUSE_DRAIN);
 
-                if(is_new_buf)
-                {
-                    delete[] data;
-                }
-                
-                rapidjson::Document &doc = message->doc();
-                doc.Parse(message->m_raw_data.c_str());
+    //on the ring a shut down read half makes the writev in flight fail with EAGAIN, the pause is enough there
+    if(!m_uring_ctx)
+    {
+        shutdown(m_fd, SHUT_RD);
+    }
+}
 
-                if(doc.HasParseError())
-                {
-                    LOG_DEBUG_ERROR("parse json message failed from %s:%u, reason: %s", m_peer_addr.m_host.c_str(), m_peer_addr.m_port, \
-                                    GetParseError_En(doc.GetParseError()));
-                    close();
-                    return;
-                }
+//limits the messages received by this connection, on top of the peer limit of the poller (see Poller::set_peer_rate_limit)
+//set it in init_cb, a limit without any rate removes it
+void Connection<Json>::set_rate_limit(const Rate_Limit &limit)
+{
+    Rate_Limiter *rate_limiter = new Rate_Limiter(limit);
 
-                if(!doc.IsObject())
-                {
-                    close();
-                    return;
-                }
-                
-                if(!doc.HasMember("msg_type"))
-                {
-                    close();
-                    return;
-                }
-                    
-                const rapidjson::Value &msg_type = doc["msg_type"];
+    if(!rate_limiter->enabled())
+    {
+        delete rate_limiter;
+        rate_limiter = nullptr;
+    }
 
-                if(!msg_type.IsUint())
-                {
-                    close();
-                    return;
-                }
-                    
-                message->m_type = msg_type.GetUint();
+    m_rate_limiter.reset(rate_limiter);
+}
 
-                if(!doc.HasMember("msg_cmd"))
-                {
-                    close();
-                    return;
-                }
-                    
-                const rapidjson::Value &msg_cmd = doc["msg_cmd"];
+//checked once a whole message is buffered, before it's copied out or parsed. true if it must not be dispatched now,
+//a dropped message is skipped already, otherwise the read is paused
+bool Connection<Json>::rate_limited(uint32 length)
+{
+    if(!m_rate_limiter && m_peer_key == 0)
+    {
+        return false;
+    }
 
-                if(!msg_cmd.IsUint())
-                {
-                    close();
-                    return;
-                }
-                    
-                message->m_cmd = msg_cmd.GetUint();
-                m_dispatch_cb(std::move(message));
-                
-                break;
+    uint64 now_ns = fly::base::monotonic_ns();
+    uint64 wait_ns = 0;
+    RATE_LIMIT_ACTION action = RATE_LIMIT_DROP;
+
+    if(m_rate_limiter)
+    {
+        wait_ns = m_rate_limiter->admit(m_rate_buckets, length, now_ns);
+        action = m_rate_limiter->action();
+    }
+
+    if(wait_ns == 0 && m_peer_key != 0)
+    {
+        Peer_Rate_Table *peer_rate_table = poller_task()->m_peer_rate_table.get();
+        Rate_Buckets *buckets = peer_rate_table->find(m_peer_key, poller_task()->m_now_ms);
+
+        //a full table lets the peer through
+        if(buckets != nullptr)
+        {
+            wait_ns = peer_rate_table->limiter().admit(*buckets, length, now_ns);
+            action = peer_rate_table->limiter().action();
+
+            //only the breached limit is charged
+            if(wait_ns > 0 && m_rate_limiter)
+            {
+                m_rate_limiter->refund(m_rate_buckets, length);
             }
         }
     }
-}
 
-//Wsock
-fly::base::ID_Allocator Connection<Wsock>::m_id_allocator;
+    if(wait_ns == 0)
+    {
+        return false;
+    }
 
-Connection<Wsock>::~Connection()
-{
-    while(auto *message_chunk = m_recv_msg_queue.pop())
+    if(action == RATE_LIMIT_DROP)
     {
-        delete message_chunk;
+        poller_task()->m_rate_drop_count.fetch_add(1, std::memory_order_relaxed);
+        m_recv_msg_queue.skip(length);
+        m_cur_msg_length = 0;
+
+        return true;
     }
 
-    while(auto *message_chunk = m_send_msg_queue.pop())
+    m_read_pause.fetch_or(READ_PAUSE_RATE);
+
+    if(action == RATE_LIMIT_CLOSE)
     {
-        delete message_chunk;
+        poller_task()->m_rate_close_count.fetch_add(1, std::memory_order_relaxed);
+        LOG_DEBUG_INFO("json message rate limit exceeded from %s:%u, close it", m_peer_addr.host().c_str(), m_peer_addr.port());
+        close();
+
+        return true;
     }
+
+    poller_task()->m_rate_delay_count.fetch_add(1, std::memory_order_relaxed);
+    std::shared_ptr<Connection> self = shared_from_this();
+    poller_task()->run_after(wait_ns / 1000000 + 1, [self]
+    {
+        self->unpause_read(READ_PAUSE_RATE);
+    });
+
+    return true;
 }
 
-Connection<Wsock>::Connection(int32 fd, const Addr &peer_addr)
+//send() and send_file() fail once the queued bytes reach high, drain_cb is called from the poller thread
+//after they fell to low again. high == 0 disables the limit, set it in init_cb
+void Connection<Json>::set_send_watermarks(uint32 high, uint32 low, std::function<void(std::shared_ptr<Connection>)> drain_cb)
 {
-    m_fd = fd;
-    m_peer_addr = peer_addr;
-    m_is_passive = true;
+    m_send_high_watermark = high;
+    m_send_low_watermark = low;
+    m_drain_cb = drain_cb;
 }
 
-bool Connection<Wsock>::is_passive()
+uint32 Connection<Json>::send_queue_length()
 {
-    return m_is_passive;
+    return m_send_msg_queue.length();
 }
 
-void Connection<Wsock>::set_passive(bool is_passive)
+bool Connection<Json>::send_blocked()
 {
-    m_is_passive = is_passive;
+    if(m_send_high_watermark == 0 || m_send_msg_queue.length() < m_send_high_watermark)
+    {
+        return false;
+    }
+
+    //pairs with the fence in Poller_Task::check_drain, either the poller sees the flag or this sees the drained queue
+    m_send_blocked.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    return m_send_msg_queue.length() >= m_send_high_watermark;
 }
 
-uint64 Connection<Wsock>::id()
+//sends between cork() and uncork() only queue, uncork() hands them to the poller at once so they leave in
+//one writev instead of one per message. nests, the last uncork() flushes
+void Connection<Json>::cork()
 {
-    return m_id;
+    m_cork.fetch_add(1);
 }
 
-std::string Connection<Wsock>::key() const
+void Connection<Json>::uncork()
 {
-    return m_key;
+    if(m_cork.fetch_sub(1) == 1 && m_send_msg_queue.length() > 0)
+    {
+        poller_task()->write_connection(shared_from_this());
+    }
 }
 
-void Connection<Wsock>::key(std::string k)
+void Connection<Json>::schedule_write()
 {
-    m_key = k;
+    if(m_cork.load() > 0)
+    {
+        return;
+    }
+
+    poller_task()->write_connection(shared_from_this());
 }
 
-void Connection<Wsock>::send(rapidjson::Document &doc)
+//payloads of at least threshold bytes passed to send(data) go out with MSG_ZEROCOPY, 0 disables it
+//only supported by the epoll backend
+bool Connection<Json>::set_zerocopy_threshold(uint32 threshold)
 {
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    doc.Accept(writer);
-    send(buffer.GetString(), buffer.GetSize());
+    if(threshold > 0)
+    {
+        if(poller_task() != nullptr && poller_task()->backend() != POLLER_EPOLL)
+        {
+            LOG_ERROR("zerocopy is only supported by the epoll backend in Connection::set_zerocopy_threshold");
+
+            return false;
+        }
+        
+        int32 opt = 1;
+
+        if(setsockopt(m_fd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt)) < 0)
+        {
+            LOG_ERROR("setsockopt SO_ZEROCOPY failed in Connection::set_zerocopy_threshold: %s", strerror(errno));
+
+            return false;
+        }
+    }
+
+    m_zerocopy_threshold = threshold;
+
+    return true;
 }
 
-void Connection<Wsock>::send_raw(const void *data, uint32 size)
+void Connection<Json>::close()
 {
-    Message_Chunk *message_chunk = new Message_Chunk(size);
-    memcpy(message_chunk->read_ptr(), data, size);
-    message_chunk->write_ptr(size);
-    m_send_msg_queue.push(message_chunk);
-    m_poller_task->write_connection(shared_from_this());
+    poller_task()->close_connection(shared_from_this());
 }
 
-void Connection<Wsock>::send(const void *data, uint32 size)
+//closes the connection if nothing is received for timeout_ms, 0 disables it
+void Connection<Json>::set_idle_timeout(uint32 timeout_ms)
 {
-    //assemble websocket packet
-    char *buf, *p_data;
-    Message_Chunk *message_chunk;
+    m_idle_timeout = timeout_ms;
+    uint32 gen = m_idle_gen.fetch_add(1, std::memory_order_relaxed) + 1;
     
-    if(size > 0xffff)
+    if(poller_task() != nullptr && timeout_ms > 0)
     {
-        message_chunk = new Message_Chunk(size + 10);
+        poller_task()->watch_idle(shared_from_this(), gen, timeout_ms, timeout_ms);
+    }
+}
+
+//cb runs on the poller thread when nothing is received for interval_ms, 0 disables it
+void Connection<Json>::set_heartbeat_interval(uint32 interval_ms, std::function<void(std::shared_ptr<Connection>)> cb)
+{
+    m_heartbeat_interval = interval_ms;
+    m_heartbeat_cb = cb;
+    uint32 gen = m_heartbeat_gen.fetch_add(1, std::memory_order_relaxed) + 1;
+    
+    if(poller_task() != nullptr && interval_ms > 0)
+    {
+        poller_task()->watch_heartbeat(shared_from_this(), gen, interval_ms, cb, interval_ms);
+    }
+}
+
+uint64 Connection<Json>::run_after(uint32 delay_ms, std::function<void()> cb)
+{
+    return poller_task()->run_after(delay_ms, cb);
+}
+
+uint64 Connection<Json>::run_every(uint32 interval_ms, std::function<void()> cb)
+{
+    return poller_task()->run_every(interval_ms, cb);
+}
+
+void Connection<Json>::cancel_timer(uint64 timer_id)
+{
+    poller_task()->cancel_timer(timer_id);
+}
+
+bool Connection<Json>::closed()
+{
+    return m_closed.load(std::memory_order_relaxed);
+}
+
+const Addr& Connection<Json>::peer_addr()
+{
+    return m_peer_addr;
+}
+
+void Connection<Json>::parse()
+{
+    while(true)
+    {
+        //paused, the buffered bytes are parsed by resume_read
+        if(m_read_pause.load(std::memory_order_relaxed) != 0)
+        {
+            return;
+        }
+
+        if(m_cur_msg_length == 0)
+        {
+            if(m_recv_msg_queue.length() < sizeof(uint32))
+            {
+                break;
+            }
+
+            m_recv_msg_queue.read((char*)&m_cur_msg_length, sizeof(uint32));
+            m_cur_msg_length = ntohl(m_cur_msg_length);
+        }
+        
+        if(m_cur_msg_length > m_max_msg_length)
+        {
+            LOG_DEBUG_ERROR("json message length(%lu) exceed max_msg_length(%u) from %s:%u", m_cur_msg_length, m_max_msg_length, \
+                      m_peer_addr.host().c_str(), m_peer_addr.port());
+            close();
+            return;
+        }
+        
+        if(m_recv_msg_queue.length() < m_cur_msg_length)
+        {
+            return;
+        }
+
+        if(rate_limited(m_cur_msg_length))
+        {
+            continue;
+        }
+
+        //copied straight from the chunks into the message
+        std::unique_ptr<Message<Json>> message(new Message<Json>(shared_from_this()));
+        message->m_raw_data.resize(m_cur_msg_length);
+        m_recv_msg_queue.read(&message->m_raw_data[0], m_cur_msg_length);
+        message->m_length = m_cur_msg_length;
+        m_cur_msg_length = 0;
+        
+        rapidjson::Document &doc = message->doc();
+        doc.Parse(message->m_raw_data.c_str());
+
+        if(doc.HasParseError())
+        {
+            LOG_DEBUG_ERROR("parse json message failed from %s:%u, reason: %s", m_peer_addr.host().c_str(), m_peer_addr.port(), \
+                            GetParseError_En(doc.GetParseError()));
+            close();
+            return;
+        }
+
+        if(!doc.IsObject())
+        {
+            close();
+            return;
+        }
+        
+        if(!doc.HasMember("msg_type"))
+        {
+            close();
+            return;
+        }
+            
+        const rapidjson::Value &msg_type = doc["msg_type"];
+
+        if(!msg_type.IsUint())
+        {
+            close();
+            return;
+        }
+            
+        message->m_type = msg_type.GetUint();
+
+        if(!doc.HasMember("msg_cmd"))
+        {
+            close();
+            return;
+        }
+            
+        const rapidjson::Value &msg_cmd = doc["msg_cmd"];
+
+        if(!msg_cmd.IsUint())
+        {
+            close();
+            return;
+        }
+            
+        message->m_cmd = msg_cmd.GetUint();
+        track_message(message.get());
+        m_dispatch_cb(std::move(message));
+    }
+}
+
+//Wsock
+fly::base::ID_Allocator Connection<Wsock>::m_id_allocator;
+
+Connection<Wsock>::~Connection()
+{
+    while(auto *message_chunk = m_recv_msg_queue.pop())
+    {
+        delete message_chunk;
+    }
+
+    while(auto *message_chunk = m_send_msg_queue.pop())
+    {
+        delete message_chunk;
+    }
+}
+
+Connection<Wsock>::Connection(int32 fd, const Addr &peer_addr)
+{
+    m_fd = fd;
+    m_peer_addr = peer_addr;
+    m_is_passive = true;
+}
+
+bool Connection<Wsock>::is_passive()
+{
+    return m_is_passive;
+}
+
+void Connection<Wsock>::set_passive(bool is_passive)
+{
+    m_is_passive = is_passive;
+}
+
+uint64 Connection<Wsock>::id()
+{
+    return m_id;
+}
+
+std::string Connection<Wsock>::key() const
+{
+    return m_key;
+}
+
+void Connection<Wsock>::key(std::string k)
+{
+    m_key = k;
+}
+
+bool Connection<Wsock>::send(rapidjson::Document &doc)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    doc.Accept(writer);
+    return send(buffer.GetString(), buffer.GetSize());
+}
+
+void Connection<Wsock>::send_raw(const void *data, uint32 size)
+{
+    Message_Chunk *message_chunk = new Message_Chunk(size);
+    memcpy(message_chunk->read_ptr(), data, size);
+    message_chunk->write_ptr(size);
+    m_send_msg_queue.push(message_chunk);
+    schedule_write();
+}
+
+bool Connection<Wsock>::send(const void *data, uint32 size)
+{
+    if(send_blocked())
+    {
+        return false;
+    }
+    
+    //assemble websocket packet
+    char *buf, *p_data;
+    Message_Chunk *message_chunk;
+    
+    if(size > 0xffff)
+    {
+        message_chunk = new Message_Chunk(size + 10);
         message_chunk->write_ptr(size + 10);
         buf = message_chunk->read_ptr();
         buf[1] = 127;
@@ -357,35 +668,415 @@ void Connection<Wsock>::send(const void *data, uint32 size)
         *p_length = fly::base::htonll(size);
         p_data = buf + 10;
     }
-    else if(size > 125)
+    else if(size > 125)
+    {
+        message_chunk = new Message_Chunk(size + 4);
+        message_chunk->write_ptr(size + 4);
+        buf = message_chunk->read_ptr();
+        buf[1] = 126;
+        uint16 *p_length = (uint16*)(buf + 2);
+        *p_length = htons(size);
+        p_data = buf + 4;
+    }
+    else
+    {
+        message_chunk = new Message_Chunk(size + 2);
+        message_chunk->write_ptr(size + 2);
+        buf = message_chunk->read_ptr();
+        buf[1] = size;
+        p_data = buf + 2;
+    }
+    
+    buf[0] = 0x81;
+    memcpy(p_data, data, size);
+    m_send_msg_queue.push(message_chunk);
+    schedule_write();
+
+    return true;
+}
+
+//data is held until the kernel releases it when sent with MSG_ZEROCOPY, it must not be modified meanwhile
+bool Connection<Wsock>::send(std::shared_ptr<const std::string> data)
+{
+    uint32 size = data->size();
+
+    if(m_zerocopy_threshold == 0 || size < m_zerocopy_threshold)
+    {
+        return send(data->data(), size);
+    }
+
+    if(send_blocked())
+    {
+        return false;
+    }
+    
+    Message_Chunk *message_chunks[2];
+    message_chunks[0] = new_frame_header(size);
+    message_chunks[1] = new Message_Chunk(data);
+    m_send_msg_queue.push(message_chunks, 2);
+    schedule_write();
+
+    return true;
+}
+
+//sends length bytes of the file from offset with sendfile, framed like send(data, size)
+//fd is dup'ed, the caller may close it right away, the file must not shrink meanwhile
+bool Connection<Wsock>::send_file(int32 fd, uint64 offset, uint32 length)
+{
+    if(send_blocked())
+    {
+        return false;
+    }
+    
+    int32 file_fd = dup(fd);
+
+    if(file_fd < 0)
+    {
+        LOG_ERROR("dup failed in Connection::send_file: %s", strerror(errno));
+
+        return false;
+    }
+    
+    Message_Chunk *message_chunks[2];
+    message_chunks[0] = new_frame_header(length);
+    message_chunks[1] = new Message_Chunk(file_fd, offset, length);
+    m_send_msg_queue.push(message_chunks, 2);
+    schedule_write();
+
+    return true;
+}
+
+//only the websocket header, the payload follows in its own chunk
+Message_Chunk* Connection<Wsock>::new_frame_header(uint32 size)
+{
+    Message_Chunk *message_chunk = new Message_Chunk(10);
+    char *buf = message_chunk->read_ptr();
+    buf[0] = 0x81;
+    
+    if(size > 0xffff)
+    {
+        buf[1] = 127;
+        uint64 *p_length = (uint64*)(buf + 2);
+        *p_length = fly::base::htonll(size);
+        message_chunk->write_ptr(10);
+    }
+    else if(size > 125)
+    {
+        buf[1] = 126;
+        uint16 *p_length = (uint16*)(buf + 2);
+        *p_length = htons(size);
+        message_chunk->write_ptr(4);
+    }
+    else
+    {
+        buf[1] = size;
+        message_chunk->write_ptr(2);
+    }
+
+    return message_chunk;
+}
+
+//stops reading after the current batch, the unread bytes stay in the socket so tcp pushes back on the peer
+void Connection<Wsock>::pause_read()
+{
+    m_read_pause.fetch_or(READ_PAUSE_USER);
+}
+
+void Connection<Wsock>::resume_read()
+{
+    unpause_read(READ_PAUSE_USER);
+}
+
+bool Connection<Wsock>::read_paused()
+{
+    return m_read_pause.load(std::memory_order_relaxed) != 0;
+}
+
+//reading pauses while more than max dispatched messages are alive and resumes once half of them are destroyed
+//0 disables it, set it in init_cb
+void Connection<Wsock>::set_max_pending_messages(uint32 max)
+{
+    m_max_pending_msgs = max;
+}
+
+uint32 Connection<Wsock>::pending_messages()
+{
+    return m_pending_msgs.load(std::memory_order_relaxed);
+}
+
+void Connection<Wsock>::unpause_read(uint8 reason)
+{
+    //only the one clearing the last reason resumes
+    if(m_read_pause.fetch_and(~reason) == reason)
+    {
+        poller_task()->resume_read(shared_from_this());
+    }
+}
+
+void Connection<Wsock>::track_message(Message<Wsock> *message)
+{
+    if(m_max_pending_msgs == 0)
+    {
+        return;
+    }
+
+    message->m_tracked = true;
+
+    if(m_pending_msgs.fetch_add(1) + 1 > m_max_pending_msgs)
+    {
+        m_read_pause.fetch_or(READ_PAUSE_AUTO);
+
+        //the messages may have been destroyed before the flag was set, see message_done
+        if(m_pending_msgs.load() <= m_max_pending_msgs / 2)
+        {
+            unpause_read(READ_PAUSE_AUTO);
+        }
+    }
+}
+
+//called by the destructor of a tracked message, from any thread
+void Connection<Wsock>::message_done()
+{
+    if(m_pending_msgs.fetch_sub(1) - 1 <= m_max_pending_msgs / 2 && (m_read_pause.load() & READ_PAUSE_AUTO))
+    {
+        unpause_read(READ_PAUSE_AUTO);
+    }
+}
+
+//swapped by a migration while other threads send, see Poller::migrate
+Poller_Task<Wsock>* Connection<Wsock>::poller_task()
+{
+    return m_poller_task.load(std::memory_order_acquire);
+}
+
+//the poller is draining: reading stops for good and the read half is shut down, the sends go on
+void Connection<Wsock>::drain()
+{
+    m_read_pause.fetch_or(READ_PAUSE_DRAIN);
+
+    //on the ring a shut down read half makes the writev in flight fail with EAGAIN, the pause is enough there
+    if(!m_uring_ctx)
+    {
+        shutdown(m_fd, SHUT_RD);
+    }
+}
+
+//limits the messages received by this connection, on top of the peer limit of the poller (see Poller::set_peer_rate_limit)
+//set it in init_cb, a limit without any rate removes it
+void Connection<Wsock>::set_rate_limit(const Rate_Limit &limit)
+{
+    Rate_Limiter *rate_limiter = new Rate_Limiter(limit);
+
+    if(!rate_limiter->enabled())
+    {
+        delete rate_limiter;
+        rate_limiter = nullptr;
+    }
+
+    m_rate_limiter.reset(rate_limiter);
+}
+
+//checked once a whole message is buffered, before it's copied out or parsed. true if it must not be dispatched now,
+//a dropped message is skipped already, otherwise the read is paused
+bool Connection<Wsock>::rate_limited(uint32 length)
+{
+    if(!m_rate_limiter && m_peer_key == 0)
+    {
+        return false;
+    }
+
+    uint64 now_ns = fly::base::monotonic_ns();
+    uint64 wait_ns = 0;
+    RATE_LIMIT_ACTION action = RATE_LIMIT_DROP;
+
+    if(m_rate_limiter)
+    {
+        wait_ns = m_rate_limiter->admit(m_rate_buckets, length, now_ns);
+        action = m_rate_limiter->action();
+    }
+
+    if(wait_ns == 0 && m_peer_key != 0)
+    {
+        Peer_Rate_Table *peer_rate_table = poller_task()->m_peer_rate_table.get();
+        Rate_Buckets *buckets = peer_rate_table->find(m_peer_key, poller_task()->m_now_ms);
+
+        //a full table lets the peer through
+        if(buckets != nullptr)
+        {
+            wait_ns = peer_rate_table->limiter().admit(*buckets, length, now_ns);
+            action = peer_rate_table->limiter().action();
+
+            //only the breached limit is charged
+            if(wait_ns > 0 && m_rate_limiter)
+            {
+                m_rate_limiter->refund(m_rate_buckets, length);
+            }
+        }
+    }
+
+    if(wait_ns == 0)
+    {
+        return false;
+    }
+
+    if(action == RATE_LIMIT_DROP)
+    {
+        poller_task()->m_rate_drop_count.fetch_add(1, std::memory_order_relaxed);
+
+        //the 4 bytes mask too
+        m_recv_msg_queue.skip(length + 4);
+        m_cur_msg_length = 0;
+        m_cur_msg_length_1 = 0;
+
+        return true;
+    }
+
+    m_read_pause.fetch_or(READ_PAUSE_RATE);
+
+    if(action == RATE_LIMIT_CLOSE)
     {
-        message_chunk = new Message_Chunk(size + 4);
-        message_chunk->write_ptr(size + 4);
-        buf = message_chunk->read_ptr();
-        buf[1] = 126;
-        uint16 *p_length = (uint16*)(buf + 2);
-        *p_length = htons(size);
-        p_data = buf + 4;
+        poller_task()->m_rate_close_count.fetch_add(1, std::memory_order_relaxed);
+        LOG_DEBUG_INFO("wsock message rate limit exceeded from %s:%u, close it", m_peer_addr.host().c_str(), m_peer_addr.port());
+        close();
+
+        return true;
     }
-    else
+
+    poller_task()->m_rate_delay_count.fetch_add(1, std::memory_order_relaxed);
+    std::shared_ptr<Connection> self = shared_from_this();
+    poller_task()->run_after(wait_ns / 1000000 + 1, [self]
     {
-        message_chunk = new Message_Chunk(size + 2);
-        message_chunk->write_ptr(size + 2);
-        buf = message_chunk->read_ptr();
-        buf[1] = size;
-        p_data = buf + 2;
+        self->unpause_read(READ_PAUSE_RATE);
+    });
+
+    return true;
+}
+
+//send() and send_file() fail once the queued bytes reach high, drain_cb is called from the poller thread
+//after they fell to low again. high == 0 disables the limit, set it in init_cb
+void Connection<Wsock>::set_send_watermarks(uint32 high, uint32 low, std::function<void(std::shared_ptr<Connection>)> drain_cb)
+{
+    m_send_high_watermark = high;
+    m_send_low_watermark = low;
+    m_drain_cb = drain_cb;
+}
+
+uint32 Connection<Wsock>::send_queue_length()
+{
+    return m_send_msg_queue.length();
+}
+
+bool Connection<Wsock>::send_blocked()
+{
+    if(m_send_high_watermark == 0 || m_send_msg_queue.length() < m_send_high_watermark)
+    {
+        return false;
     }
-    
-    buf[0] = 0x81;
-    memcpy(p_data, data, size);
-    m_send_msg_queue.push(message_chunk);
-    m_poller_task->write_connection(shared_from_this());
+
+    //pairs with the fence in Poller_Task::check_drain, either the poller sees the flag or this sees the drained queue
+    m_send_blocked.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    return m_send_msg_queue.length() >= m_send_high_watermark;
+}
+
+//sends between cork() and uncork() only queue, uncork() hands them to the poller at once so they leave in
+//one writev instead of one per message. nests, the last uncork() flushes
+void Connection<Wsock>::cork()
+{
+    m_cork.fetch_add(1);
+}
+
+void Connection<Wsock>::uncork()
+{
+    if(m_cork.fetch_sub(1) == 1 && m_send_msg_queue.length() > 0)
+    {
+        poller_task()->write_connection(shared_from_this());
+    }
+}
+
+void Connection<Wsock>::schedule_write()
+{
+    if(m_cork.load() > 0)
+    {
+        return;
+    }
+
+    poller_task()->write_connection(shared_from_this());
+}
+
+//payloads of at least threshold bytes passed to send(data) go out with MSG_ZEROCOPY, 0 disables it
+//only supported by the epoll backend
+bool Connection<Wsock>::set_zerocopy_threshold(uint32 threshold)
+{
+    if(threshold > 0)
+    {
+        if(poller_task() != nullptr && poller_task()->backend() != POLLER_EPOLL)
+        {
+            LOG_ERROR("zerocopy is only supported by the epoll backend in Connection::set_zerocopy_threshold");
+
+            return false;
+        }
+        
+        int32 opt = 1;
+
+        if(setsockopt(m_fd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt)) < 0)
+        {
+            LOG_ERROR("setsockopt SO_ZEROCOPY failed in Connection::set_zerocopy_threshold: %s", strerror(errno));
+
+            return false;
+        }
+    }
+
+    m_zerocopy_threshold = threshold;
+
+    return true;
 }
 
 void Connection<Wsock>::close()
 {
     //base::crash_me();
-    m_poller_task->close_connection(shared_from_this());
+    poller_task()->close_connection(shared_from_this());
+}
+
+//closes the connection if nothing is received for timeout_ms, 0 disables it
+void Connection<Wsock>::set_idle_timeout(uint32 timeout_ms)
+{
+    m_idle_timeout = timeout_ms;
+    uint32 gen = m_idle_gen.fetch_add(1, std::memory_order_relaxed) + 1;
+    
+    if(poller_task() != nullptr && timeout_ms > 0)
+    {
+        poller_task()->watch_idle(shared_from_this(), gen, timeout_ms, timeout_ms);
+    }
+}
+
+//cb runs on the poller thread when nothing is received for interval_ms, 0 disables it
+void Connection<Wsock>::set_heartbeat_interval(uint32 interval_ms, std::function<void(std::shared_ptr<Connection>)> cb)
+{
+    m_heartbeat_interval = interval_ms;
+    m_heartbeat_cb = cb;
+    uint32 gen = m_heartbeat_gen.fetch_add(1, std::memory_order_relaxed) + 1;
+    
+    if(poller_task() != nullptr && interval_ms > 0)
+    {
+        poller_task()->watch_heartbeat(shared_from_this(), gen, interval_ms, cb, interval_ms);
+    }
+}
+
+uint64 Connection<Wsock>::run_after(uint32 delay_ms, std::function<void()> cb)
+{
+    return poller_task()->run_after(delay_ms, cb);
+}
+
+uint64 Connection<Wsock>::run_every(uint32 interval_ms, std::function<void()> cb)
+{
+    return poller_task()->run_every(interval_ms, cb);
+}
+
+void Connection<Wsock>::cancel_timer(uint64 timer_id)
+{
+    poller_task()->cancel_timer(timer_id);
 }
 
 bool Connection<Wsock>::closed()
@@ -482,6 +1173,12 @@ void Connection<Wsock>::parse()
 
     while(true)
     {
+        //paused, the buffered bytes are parsed by resume_read
+        if(m_read_pause.load(std::memory_order_relaxed) != 0)
+        {
+            return;
+        }
+
         if(m_cur_msg_length != 0)
         {
             if(m_cur_msg_length_1 != 0)
@@ -528,14 +1225,14 @@ void Connection<Wsock>::parse()
 
             if(fin == 0)
             {
-                LOG_DEBUG_ERROR("recv websocket but fin == 0 from %s:%u", m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
+                LOG_DEBUG_ERROR("recv websocket but fin == 0 from %s:%u", m_peer_addr.host().c_str(), m_peer_addr.port());
                 close();
                 return;
             }
 
             if((buf[0] & 0x70) != 0)
             {
-                LOG_DEBUG_ERROR("recv websocket but (buf[0] & 0x70) != 0 from %s:%u", m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
+                LOG_DEBUG_ERROR("recv websocket but (buf[0] & 0x70) != 0 from %s:%u", m_peer_addr.host().c_str(), m_peer_addr.port());
                 close();
                 return;
             }
@@ -548,13 +1245,13 @@ void Connection<Wsock>::parse()
             }
             else if(op_code == 0x08) //close
             {
-                LOG_DEBUG_INFO("recv websocket close protocol from %s:%u", m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
+                LOG_DEBUG_INFO("recv websocket close protocol from %s:%u", m_peer_addr.host().c_str(), m_peer_addr.port());
                 close();
                 return;
             }
             else if(op_code == 0x09) //ping
             {
-                LOG_DEBUG_INFO("recv websocket ping protocol from %s:%u", m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
+                LOG_DEBUG_INFO("recv websocket ping protocol from %s:%u", m_peer_addr.host().c_str(), m_peer_addr.port());
                 char *buf, *p_data;
                 Message_Chunk *message_chunk = new Message_Chunk(2);
                 message_chunk->write_ptr(2);
@@ -562,25 +1259,25 @@ void Connection<Wsock>::parse()
                 buf[1] = 0;
                 buf[0] = 0x8a;
                 m_send_msg_queue.push(message_chunk);
-                m_poller_task->write_connection(shared_from_this());
+                schedule_write();
                 is_ping_packet = true;
             }
             else if(op_code == 0x0a) //pong
             {
-                LOG_DEBUG_ERROR("recv websocket pong protocol from %s:%u", m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
+                LOG_DEBUG_ERROR("recv websocket pong protocol from %s:%u", m_peer_addr.host().c_str(), m_peer_addr.port());
                 close();
                 return;
             }
             else
             {
-                LOG_DEBUG_ERROR("recv websocket other protocol from %s:%u", m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
+                LOG_DEBUG_ERROR("recv websocket other protocol from %s:%u", m_peer_addr.host().c_str(), m_peer_addr.port());
                 close();
                 return;
             }
             
             if((buf[1] & 0x80) == 0)
             {
-                LOG_DEBUG_ERROR("recv websocket but (buf[1] & 0x80) == 0 buf[1]: %u from %s:%u", buf[1], m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
+                LOG_DEBUG_ERROR("recv websocket but (buf[1] & 0x80) == 0 buf[1]: %u from %s:%u", buf[1], m_peer_addr.host().c_str(), m_peer_addr.port());
                 close();
                 return;
             }
@@ -591,7 +1288,7 @@ void Connection<Wsock>::parse()
             {
                 if(!is_ping_packet)
                 {
-                    LOG_DEBUG_ERROR("recv websocket but (buf[1] & 0x7f) == 0 from %s:%u", m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
+                    LOG_DEBUG_ERROR("recv websocket but (buf[1] & 0x7f) == 0 from %s:%u", m_peer_addr.host().c_str(), m_peer_addr.port());
                     close();
                     return;
                 }
@@ -706,7 +1403,7 @@ void Connection<Wsock>::parse()
 
         if(msg_length > m_max_msg_length)
         {
-            LOG_DEBUG_ERROR("wsock message length(%lu) exceed max_msg_length(%u) from %s:%u", msg_length, m_max_msg_length, m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
+            LOG_DEBUG_ERROR("wsock message length(%lu) exceed max_msg_length(%u) from %s:%u", msg_length, m_max_msg_length, m_peer_addr.host().c_str(), m_peer_addr.port());
             close();
             return;
         }
@@ -716,6 +1413,11 @@ void Connection<Wsock>::parse()
         {
             return;
         }
+
+        if(msg_length > 0 && rate_limited(msg_length))
+        {
+            continue;
+        }
         
         char mask_keys[4] = {0};
         uint32 remain_bytes = 4;
@@ -810,7 +1512,7 @@ void Connection<Wsock>::parse()
                 
             if(doc.HasParseError())
             {
-                LOG_DEBUG_ERROR("websocket parse json failed from %s:%u, reason: %s", m_peer_addr.m_host.c_str(), m_peer_addr.m_port, \
+                LOG_DEBUG_ERROR("websocket parse json failed from %s:%u, reason: %s", m_peer_addr.host().c_str(), m_peer_addr.port(), \
                                 GetParseError_En(doc.GetParseError()));
                 close();
                 return;
@@ -824,115 +1526,479 @@ void Connection<Wsock>::parse()
         
             if(!doc.HasMember("msg_type"))
             {
-                LOG_DEBUG_ERROR("websocket parse msg_type failed from %s:%u", m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
+                LOG_DEBUG_ERROR("websocket parse msg_type failed from %s:%u", m_peer_addr.host().c_str(), m_peer_addr.port());
                 close();
                 return;
             }
                     
             const rapidjson::Value &msg_type = doc["msg_type"];
 
-            if(!msg_type.IsUint())
-            {
-                close();
-                return;
-            }
+            if(!msg_type.IsUint())
+            {
+                close();
+                return;
+            }
+
+            message->m_type = msg_type.GetUint();
+
+            if(!doc.HasMember("msg_cmd"))
+            {
+                LOG_DEBUG_ERROR("websocket parse msg_cmd failed from %s:%u", m_peer_addr.host().c_str(), m_peer_addr.port());
+                close();
+                return;
+            }
+        
+            const rapidjson::Value &msg_cmd = doc["msg_cmd"];
+
+            if(!msg_cmd.IsUint())
+            {
+                close();
+                return;
+            }
+        
+            message->m_cmd = msg_cmd.GetUint();
+            track_message(message.get());
+            m_dispatch_cb(std::move(message));
+        }
+        
+        m_cur_msg_length = 0;
+        m_cur_msg_length_1 = 0;
+    }
+}
+
+//Proto
+fly::base::ID_Allocator Connection<Proto>::m_id_allocator;
+
+Connection<Proto>::~Connection()
+{
+    while(auto *message_chunk = m_recv_msg_queue.pop())
+    {
+        delete message_chunk;
+    }
+
+    while(auto *message_chunk = m_send_msg_queue.pop())
+    {
+        delete message_chunk;
+    }
+}
+
+Connection<Proto>::Connection(int32 fd, const Addr &peer_addr)
+{
+    m_fd = fd;
+    m_peer_addr = peer_addr;
+    m_is_passive = true;
+}
+
+bool Connection<Proto>::is_passive()
+{
+    return m_is_passive;
+}
+
+void Connection<Proto>::set_passive(bool is_passive)
+{
+    m_is_passive = is_passive;
+}
+
+std::string Connection<Proto>::key() const
+{
+    return m_key;
+}
+
+void Connection<Proto>::key(std::string k)
+{
+    m_key = k;
+}
+
+uint64 Connection<Proto>::id()
+{
+    return m_id;
+}
+
+bool Connection<Proto>::send(rapidjson::Document &doc)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    doc.Accept(writer);
+    return send(buffer.GetString(), buffer.GetSize());
+}
+
+bool Connection<Proto>::send(const void *data, uint32 size)
+{
+    if(send_blocked())
+    {
+        return false;
+    }
+    
+    Message_Chunk *message_chunk = new Message_Chunk(size + sizeof(uint32));
+    uint32 *uint32_ptr = (uint32*)message_chunk->read_ptr();
+    *uint32_ptr = htonl(size);
+    memcpy(message_chunk->read_ptr() + sizeof(uint32), data, size);
+    message_chunk->write_ptr(size + sizeof(uint32));
+    m_send_msg_queue.push(message_chunk);
+    schedule_write();
+
+    return true;
+}
+
+//data is held until the kernel releases it when sent with MSG_ZEROCOPY, it must not be modified meanwhile
+bool Connection<Proto>::send(std::shared_ptr<const std::string> data)
+{
+    uint32 size = data->size();
+
+    if(m_zerocopy_threshold == 0 || size < m_zerocopy_threshold)
+    {
+        return send(data->data(), size);
+    }
+
+    if(send_blocked())
+    {
+        return false;
+    }
+    
+    Message_Chunk *message_chunks[2];
+    message_chunks[0] = new_frame_header(size);
+    message_chunks[1] = new Message_Chunk(data);
+    m_send_msg_queue.push(message_chunks, 2);
+    schedule_write();
+
+    return true;
+}
+
+//sends length bytes of the file from offset with sendfile, framed like send(data, size)
+//fd is dup'ed, the caller may close it right away, the file must not shrink meanwhile
+bool Connection<Proto>::send_file(int32 fd, uint64 offset, uint32 length)
+{
+    if(send_blocked())
+    {
+        return false;
+    }
+    
+    int32 file_fd = dup(fd);
+
+    if(file_fd < 0)
+    {
+        LOG_ERROR("dup failed in Connection::send_file: %s", strerror(errno));
+
+        return false;
+    }
+    
+    Message_Chunk *message_chunks[2];
+    message_chunks[0] = new_frame_header(length);
+    message_chunks[1] = new Message_Chunk(file_fd, offset, length);
+    m_send_msg_queue.push(message_chunks, 2);
+    schedule_write();
+
+    return true;
+}
+
+//only the length prefix of a frame, the payload follows in its own chunk
+Message_Chunk* Connection<Proto>::new_frame_header(uint32 size)
+{
+    Message_Chunk *message_chunk = new Message_Chunk(sizeof(uint32));
+    uint32 *uint32_ptr = (uint32*)message_chunk->read_ptr();
+    *uint32_ptr = htonl(size);
+    message_chunk->write_ptr(sizeof(uint32));
+
+    return message_chunk;
+}
+
+//stops reading after the current batch, the unread bytes stay in the socket so tcp pushes back on the peer
+void Connection<Proto>::pause_read()
+{
+    m_read_pause.fetch_or(READ_PAUSE_USER);
+}
+
+void Connection<Proto>::resume_read()
+{
+    unpause_read(READ_PAUSE_USER);
+}
+
+bool Connection<Proto>::read_paused()
+{
+    return m_read_pause.load(std::memory_order_relaxed) != 0;
+}
+
+//reading pauses while more than max dispatched messages are alive and resumes once half of them are destroyed
+//0 disables it, set it in init_cb
+void Connection<Proto>::set_max_pending_messages(uint32 max)
+{
+    m_max_pending_msgs = max;
+}
+
+uint32 Connection<Proto>::pending_messages()
+{
+    return m_pending_msgs.load(std::memory_order_relaxed);
+}
+
+void Connection<Proto>::unpause_read(uint8 reason)
+{
+    //only the one clearing the last reason resumes
+    if(m_read_pause.fetch_and(~reason) == reason)
+    {
+        poller_task()->resume_read(shared_from_this());
+    }
+}
+
+void Connection<Proto>::track_message(Message<Proto> *message)
+{
+    if(m_max_pending_msgs == 0)
+    {
+        return;
+    }
+
+    message->m_tracked = true;
+
+    if(m_pending_msgs.fetch_add(1) + 1 > m_max_pending_msgs)
+    {
+        m_read_pause.fetch_or(READ_PAUSE_AUTO);
+
+        //the messages may have been destroyed before the flag was set, see message_done
+        if(m_pending_msgs.load() <= m_max_pending_msgs / 2)
+        {
+            unpause_read(READ_PAUSE_AUTO);
+        }
+    }
+}
+
+//called by the destructor of a tracked message, from any thread
+void Connection<Proto>::message_done()
+{
+    if(m_pending_msgs.fetch_sub(1) - 1 <= m_max_pending_msgs / 2 && (m_read_pause.load() & READ_PAUSE_AUTO))
+    {
+        unpause_read(READ_PAUSE_AUTO);
+    }
+}
 
-            message->m_type = msg_type.GetUint();
+//swapped by a migration while other threads send, see Poller::migrate
+Poller_Task<Proto>* Connection<Proto>::poller_task()
+{
+    return m_poller_task.load(std::memory_order_acquire);
+}
 
-            if(!doc.HasMember("msg_cmd"))
-            {
-                LOG_DEBUG_ERROR("websocket parse msg_cmd failed from %s:%u", m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
-                close();
-                return;
-            }
-        
-            const rapidjson::Value &msg_cmd = doc["msg_cmd"];
+//the poller is draining: reading stops for good and the read half is shut down, the sends go on
+void Connection<Proto>::drain()
+{
+    m_read_pause.fetch_or(READ_PAUSE_DRAIN);
 
-            if(!msg_cmd.IsUint())
+    //on the ring a shut down read half makes the writev in flight fail with EAGAIN, the pause is enough there
+    if(!m_uring_ctx)
+    {
+        shutdown(m_fd, SHUT_RD);
+    }
+}
+
+//limits the messages received by this connection, on top of the peer limit of the poller (see Poller::set_peer_rate_limit)
+//set it in init_cb, a limit without any rate removes it
+void Connection<Proto>::set_rate_limit(const Rate_Limit &limit)
+{
+    Rate_Limiter *rate_limiter = new Rate_Limiter(limit);
+
+    if(!rate_limiter->enabled())
+    {
+        delete rate_limiter;
+        rate_limiter = nullptr;
+    }
+
+    m_rate_limiter.reset(rate_limiter);
+}
+
+//checked once a whole message is buffered, before it's copied out or parsed. true if it must not be dispatched now,
+//a dropped message is skipped already, otherwise the read is paused
+bool Connection<Proto>::rate_limited(uint32 length)
+{
+    if(!m_rate_limiter && m_peer_key == 0)
+    {
+        return false;
+    }
+
+    uint64 now_ns = fly::base::monotonic_ns();
+    uint64 wait_ns = 0;
+    RATE_LIMIT_ACTION action = RATE_LIMIT_DROP;
+
+    if(m_rate_limiter)
+    {
+        wait_ns = m_rate_limiter->admit(m_rate_buckets, length, now_ns);
+        action = m_rate_limiter->action();
+    }
+
+    if(wait_ns == 0 && m_peer_key != 0)
+    {
+        Peer_Rate_Table *peer_rate_table = poller_task()->m_peer_rate_table.get();
+        Rate_Buckets *buckets = peer_rate_table->find(m_peer_key, poller_task()->m_now_ms);
+
+        //a full table lets the peer through
+        if(buckets != nullptr)
+        {
+            wait_ns = peer_rate_table->limiter().admit(*buckets, length, now_ns);
+            action = peer_rate_table->limiter().action();
+
+            //only the breached limit is charged
+            if(wait_ns > 0 && m_rate_limiter)
             {
-                close();
-                return;
+                m_rate_limiter->refund(m_rate_buckets, length);
             }
-        
-            message->m_cmd = msg_cmd.GetUint();
-            m_dispatch_cb(std::move(message));
         }
-        
+    }
+
+    if(wait_ns == 0)
+    {
+        return false;
+    }
+
+    if(action == RATE_LIMIT_DROP)
+    {
+        poller_task()->m_rate_drop_count.fetch_add(1, std::memory_order_relaxed);
+        m_recv_msg_queue.skip(length);
         m_cur_msg_length = 0;
-        m_cur_msg_length_1 = 0;
+
+        return true;
     }
-}
 
-//Proto
-fly::base::ID_Allocator Connection<Proto>::m_id_allocator;
+    m_read_pause.fetch_or(READ_PAUSE_RATE);
 
-Connection<Proto>::~Connection()
-{
-    while(auto *message_chunk = m_recv_msg_queue.pop())
+    if(action == RATE_LIMIT_CLOSE)
     {
-        delete message_chunk;
+        poller_task()->m_rate_close_count.fetch_add(1, std::memory_order_relaxed);
+        LOG_DEBUG_INFO("proto message rate limit exceeded from %s:%u, close it", m_peer_addr.host().c_str(), m_peer_addr.port());
+        close();
+
+        return true;
     }
 
-    while(auto *message_chunk = m_send_msg_queue.pop())
+    poller_task()->m_rate_delay_count.fetch_add(1, std::memory_order_relaxed);
+    std::shared_ptr<Connection> self = shared_from_this();
+    poller_task()->run_after(wait_ns / 1000000 + 1, [self]
     {
-        delete message_chunk;
+        self->unpause_read(READ_PAUSE_RATE);
+    });
+
+    return true;
+}
+
+//send() and send_file() fail once the queued bytes reach high, drain_cb is called from the poller thread
+//after they fell to low again. high == 0 disables the limit, set it in init_cb
+void Connection<Proto>::set_send_watermarks(uint32 high, uint32 low, std::function<void(std::shared_ptr<Connection>)> drain_cb)
+{
+    m_send_high_watermark = high;
+    m_send_low_watermark = low;
+    m_drain_cb = drain_cb;
+}
+
+uint32 Connection<Proto>::send_queue_length()
+{
+    return m_send_msg_queue.length();
+}
+
+bool Connection<Proto>::send_blocked()
+{
+    if(m_send_high_watermark == 0 || m_send_msg_queue.length() < m_send_high_watermark)
+    {
+        return false;
     }
+
+    //pairs with the fence in Poller_Task::check_drain, either the poller sees the flag or this sees the drained queue
+    m_send_blocked.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    return m_send_msg_queue.length() >= m_send_high_watermark;
 }
 
-Connection<Proto>::Connection(int32 fd, const Addr &peer_addr)
+//sends between cork() and uncork() only queue, uncork() hands them to the poller at once so they leave in
+//one writev instead of one per message. nests, the last uncork() flushes
+void Connection<Proto>::cork()
 {
-    m_fd = fd;
-    m_peer_addr = peer_addr;
-    m_is_passive = true;
+    m_cork.fetch_add(1);
 }
 
-bool Connection<Proto>::is_passive()
+void Connection<Proto>::uncork()
 {
-    return m_is_passive;
+    if(m_cork.fetch_sub(1) == 1 && m_send_msg_queue.length() > 0)
+    {
+        poller_task()->write_connection(shared_from_this());
+    }
 }
 
-void Connection<Proto>::set_passive(bool is_passive)
+void Connection<Proto>::schedule_write()
 {
-    m_is_passive = is_passive;
+    if(m_cork.load() > 0)
+    {
+        return;
+    }
+
+    poller_task()->write_connection(shared_from_this());
 }
 
-std::string Connection<Proto>::key() const
+//payloads of at least threshold bytes passed to send(data) go out with MSG_ZEROCOPY, 0 disables it
+//only supported by the epoll backend
+bool Connection<Proto>::set_zerocopy_threshold(uint32 threshold)
 {
-    return m_key;
+    if(threshold > 0)
+    {
+        if(poller_task() != nullptr && poller_task()->backend() != POLLER_EPOLL)
+        {
+            LOG_ERROR("zerocopy is only supported by the epoll backend in Connection::set_zerocopy_threshold");
+
+            return false;
+        }
+        
+        int32 opt = 1;
+
+        if(setsockopt(m_fd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt)) < 0)
+        {
+            LOG_ERROR("setsockopt SO_ZEROCOPY failed in Connection::set_zerocopy_threshold: %s", strerror(errno));
+
+            return false;
+        }
+    }
+
+    m_zerocopy_threshold = threshold;
+
+    return true;
 }
 
-void Connection<Proto>::key(std::string k)
+void Connection<Proto>::close()
 {
-    m_key = k;
+    poller_task()->close_connection(shared_from_this());
 }
 
-uint64 Connection<Proto>::id()
+//closes the connection if nothing is received for timeout_ms, 0 disables it
+void Connection<Proto>::set_idle_timeout(uint32 timeout_ms)
 {
-    return m_id;
+    m_idle_timeout = timeout_ms;
+    uint32 gen = m_idle_gen.fetch_add(1, std::memory_order_relaxed) + 1;
+    
+    if(poller_task() != nullptr && timeout_ms > 0)
+    {
+        poller_task()->watch_idle(shared_from_this(), gen, timeout_ms, timeout_ms);
+    }
 }
 
-void Connection<Proto>::send(rapidjson::Document &doc)
+//cb runs on the poller thread when nothing is received for interval_ms, 0 disables it
+void Connection<Proto>::set_heartbeat_interval(uint32 interval_ms, std::function<void(std::shared_ptr<Connection>)> cb)
 {
-    rapidjson::StringBuffer buffer;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-    doc.Accept(writer);
-    send(buffer.GetString(), buffer.GetSize());
+    m_heartbeat_interval = interval_ms;
+    m_heartbeat_cb = cb;
+    uint32 gen = m_heartbeat_gen.fetch_add(1, std::memory_order_relaxed) + 1;
+    
+    if(poller_task() != nullptr && interval_ms > 0)
+    {
+        poller_task()->watch_heartbeat(shared_from_this(), gen, interval_ms, cb, interval_ms);
+    }
 }
 
-void Connection<Proto>::send(const void *data, uint32 size)
+uint64 Connection<Proto>::run_after(uint32 delay_ms, std::function<void()> cb)
 {
-    Message_Chunk *message_chunk = new Message_Chunk(size + sizeof(uint32));
-    uint32 *uint32_ptr = (uint32*)message_chunk->read_ptr();
-    *uint32_ptr = htonl(size);
-    memcpy(message_chunk->read_ptr() + sizeof(uint32), data, size);
-    message_chunk->write_ptr(size + sizeof(uint32));
-    m_send_msg_queue.push(message_chunk);
-    m_poller_task->write_connection(shared_from_this());
+    return poller_task()->run_after(delay_ms, cb);
 }
 
-void Connection<Proto>::close()
+uint64 Connection<Proto>::run_every(uint32 interval_ms, std::function<void()> cb)
+{
+    return poller_task()->run_every(interval_ms, cb);
+}
+
+void Connection<Proto>::cancel_timer(uint64 timer_id)
 {
-    m_poller_task->close_connection(shared_from_this());
+    poller_task()->cancel_timer(timer_id);
 }
 
 bool Connection<Proto>::closed()
@@ -949,164 +2015,98 @@ void Connection<Proto>::parse()
 {
     while(true)
     {
-        break; // unimplemented !!!
-        
-        char *msg_length_buf = (char*)(&m_cur_msg_length);
-        uint32 remain_bytes = sizeof(uint32);
-        
-        if(m_cur_msg_length != 0)
-        {
-            goto after_parse_length;
-        }
-        
-        if(m_recv_msg_queue.length() < sizeof(uint32))
+        //paused, the buffered bytes are parsed by resume_read
+        if(m_read_pause.load(std::memory_order_relaxed) != 0)
         {
-            break;
+            return;
         }
-        
-        while(auto *message_chunk = m_recv_msg_queue.pop())
+
+        if(m_cur_msg_length == 0)
         {
-            uint32 length = message_chunk->length();
-            
-            if(length < remain_bytes)
-            {
-                memcpy(msg_length_buf + sizeof(uint32) - remain_bytes, message_chunk->read_ptr(), length);
-                remain_bytes -= length;
-                delete message_chunk;
-            }
-            else
+            if(m_recv_msg_queue.length() < sizeof(uint32))
             {
-                memcpy(msg_length_buf + sizeof(uint32) - remain_bytes, message_chunk->read_ptr(), remain_bytes);
-
-                if(length == remain_bytes)
-                {
-                    delete message_chunk;
-                }
-                else
-                {
-                    message_chunk->read_ptr(remain_bytes);
-                    m_recv_msg_queue.push_front(message_chunk);
-                }
-                
                 break;
             }
+
+            m_recv_msg_queue.read((char*)&m_cur_msg_length, sizeof(uint32));
+            m_cur_msg_length = ntohl(m_cur_msg_length);
         }
         
-        m_cur_msg_length = ntohl(m_cur_msg_length);
-        
-    after_parse_length:
         if(m_cur_msg_length > m_max_msg_length)
         {
             LOG_DEBUG_ERROR("proto message length(%lu) exceed max_msg_length(%u) from %s:%u", m_cur_msg_length, m_max_msg_length, \
-                      m_peer_addr.m_host.c_str(), m_peer_addr.m_port);
+                      m_peer_addr.host().c_str(), m_peer_addr.port());
             close();
             return;
         }
-
+        
         if(m_recv_msg_queue.length() < m_cur_msg_length)
         {
             return;
         }
+
+        if(rate_limited(m_cur_msg_length))
+        {
+            continue;
+        }
+
+        //copied straight from the chunks into the message
+        std::unique_ptr<Message<Proto>> message(new Message<Proto>(shared_from_this()));
+        message->m_raw_data.resize(m_cur_msg_length);
+        m_recv_msg_queue.read(&message->m_raw_data[0], m_cur_msg_length);
+        message->m_length = m_cur_msg_length;
+        m_cur_msg_length = 0;
         
-        const uint32 MAX_STACK_SIZE = 512 * 1024;
-        char msg_buf[MAX_STACK_SIZE] = {0};
-        char *data = msg_buf;
-        bool is_new_buf = false;
-        remain_bytes = m_cur_msg_length;
+        rapidjson::Document &doc = message->doc();
+        doc.Parse(message->m_raw_data.c_str());
+
+        if(doc.HasParseError())
+        {
+            LOG_DEBUG_ERROR("parse json message failed from %s:%u, reason: %s", m_peer_addr.host().c_str(), m_peer_addr.port(), \
+                            GetParseError_En(doc.GetParseError()));
+            close();
+            return;
+        }
         
-        if(m_cur_msg_length > MAX_STACK_SIZE)
+        if(!doc.IsObject())
         {
-            data = new char[m_cur_msg_length];
-            is_new_buf = true;
+            close();
+            return;
         }
 
-        while(auto *message_chunk = m_recv_msg_queue.pop())
+        if(!doc.HasMember("msg_type"))
         {
-            uint32 length = message_chunk->length();
-
-            if(length < remain_bytes)
-            {
-                memcpy(data + m_cur_msg_length - remain_bytes, message_chunk->read_ptr(), length);
-                remain_bytes -= length;
-                delete message_chunk;
-            }
-            else
-            {
-                memcpy(data + m_cur_msg_length - remain_bytes, message_chunk->read_ptr(), remain_bytes);
-
-                if(length == remain_bytes)
-                {
-                    delete message_chunk;
-                }
-                else
-                {
-                    message_chunk->read_ptr(remain_bytes);
-                    m_recv_msg_queue.push_front(message_chunk);
-                }
-
-                std::unique_ptr<Message<Proto>> message(new Message<Proto>(shared_from_this()));
-                message->m_raw_data.assign(data, m_cur_msg_length);
-                message->m_length = m_cur_msg_length;
-                m_cur_msg_length = 0;
-                
-                if(is_new_buf)
-                {
-                    delete[] data;
-                }
-                
-                rapidjson::Document &doc = message->doc();
-                doc.Parse(message->m_raw_data.c_str());
-
-                if(doc.HasParseError())
-                {
-                    LOG_DEBUG_ERROR("parse json message failed from %s:%u, reason: %s", m_peer_addr.m_host.c_str(), m_peer_addr.m_port, \
-                                    GetParseError_En(doc.GetParseError()));
-                    close();
-                    return;
-                }
-                
-                if(!doc.IsObject())
-                {
-                    close();
-                    return;
-                }
-
-                if(!doc.HasMember("msg_type"))
-                {
-                    close();
-                    return;
-                }
-                    
-                const rapidjson::Value &msg_type = doc["msg_type"];
-
-                if(!msg_type.IsUint())
-                {
-                    close();
-                    return;
-                }
+            close();
+            return;
+        }
+            
+        const rapidjson::Value &msg_type = doc["msg_type"];
 
-                message->m_type = msg_type.GetUint();
+        if(!msg_type.IsUint())
+        {
+            close();
+            return;
+        }
 
-                if(!doc.HasMember("msg_cmd"))
-                {
-                    close();
-                    return;
-                }
+        message->m_type = msg_type.GetUint();
 
-                const rapidjson::Value &msg_cmd = doc["msg_cmd"];
+        if(!doc.HasMember("msg_cmd"))
+        {
+            close();
+            return;
+        }
 
-                if(!msg_cmd.IsUint())
-                {
-                    close();
-                    return;
-                }
-                    
-                message->m_cmd = msg_cmd.GetUint();
-                m_dispatch_cb(std::move(message));
+        const rapidjson::Value &msg_cmd = doc["msg_cmd"];
 
-                break;
-            }
+        if(!msg_cmd.IsUint())
+        {
+            close();
+            return;
         }
+            
+        message->m_cmd = msg_cmd.GetUint();
+        track_message(message.get());
+        m_dispatch_cb(std::move(message));
     }
 }
 
@@ -23,9 +23,11 @@
 #define FLY__NET__CONNECTION
 
 #include <memory>
+#include <deque>
 #include "fly/net/addr.hpp"
 #include "fly/net/message.hpp"
 #include "fly/net/message_chunk_queue.hpp"
+#include "fly/net/rate_limiter.hpp"
 
 namespace fly {
 namespace net {
@@ -33,6 +35,9 @@ namespace net {
 template<typename T>
 class Poller_Task;
 
+template<typename T>
+class Poller;
+
 template<typename T>
 class Client;
 
@@ -42,6 +47,8 @@ class Server;
 template<typename T>
 class Message;
 
+struct Uring_Context;
+
 template<typename T>
 class Connection {};
 
@@ -52,6 +59,8 @@ class Connection<Json> : public std::enable_shared_from_this<Connection<Json>>
     friend class Poller_Task<Json>;
     friend class Server<Json>;
     friend class Client<Json>;
+    friend class Poller<Json>;
+    friend class Message<Json>;
     
 public:
     Connection(int32 fd, const Addr &peer_addr);
@@ -59,29 +68,81 @@ public:
     uint64 id();
     void close();
     bool closed();
-    void send(const void *data, uint32 size);
-    void send(rapidjson::Document &doc);
+    bool send(const void *data, uint32 size);
+    bool send(std::shared_ptr<const std::string> data);
+    bool set_zerocopy_threshold(uint32 threshold);
+    bool send_file(int32 fd, uint64 offset, uint32 length);
+    void set_send_watermarks(uint32 high, uint32 low, std::function<void(std::shared_ptr<Connection>)> drain_cb);
+    uint32 send_queue_length();
+    void cork();
+    void uncork();
+    void pause_read();
+    void resume_read();
+    bool read_paused();
+    void set_max_pending_messages(uint32 max);
+    uint32 pending_messages();
+    void set_rate_limit(const Rate_Limit &limit);
+    bool send(rapidjson::Document &doc);
     const Addr& peer_addr();
     bool is_passive();
     void set_passive(bool is_passive);
     std::string key() const;
     void key(std::string k);
+    void set_idle_timeout(uint32 timeout_ms);
+    void set_heartbeat_interval(uint32 interval_ms, std::function<void(std::shared_ptr<Connection>)> cb);
+    uint64 run_after(uint32 delay_ms, std::function<void()> cb);
+    uint64 run_every(uint32 interval_ms, std::function<void()> cb);
+    void cancel_timer(uint64 timer_id);
 
 private:
     int32 m_fd;
     void parse();
+    Message_Chunk* new_frame_header(uint32 size);
+    bool send_blocked();
+    void schedule_write();
+    void unpause_read(uint8 reason);
+    void track_message(Message<Json> *message);
+    bool rate_limited(uint32 length);
+    void drain();
+    Poller_Task<Json>* poller_task();
+    void message_done();
     uint64 m_id = 0;
     uint32 m_max_msg_length = 0;
+    uint8 m_recv_size_class = 0;
     uint32 m_cur_msg_length = 0;
     bool m_stop_parse = false;
     Addr m_peer_addr;
     bool m_is_passive;
     std::string m_key;
     std::atomic<bool> m_closed {false};
+    std::atomic<bool> m_write_pending {false};
+    std::atomic<uint32> m_cork {0};
     std::shared_ptr<Connection> m_self; //add ref
     Message_Chunk_Queue m_recv_msg_queue;
     Message_Chunk_Queue m_send_msg_queue;
-    Poller_Task<Json> *m_poller_task = nullptr;
+    std::unique_ptr<Uring_Context> m_uring_ctx;
+    std::atomic<Poller_Task<Json>*> m_poller_task {nullptr};
+    uint64 m_last_recv_ms = 0;
+    uint64 m_recv_bytes = 0;
+    uint64 m_shed_bytes = 0;
+    uint32 m_zerocopy_threshold = 0;
+    uint32 m_zerocopy_seq = 0;
+    std::deque<std::pair<uint32, std::shared_ptr<const std::string>>> m_zerocopy_pending;
+    uint32 m_send_high_watermark = 0;
+    uint32 m_send_low_watermark = 0;
+    std::atomic<bool> m_send_blocked {false};
+    std::function<void(std::shared_ptr<Connection>)> m_drain_cb;
+    std::atomic<uint8> m_read_pause {0};
+    uint32 m_max_pending_msgs = 0;
+    std::atomic<uint32> m_pending_msgs {0};
+    std::unique_ptr<Rate_Limiter> m_rate_limiter;
+    Rate_Buckets m_rate_buckets;
+    uint64 m_peer_key = 0;
+    uint32 m_idle_timeout = 0;
+    uint32 m_heartbeat_interval = 0;
+    std::atomic<uint32> m_idle_gen {0};
+    std::atomic<uint32> m_heartbeat_gen {0};
+    std::function<void(std::shared_ptr<Connection>)> m_heartbeat_cb;
     static fly::base::ID_Allocator m_id_allocator;
     std::function<void(std::shared_ptr<Connection>)> m_close_cb;
     std::function<void(std::shared_ptr<Connection>)> m_be_closed_cb;
@@ -96,6 +157,8 @@ class Connection<Wsock> : public std::enable_shared_from_this<Connection<Wsock>>
     friend class Poller_Task<Wsock>;
     friend class Server<Wsock>;
     friend class Client<Wsock>;
+    friend class Poller<Wsock>;
+    friend class Message<Wsock>;
     
 public:
     Connection(int32 fd, const Addr &peer_addr);
@@ -103,20 +166,48 @@ public:
     uint64 id();
     void close();
     bool closed();
-    void send(const void *data, uint32 size);
-    void send(rapidjson::Document &doc);
+    bool send(const void *data, uint32 size);
+    bool send(std::shared_ptr<const std::string> data);
+    bool set_zerocopy_threshold(uint32 threshold);
+    bool send_file(int32 fd, uint64 offset, uint32 length);
+    void set_send_watermarks(uint32 high, uint32 low, std::function<void(std::shared_ptr<Connection>)> drain_cb);
+    uint32 send_queue_length();
+    void cork();
+    void uncork();
+    void pause_read();
+    void resume_read();
+    bool read_paused();
+    void set_max_pending_messages(uint32 max);
+    uint32 pending_messages();
+    void set_rate_limit(const Rate_Limit &limit);
+    bool send(rapidjson::Document &doc);
     const Addr& peer_addr();
     bool is_passive();
     void set_passive(bool is_passive);
     std::string key() const;
     void key(std::string k);
+    void set_idle_timeout(uint32 timeout_ms);
+    void set_heartbeat_interval(uint32 interval_ms, std::function<void(std::shared_ptr<Connection>)> cb);
+    uint64 run_after(uint32 delay_ms, std::function<void()> cb);
+    uint64 run_every(uint32 interval_ms, std::function<void()> cb);
+    void cancel_timer(uint64 timer_id);
     
 private:
     void send_raw(const void *data, uint32 size);
     void parse();
+    Message_Chunk* new_frame_header(uint32 size);
+    bool send_blocked();
+    void schedule_write();
+    void unpause_read(uint8 reason);
+    void track_message(Message<Wsock> *message);
+    bool rate_limited(uint32 length);
+    void drain();
+    Poller_Task<Wsock>* poller_task();
+    void message_done();
     int32 m_fd;
     uint64 m_id = 0;
     uint32 m_max_msg_length = 0;
+    uint8 m_recv_size_class = 0;
     uint8 m_cur_msg_length = 0;
     uint64 m_cur_msg_length_1 = 0;
     bool m_stop_parse = false;
@@ -125,10 +216,34 @@ private:
     Addr m_peer_addr;
     std::string m_key;
     std::atomic<bool> m_closed {false};
+    std::atomic<bool> m_write_pending {false};
+    std::atomic<uint32> m_cork {0};
     std::shared_ptr<Connection> m_self; //add ref
     Message_Chunk_Queue m_recv_msg_queue;
     Message_Chunk_Queue m_send_msg_queue;
-    Poller_Task<Wsock> *m_poller_task = nullptr;
+    std::unique_ptr<Uring_Context> m_uring_ctx;
+    std::atomic<Poller_Task<Wsock>*> m_poller_task {nullptr};
+    uint64 m_last_recv_ms = 0;
+    uint64 m_recv_bytes = 0;
+    uint64 m_shed_bytes = 0;
+    uint32 m_zerocopy_threshold = 0;
+    uint32 m_zerocopy_seq = 0;
+    std::deque<std::pair<uint32, std::shared_ptr<const std::string>>> m_zerocopy_pending;
+    uint32 m_send_high_watermark = 0;
+    uint32 m_send_low_watermark = 0;
+    std::atomic<bool> m_send_blocked {false};
+    std::function<void(std::shared_ptr<Connection>)> m_drain_cb;
+    std::atomic<uint8> m_read_pause {0};
+    uint32 m_max_pending_msgs = 0;
+    std::atomic<uint32> m_pending_msgs {0};
+    std::unique_ptr<Rate_Limiter> m_rate_limiter;
+    Rate_Buckets m_rate_buckets;
+    uint64 m_peer_key = 0;
+    uint32 m_idle_timeout = 0;
+    uint32 m_heartbeat_interval = 0;
+    std::atomic<uint32> m_idle_gen {0};
+    std::atomic<uint32> m_heartbeat_gen {0};
+    std::function<void(std::shared_ptr<Connection>)> m_heartbeat_cb;
     static fly::base::ID_Allocator m_id_allocator;
     std::function<void(std::shared_ptr<Connection>)> m_close_cb;
     std::function<void(std::shared_ptr<Connection>)> m_be_closed_cb;
@@ -143,6 +258,8 @@ class Connection<Proto> : public std::enable_shared_from_this<Connection<Proto>>
     friend class Poller_Task<Proto>;
     friend class Server<Proto>;
     friend class Client<Proto>;
+    friend class Poller<Proto>;
+    friend class Message<Proto>;
     
 public:
     Connection(int32 fd, const Addr &peer_addr);
@@ -150,29 +267,81 @@ public:
     uint64 id();
     void close();
     bool closed();
-    void send(const void *data, uint32 size);
-    void send(rapidjson::Document &doc);
+    bool send(const void *data, uint32 size);
+    bool send(std::shared_ptr<const std::string> data);
+    bool set_zerocopy_threshold(uint32 threshold);
+    bool send_file(int32 fd, uint64 offset, uint32 length);
+    void set_send_watermarks(uint32 high, uint32 low, std::function<void(std::shared_ptr<Connection>)> drain_cb);
+    uint32 send_queue_length();
+    void cork();
+    void uncork();
+    void pause_read();
+    void resume_read();
+    bool read_paused();
+    void set_max_pending_messages(uint32 max);
+    uint32 pending_messages();
+    void set_rate_limit(const Rate_Limit &limit);
+    bool send(rapidjson::Document &doc);
     const Addr& peer_addr();
     bool is_passive();
     void set_passive(bool is_passive);
     std::string key() const;
     void key(std::string k);
+    void set_idle_timeout(uint32 timeout_ms);
+    void set_heartbeat_interval(uint32 interval_ms, std::function<void(std::shared_ptr<Connection>)> cb);
+    uint64 run_after(uint32 delay_ms, std::function<void()> cb);
+    uint64 run_every(uint32 interval_ms, std::function<void()> cb);
+    void cancel_timer(uint64 timer_id);
     
 private:
     void parse();
+    Message_Chunk* new_frame_header(uint32 size);
+    bool send_blocked();
+    void schedule_write();
+    void unpause_read(uint8 reason);
+    void track_message(Message<Proto> *message);
+    bool rate_limited(uint32 length);
+    void drain();
+    Poller_Task<Proto>* poller_task();
+    void message_done();
     int32 m_fd;
     uint64 m_id = 0;
     uint32 m_max_msg_length = 0;
+    uint8 m_recv_size_class = 0;
     uint32 m_cur_msg_length = 0;
     bool m_stop_parse = false;
     bool m_is_passive;
     Addr m_peer_addr;
     std::atomic<bool> m_closed {false};
+    std::atomic<bool> m_write_pending {false};
+    std::atomic<uint32> m_cork {0};
     std::string m_key;
     std::shared_ptr<Connection> m_self; //add ref
     Message_Chunk_Queue m_recv_msg_queue;
     Message_Chunk_Queue m_send_msg_queue;
-    Poller_Task<Proto> *m_poller_task = nullptr;
+    std::unique_ptr<Uring_Context> m_uring_ctx;
+    std::atomic<Poller_Task<Proto>*> m_poller_task {nullptr};
+    uint64 m_last_recv_ms = 0;
+    uint64 m_recv_bytes = 0;
+    uint64 m_shed_bytes = 0;
+    uint32 m_zerocopy_threshold = 0;
+    uint32 m_zerocopy_seq = 0;
+    std::deque<std::pair<uint32, std::shared_ptr<const std::string>>> m_zerocopy_pending;
+    uint32 m_send_high_watermark = 0;
+    uint32 m_send_low_watermark = 0;
+    std::atomic<bool> m_send_blocked {false};
+    std::function<void(std::shared_ptr<Connection>)> m_drain_cb;
+    std::atomic<uint8> m_read_pause {0};
+    uint32 m_max_pending_msgs = 0;
+    std::atomic<uint32> m_pending_msgs {0};
+    std::unique_ptr<Rate_Limiter> m_rate_limiter;
+    Rate_Buckets m_rate_buckets;
+    uint64 m_peer_key = 0;
+    uint32 m_idle_timeout = 0;
+    uint32 m_heartbeat_interval = 0;
+    std::atomic<uint32> m_idle_gen {0};
+    std::atomic<uint32> m_heartbeat_gen {0};
+    std::function<void(std::shared_ptr<Connection>)> m_heartbeat_cb;
     static fly::base::ID_Allocator m_id_allocator;
     std::function<void(std::shared_ptr<Connection>)> m_close_cb;
     std::function<void(std::shared_ptr<Connection>)> m_be_closed_cb;
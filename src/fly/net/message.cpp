@@ -20,6 +20,7 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "fly/net/message.hpp"
+#include "fly/net/connection.hpp"
 
 namespace fly {
 namespace net {
@@ -31,6 +32,14 @@ Message<Json>::Message(std::shared_ptr<Connection<Json>> connection)
     m_doc = std::make_shared<rapidjson::Document>();
 }
 
+Message<Json>::~Message()
+{
+    if(m_tracked)
+    {
+        m_connection->message_done();
+    }
+}
+
 rapidjson::Document& Message<Json>::doc()
 {
     return *m_doc;
@@ -73,6 +82,14 @@ Message<Proto>::Message(std::shared_ptr<Connection<Proto>> connection)
     m_doc = std::make_shared<rapidjson::Document>();
 }
 
+Message<Proto>::~Message()
+{
+    if(m_tracked)
+    {
+        m_connection->message_done();
+    }
+}
+
 rapidjson::Document& Message<Proto>::doc()
 {
     return *m_doc;
@@ -115,6 +132,14 @@ Message<Wsock>::Message(std::shared_ptr<Connection<Wsock>> connection)
     m_doc = std::make_shared<rapidjson::Document>();
 }
 
+Message<Wsock>::~Message()
+{
+    if(m_tracked)
+    {
+        m_connection->message_done();
+    }
+}
+
 rapidjson::Document& Message<Wsock>::doc()
 {
     return *m_doc;
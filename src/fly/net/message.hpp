@@ -54,6 +54,7 @@ class Message<Json>
     
 public:
     Message(std::shared_ptr<Connection<Json>> connection);
+    ~Message();
     rapidjson::Document& doc();
     std::shared_ptr<rapidjson::Document> doc_shared();
     const std::string& raw_data();
@@ -69,6 +70,7 @@ private:
     uint32 m_length;
     uint32 m_type;
     uint32 m_cmd;
+    bool m_tracked = false;
 };
 
 template<>
@@ -78,6 +80,7 @@ class Message<Proto>
     
 public:
     Message(std::shared_ptr<Connection<Proto>> connection);
+    ~Message();
     rapidjson::Document& doc();
     std::shared_ptr<rapidjson::Document> doc_shared();
     const std::string& raw_data();
@@ -93,6 +96,7 @@ private:
     uint32 m_length;
     uint32 m_type;
     uint32 m_cmd;
+    bool m_tracked = false;
 };
 
 template<>
@@ -102,6 +106,7 @@ class Message<Wsock>
     
 public:
     Message(std::shared_ptr<Connection<Wsock>> connection);
+    ~Message();
     rapidjson::Document& doc();
     std::shared_ptr<rapidjson::Document> doc_shared();
     const std::string& raw_data();
@@ -117,6 +122,7 @@ private:
     uint32 m_length;
     uint32 m_type;
     uint32 m_cmd;
+    bool m_tracked = false;
 };
 
 }
@@ -19,14 +19,83 @@
  *                                                                     *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+#include <unistd.h>
 #include "fly/net/message_chunk.hpp"
+#include "fly/net/message_chunk_pool.hpp"
 
 namespace fly {
 namespace net {
 
+//the buffer is not zero-filled, one extra byte is reserved for the '\0' terminator kept after the written data
 Message_Chunk::Message_Chunk(uint32 size)
 {
-    m_data.resize(size + 1, 0);
+    m_data = new char[size + 1];
+    m_data[0] = 0;
+    m_size = size;
+}
+
+//refers to the caller's buffer instead of copying it, the buffer is held as long as the chunk lives
+Message_Chunk::Message_Chunk(std::shared_ptr<const std::string> data)
+{
+    m_data = const_cast<char*>(data->data());
+    m_size = data->size();
+    m_write_pos = m_size;
+    m_holder = data;
+}
+
+//a segment of a file which is sent with sendfile, the chunk owns file_fd and has no buffer
+Message_Chunk::Message_Chunk(int32 file_fd, uint64 offset, uint32 length)
+{
+    m_data = nullptr;
+    m_size = 0;
+    m_write_pos = length;
+    m_file_fd = file_fd;
+    m_file_offset = offset;
+}
+
+Message_Chunk::Message_Chunk(char *data, uint32 size, Message_Chunk_Pool *pool)
+{
+    m_data = data;
+    m_data[0] = 0;
+    m_size = size;
+    m_pool = pool;
+}
+
+Message_Chunk::~Message_Chunk()
+{
+    if(m_pool != nullptr)
+    {
+        m_pool->release(m_data, m_size);
+    }
+    else if(m_file_fd >= 0)
+    {
+        close(m_file_fd);
+    }
+    else if(!m_holder)
+    {
+        delete[] m_data;
+    }
+}
+
+uint32 Message_Chunk::size()
+{
+    return m_size;
+}
+
+const std::shared_ptr<const std::string>& Message_Chunk::holder()
+{
+    return m_holder;
+}
+
+int32 Message_Chunk::file_fd()
+{
+    return m_file_fd;
+}
+
+//where the unsent part of the segment starts in the file
+uint64 Message_Chunk::file_offset()
+{
+    return m_file_offset + m_read_pos;
 }
 
 uint32 Message_Chunk::length()
@@ -52,6 +121,7 @@ char* Message_Chunk::write_ptr()
 void Message_Chunk::write_ptr(uint32 count)
 {
     m_write_pos += count;
+    m_data[m_write_pos] = 0;
 }
 
 }
@@ -22,26 +22,48 @@
 #ifndef FLY__NET__MESSAGE_CHUNK
 #define FLY__NET__MESSAGE_CHUNK
 
-#include <vector>
+#include <memory>
+#include <string>
 #include "fly/base/common.hpp"
 
 namespace fly {
 namespace net {
 
+class Message_Chunk_Pool;
+
 class Message_Chunk
 {
+    friend class Message_Chunk_Pool;
+    friend class Message_Chunk_Queue;
+    
 public:
     Message_Chunk(uint32 size);
+    Message_Chunk(std::shared_ptr<const std::string> data);
+    Message_Chunk(int32 file_fd, uint64 offset, uint32 length);
+    Message_Chunk(const Message_Chunk&) = delete;
+    Message_Chunk& operator=(const Message_Chunk&) = delete;
+    ~Message_Chunk();
     char* read_ptr();
     void read_ptr(uint32 count);
     char* write_ptr();
     void write_ptr(uint32 count);
     uint32 length();
+    uint32 size();
+    const std::shared_ptr<const std::string>& holder();
+    int32 file_fd();
+    uint64 file_offset();
     
 private:
-    std::vector<char> m_data;
+    Message_Chunk(char *data, uint32 size, Message_Chunk_Pool *pool);
+    char *m_data;
+    uint32 m_size;
     uint32 m_write_pos = 0;
     uint32 m_read_pos = 0;
+    Message_Chunk_Pool *m_pool = nullptr;
+    std::shared_ptr<const std::string> m_holder;
+    int32 m_file_fd = -1;
+    uint64 m_file_offset = 0;
+    Message_Chunk *m_next = nullptr;
 };
 
 }
@@ -0,0 +1,229 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 09:12:51                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "fly/net/message_chunk_pool.hpp"
+
+namespace fly {
+namespace net {
+
+//4K, 64K and 2M buffers, each class keeps at most 16M of idle memory
+static const uint32 CLASS_SIZES[Message_Chunk_Pool::SIZE_CLASS_NUM] = {4 * 1024, 64 * 1024, 2 * 1024 * 1024};
+static const uint32 CLASS_MAX_FREE[Message_Chunk_Pool::SIZE_CLASS_NUM] = {4096, 256, 8};
+
+//m_pending starts from it while the owner is alive, retire() takes the rest away
+static const uint64 OWNER_BIAS = 1ULL << 62;
+
+//the pool whose owner thread is the current thread
+static thread_local Message_Chunk_Pool *t_current_pool = nullptr;
+
+Message_Chunk_Pool::Message_Chunk_Pool()
+{
+    m_pending.store(OWNER_BIAS, std::memory_order_relaxed);
+
+    for(uint32 i = 0; i < SIZE_CLASS_NUM; ++i)
+    {
+        m_inbox[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+Message_Chunk_Pool::~Message_Chunk_Pool()
+{
+    for(uint32 i = 0; i < SIZE_CLASS_NUM; ++i)
+    {
+        for(auto *data : m_free_bufs[i])
+        {
+            delete[] data;
+        }
+
+        char *data = m_inbox[i].load(std::memory_order_acquire);
+
+        while(data != nullptr)
+        {
+            char *next = *reinterpret_cast<char**>(data);
+            delete[] data;
+            data = next;
+        }
+    }
+}
+
+//called by the owner thread before it takes chunks from the pool
+void Message_Chunk_Pool::current(Message_Chunk_Pool *pool)
+{
+    t_current_pool = pool;
+}
+
+//called by the owner instead of delete, the pool lives on until every chunk taken from it is released
+void Message_Chunk_Pool::retire()
+{
+    if(t_current_pool == this)
+    {
+        t_current_pool = nullptr;
+    }
+
+    //what is left in m_pending is the number of chunks still to be released on other threads
+    uint64 diff = OWNER_BIAS - (m_alloc_count - m_local_release_count);
+
+    if(m_pending.fetch_sub(diff, std::memory_order_acq_rel) == diff)
+    {
+        delete this;
+    }
+}
+
+uint32 Message_Chunk_Pool::size_class(uint32 size)
+{
+    for(uint32 i = 0; i < SIZE_CLASS_NUM; ++i)
+    {
+        if(size <= CLASS_SIZES[i])
+        {
+            return i;
+        }
+    }
+
+    return SIZE_CLASS_NUM - 1;
+}
+
+uint32 Message_Chunk_Pool::class_size(uint32 size_class)
+{
+    return CLASS_SIZES[size_class];
+}
+
+//owner thread only
+Message_Chunk* Message_Chunk_Pool::new_chunk(uint32 size_class)
+{
+    uint32 size = CLASS_SIZES[size_class];
+    std::vector<char*> &free_bufs = m_free_bufs[size_class];
+    char *data = nullptr;
+    ++m_alloc_count;
+    
+    if(free_bufs.empty())
+    {
+        drain_inbox(size_class);
+    }
+
+    //only the owner thread writes the counters, a plain store is enough
+    if(!free_bufs.empty())
+    {
+        data = free_bufs.back();
+        free_bufs.pop_back();
+        m_hit_count.store(m_hit_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    else
+    {
+        data = new char[size + 1];
+        m_miss_count.store(m_miss_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    
+    return new Message_Chunk(data, size, this);
+}
+
+//takes every buffer released on other threads so far
+void Message_Chunk_Pool::drain_inbox(uint32 size_class)
+{
+    if(m_inbox[size_class].load(std::memory_order_relaxed) == nullptr)
+    {
+        return;
+    }
+    
+    std::vector<char*> &free_bufs = m_free_bufs[size_class];
+    char *data = m_inbox[size_class].exchange(nullptr, std::memory_order_acquire);
+
+    while(data != nullptr)
+    {
+        char *next = *reinterpret_cast<char**>(data);
+
+        if(free_bufs.size() < CLASS_MAX_FREE[size_class])
+        {
+            free_bufs.push_back(data);
+        }
+        else
+        {
+            delete[] data;
+        }
+
+        data = next;
+    }
+}
+
+//called by the chunk's destructor, no matter how much of it has been consumed
+void Message_Chunk_Pool::release(char *data, uint32 size)
+{
+    if(t_current_pool != this)
+    {
+        remote_release(data, size);
+
+        return;
+    }
+
+    ++m_local_release_count;
+    uint32 i = size_class(size);
+
+    if(CLASS_SIZES[i] == size)
+    {
+        std::vector<char*> &free_bufs = m_free_bufs[i];
+        
+        if(free_bufs.size() < CLASS_MAX_FREE[i])
+        {
+            free_bufs.push_back(data);
+
+            return;
+        }
+    }
+
+    delete[] data;
+}
+
+//the chunk was migrated or handed to another thread, the buffer is linked through its first bytes
+void Message_Chunk_Pool::remote_release(char *data, uint32 size)
+{
+    uint32 i = size_class(size);
+    
+    if(CLASS_SIZES[i] == size)
+    {
+        char *head = m_inbox[i].load(std::memory_order_relaxed);
+
+        do
+        {
+            *reinterpret_cast<char**>(data) = head;
+        } while(!m_inbox[i].compare_exchange_weak(head, data, std::memory_order_release, std::memory_order_relaxed));
+    }
+    else
+    {
+        delete[] data;
+    }
+
+    if(m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        delete this;
+    }
+}
+
+uint64 Message_Chunk_Pool::hit_count()
+{
+    return m_hit_count.load(std::memory_order_relaxed);
+}
+
+uint64 Message_Chunk_Pool::miss_count()
+{
+    return m_miss_count.load(std::memory_order_relaxed);
+}
+
+}
+}
@@ -0,0 +1,65 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 09:12:44                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__NET__MESSAGE_CHUNK_POOL
+#define FLY__NET__MESSAGE_CHUNK_POOL
+
+#include <atomic>
+#include <vector>
+#include "fly/net/message_chunk.hpp"
+
+namespace fly {
+namespace net {
+
+//per-poller recycler of Message_Chunk buffers, grouped by a few fixed size classes.
+//chunks are only taken on the owner thread, so its free lists need no lock, buffers
+//released on other threads go back through a lock-free inbox which the owner drains.
+class Message_Chunk_Pool
+{
+public:
+    static const uint32 SIZE_CLASS_NUM = 3;
+    Message_Chunk_Pool();
+    Message_Chunk* new_chunk(uint32 size_class);
+    void release(char *data, uint32 size);
+    void retire();
+    uint32 size_class(uint32 size);
+    uint32 class_size(uint32 size_class);
+    uint64 hit_count();
+    uint64 miss_count();
+    static void current(Message_Chunk_Pool *pool);
+    
+private:
+    ~Message_Chunk_Pool();
+    void drain_inbox(uint32 size_class);
+    void remote_release(char *data, uint32 size);
+    std::vector<char*> m_free_bufs[SIZE_CLASS_NUM];
+    std::atomic<char*> m_inbox[SIZE_CLASS_NUM];
+    uint64 m_alloc_count = 0;
+    uint64 m_local_release_count = 0;
+    std::atomic<uint64> m_pending;
+    std::atomic<uint64> m_hit_count {0};
+    std::atomic<uint64> m_miss_count {0};
+};
+
+}
+}
+
+#endif
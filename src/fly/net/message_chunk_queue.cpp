@@ -19,45 +19,236 @@
  *                                                                     *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+#include <cstring>
 #include "fly/net/message_chunk_queue.hpp"
 
 namespace fly {
 namespace net {
 
+//the chunks still queued are owned by the connection, which drains the queue before it is destroyed, see ~Connection
+Message_Chunk_Queue::~Message_Chunk_Queue()
+{
+    delete[] m_ring;
+}
+
 void Message_Chunk_Queue::push(Message_Chunk *message_chunk)
 {
-    std::lock_guard<std::mutex> guard(m_mutex);
-    m_queue.push_back(message_chunk);
-    m_length += message_chunk->length();
+    //counted before it's visible, so length() never drops below what the consumer can pop
+    m_length.fetch_add(message_chunk->length(), std::memory_order_relaxed);
+    message_chunk->m_next = m_inbox.load(std::memory_order_relaxed);
+
+    while(!m_inbox.compare_exchange_weak(message_chunk->m_next, message_chunk, std::memory_order_release, std::memory_order_relaxed));
+}
+
+//the chunks become visible together, so a frame split in several chunks can't interleave with other sends
+void Message_Chunk_Queue::push(Message_Chunk **message_chunks, uint32 count)
+{
+    uint32 length = 0;
+    
+    for(uint32 i = 0; i < count; ++i)
+    {
+        length += message_chunks[i]->length();
+
+        if(i > 0)
+        {
+            message_chunks[i]->m_next = message_chunks[i - 1];
+        }
+    }
+
+    m_length.fetch_add(length, std::memory_order_relaxed);
+    Message_Chunk *last = message_chunks[count - 1];
+    message_chunks[0]->m_next = m_inbox.load(std::memory_order_relaxed);
+
+    while(!m_inbox.compare_exchange_weak(message_chunks[0]->m_next, last, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void Message_Chunk_Queue::grow()
+{
+    uint32 capacity = m_capacity == 0 ? 16 : m_capacity * 2;
+    Message_Chunk **ring = new Message_Chunk*[capacity];
+    uint32 count = m_tail - m_head;
+
+    for(uint32 i = 0; i < count; ++i)
+    {
+        ring[i] = m_ring[(m_head + i) & (m_capacity - 1)];
+    }
+
+    delete[] m_ring;
+    m_ring = ring;
+    m_capacity = capacity;
+    m_head = 0;
+    m_tail = count;
+}
+
+//moves the chunks pushed so far behind the ones already in the ring
+void Message_Chunk_Queue::collect()
+{
+    if(m_inbox.load(std::memory_order_relaxed) == nullptr)
+    {
+        return;
+    }
+    
+    Message_Chunk *message_chunk = m_inbox.exchange(nullptr, std::memory_order_acquire);
+    Message_Chunk *prev = nullptr;
+
+    //the inbox is lifo, reverse it first
+    while(message_chunk != nullptr)
+    {
+        Message_Chunk *next = message_chunk->m_next;
+        message_chunk->m_next = prev;
+        prev = message_chunk;
+        message_chunk = next;
+    }
+
+    while(prev != nullptr)
+    {
+        if(m_tail - m_head == m_capacity)
+        {
+            grow();
+        }
+
+        m_ring[m_tail++ & (m_capacity - 1)] = prev;
+        prev = prev->m_next;
+    }
 }
 
 void Message_Chunk_Queue::push_front(Message_Chunk *message_chunk)
 {
-    std::lock_guard<std::mutex> guard(m_mutex);
-    m_queue.push_front(message_chunk);
-    m_length += message_chunk->length();
+    if(m_tail - m_head == m_capacity)
+    {
+        grow();
+    }
+
+    m_ring[--m_head & (m_capacity - 1)] = message_chunk;
+    m_length.fetch_add(message_chunk->length(), std::memory_order_relaxed);
+}
+
+//keeps the order of the array, so chunks popped by pop(message_chunks, max_count) can be put back
+void Message_Chunk_Queue::push_front(Message_Chunk **message_chunks, uint32 count)
+{
+    for(uint32 i = count; i > 0; --i)
+    {
+        push_front(message_chunks[i - 1]);
+    }
 }
 
 uint32 Message_Chunk_Queue::length()
 {
-    return m_length;
+    return m_length.load(std::memory_order_relaxed);
 }
 
 Message_Chunk* Message_Chunk_Queue::pop()
 {
-    std::lock_guard<std::mutex> guard(m_mutex);
-    
-    if(m_queue.empty())
+    if(m_head == m_tail)
     {
-        return nullptr;
+        collect();
+
+        if(m_head == m_tail)
+        {
+            return nullptr;
+        }
     }
     
-    Message_Chunk* message_chunk = m_queue.front();
-    m_queue.pop_front();
-    m_length -= message_chunk->length();
+    Message_Chunk *message_chunk = m_ring[m_head++ & (m_capacity - 1)];
+    m_length.fetch_sub(message_chunk->length(), std::memory_order_relaxed);
     
     return message_chunk;
 }
 
+uint32 Message_Chunk_Queue::pop(Message_Chunk **message_chunks, uint32 max_count)
+{
+    collect();
+    uint32 count = 0;
+    uint32 bytes = 0;
+    
+    while(count < max_count && m_head != m_tail)
+    {
+        Message_Chunk *message_chunk = m_ring[m_head++ & (m_capacity - 1)];
+        bytes += message_chunk->length();
+        message_chunks[count++] = message_chunk;
+    }
+
+    m_length.fetch_sub(bytes, std::memory_order_relaxed);
+    
+    return count;
+}
+
+//copies up to count bytes out of the front chunks, frees the ones fully consumed
+uint32 Message_Chunk_Queue::read(char *data, uint32 count)
+{
+    uint32 done = 0;
+
+    while(done < count)
+    {
+        if(m_head == m_tail)
+        {
+            collect();
+
+            if(m_head == m_tail)
+            {
+                break;
+            }
+        }
+
+        Message_Chunk *message_chunk = m_ring[m_head & (m_capacity - 1)];
+        uint32 length = message_chunk->length();
+        uint32 num = length < count - done ? length : count - done;
+        memcpy(data + done, message_chunk->read_ptr(), num);
+        done += num;
+
+        if(num == length)
+        {
+            ++m_head;
+            delete message_chunk;
+        }
+        else
+        {
+            message_chunk->read_ptr(num);
+        }
+    }
+
+    m_length.fetch_sub(done, std::memory_order_relaxed);
+
+    return done;
+}
+
+//like read() without copying the bytes anywhere
+uint32 Message_Chunk_Queue::skip(uint32 count)
+{
+    uint32 done = 0;
+
+    while(done < count)
+    {
+        if(m_head == m_tail)
+        {
+            collect();
+
+            if(m_head == m_tail)
+            {
+                break;
+            }
+        }
+
+        Message_Chunk *message_chunk = m_ring[m_head & (m_capacity - 1)];
+        uint32 length = message_chunk->length();
+        uint32 num = length < count - done ? length : count - done;
+        done += num;
+
+        if(num == length)
+        {
+            ++m_head;
+            delete message_chunk;
+        }
+        else
+        {
+            message_chunk->read_ptr(num);
+        }
+    }
+
+    m_length.fetch_sub(done, std::memory_order_relaxed);
+
+    return done;
+}
+
 }
 }
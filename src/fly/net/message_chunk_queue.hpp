@@ -22,25 +22,41 @@
 #ifndef FLY__NET__MESSAGE_CHUNK_QUEUE
 #define FLY__NET__MESSAGE_CHUNK_QUEUE
 
-#include <mutex>
-#include <list>
+#include <atomic>
 #include "fly/net/message_chunk.hpp"
 
 namespace fly {
 namespace net {
 
+//push may be called from any thread (lock-free, through an intrusive inbox list),
+//everything else only from the single consumer, which owns a ring of chunk pointers
+//length() is kept in an atomic, it's exact for the consumer and never less than what it can pop
 class Message_Chunk_Queue
 {
 public:
+    Message_Chunk_Queue() = default;
+    Message_Chunk_Queue(const Message_Chunk_Queue&) = delete;
+    Message_Chunk_Queue& operator=(const Message_Chunk_Queue&) = delete;
+    ~Message_Chunk_Queue();
     void push(Message_Chunk *message_chunk);    
+    void push(Message_Chunk **message_chunks, uint32 count);
     void push_front(Message_Chunk *message_chunk);
+    void push_front(Message_Chunk **message_chunks, uint32 count);
     Message_Chunk* pop();
+    uint32 pop(Message_Chunk **message_chunks, uint32 max_count);
+    uint32 read(char *data, uint32 count);
+    uint32 skip(uint32 count);
     uint32 length();
     
 private:
-    std::list<Message_Chunk*> m_queue;
-    std::mutex m_mutex;
-    uint32 m_length = 0;
+    void collect();
+    void grow();
+    std::atomic<Message_Chunk*> m_inbox {nullptr};
+    std::atomic<uint32> m_length {0};
+    Message_Chunk **m_ring = nullptr;
+    uint32 m_capacity = 0;
+    uint32 m_head = 0;
+    uint32 m_tail = 0;
 };
 
 }
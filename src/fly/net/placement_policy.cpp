@@ -0,0 +1,87 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 14:02:37                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <functional>
+#include "fly/net/placement_policy.hpp"
+
+namespace fly {
+namespace net {
+
+std::shared_ptr<Placement_Policy> Placement_Policy::create(PLACEMENT_POLICY policy)
+{
+    switch(policy)
+    {
+    case PLACEMENT_LEAST_CONNECTIONS:
+        return std::make_shared<Least_Connections_Placement>();
+    case PLACEMENT_LEAST_CPU:
+        return std::make_shared<Least_CPU_Placement>();
+    case PLACEMENT_PEER_HASH:
+        return std::make_shared<Peer_Hash_Placement>();
+    default:
+        return std::make_shared<Round_Robin_Placement>();
+    }
+}
+
+uint32 Round_Robin_Placement::place(uint64 connection_id, const Addr &peer_addr, const std::vector<Poller_Load> &loads)
+{
+    return m_next.fetch_add(1, std::memory_order_relaxed) % loads.size();
+}
+
+uint32 Least_Connections_Placement::place(uint64 connection_id, const Addr &peer_addr, const std::vector<Poller_Load> &loads)
+{
+    uint32 idx = 0;
+
+    for(uint32 i = 1; i < loads.size(); ++i)
+    {
+        if(loads[i].m_connection_num < loads[idx].m_connection_num)
+        {
+            idx = i;
+        }
+    }
+
+    return idx;
+}
+
+//the cpu time is sampled periodically, the connection count breaks the ties between idle tasks
+uint32 Least_CPU_Placement::place(uint64 connection_id, const Addr &peer_addr, const std::vector<Poller_Load> &loads)
+{
+    uint32 idx = 0;
+
+    for(uint32 i = 1; i < loads.size(); ++i)
+    {
+        if(loads[i].m_recent_cpu_us < loads[idx].m_recent_cpu_us
+           || (loads[i].m_recent_cpu_us == loads[idx].m_recent_cpu_us && loads[i].m_connection_num < loads[idx].m_connection_num))
+        {
+            idx = i;
+        }
+    }
+
+    return idx;
+}
+
+//only the host is hashed, so all the connections from one peer share a poller task
+uint32 Peer_Hash_Placement::place(uint64 connection_id, const Addr &peer_addr, const std::vector<Poller_Load> &loads)
+{
+    return peer_addr.host_hash() % loads.size();
+}
+
+}
+}
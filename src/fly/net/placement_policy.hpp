@@ -0,0 +1,89 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 14:02:37                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__NET__PLACEMENT_POLICY
+#define FLY__NET__PLACEMENT_POLICY
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "fly/net/addr.hpp"
+
+namespace fly {
+namespace net {
+
+enum PLACEMENT_POLICY
+{
+    PLACEMENT_ROUND_ROBIN,
+    PLACEMENT_LEAST_CONNECTIONS,
+    PLACEMENT_LEAST_CPU,
+    PLACEMENT_PEER_HASH
+};
+
+//load of one poller task, m_recent_cpu_us is the cpu time its thread used during the last sample window
+struct Poller_Load
+{
+    uint32 m_connection_num = 0;
+    uint64 m_recent_cpu_us = 0;
+    uint64 m_cpu_us = 0;
+};
+
+//picks the index of the poller task a new connection is registered to
+//place() is called concurrently by every thread which registers connections
+class Placement_Policy
+{
+public:
+    virtual ~Placement_Policy() = default;
+    virtual uint32 place(uint64 connection_id, const Addr &peer_addr, const std::vector<Poller_Load> &loads) = 0;
+    static std::shared_ptr<Placement_Policy> create(PLACEMENT_POLICY policy);
+};
+
+class Round_Robin_Placement : public Placement_Policy
+{
+public:
+    uint32 place(uint64 connection_id, const Addr &peer_addr, const std::vector<Poller_Load> &loads) override;
+
+private:
+    std::atomic<uint32> m_next {0};
+};
+
+class Least_Connections_Placement : public Placement_Policy
+{
+public:
+    uint32 place(uint64 connection_id, const Addr &peer_addr, const std::vector<Poller_Load> &loads) override;
+};
+
+class Least_CPU_Placement : public Placement_Policy
+{
+public:
+    uint32 place(uint64 connection_id, const Addr &peer_addr, const std::vector<Poller_Load> &loads) override;
+};
+
+class Peer_Hash_Placement : public Placement_Policy
+{
+public:
+    uint32 place(uint64 connection_id, const Addr &peer_addr, const std::vector<Poller_Load> &loads) override;
+};
+
+}
+}
+
+#endif
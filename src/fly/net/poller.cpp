@@ -20,22 +20,53 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "fly/net/poller.hpp"
+#include "fly/net/udp_socket.hpp"
+#include "fly/base/cpu_topology.hpp"
 
 namespace fly {
 namespace net {
 
+//poller task i runs on cpu_sets[i % cpu_sets.size()], num == 0 means one pinned poller task per physical core
 template<typename T>
-Poller<T>::Poller(uint32 num)
+Poller<T>::Poller(uint32 num, POLLER_BACKEND backend, PLACEMENT_POLICY placement, std::vector<std::vector<uint32>> cpu_sets)
 {
-    m_scheduler.reset(new fly::task::Scheduler(num));
+    if(num == 0)
+    {
+        cpu_sets = fly::base::cpu_layout();
+        num = cpu_sets.empty() ? 1 : cpu_sets.size();
+    }
+    
+    m_scheduler.reset(new fly::task::Scheduler(num, cpu_sets));
     m_poller_task_num = num;
+    m_backend = backend;
+    m_placement_policy = Placement_Policy::create(placement);
+    fly::base::Mem_Policy mem_policy;
+
+    //the caller's own policy is put back once the tasks are allocated
+    bool saved = !cpu_sets.empty() && fly::base::save_mempolicy(mem_policy);
     
     for(uint32 i = 1; i <= num; ++i)
     {
-        auto *poller_task = new Poller_Task<T>(i);
+        //the scheduler runs task i on executor i % num, allocate its pool and rings on the node of that executor
+        if(!cpu_sets.empty())
+        {
+            const std::vector<uint32> &cpus = cpu_sets[(i % num) % cpu_sets.size()];
+            fly::base::prefer_node(cpus.empty() ? -1 : fly::base::cpu_node(cpus[0]));
+        }
+        
+        auto *poller_task = new Poller_Task<T>(i, backend);
         m_poller_tasks.push_back(poller_task);
         m_scheduler->schedule_task(poller_task);
     }
+
+    if(saved)
+    {
+        fly::base::restore_mempolicy(mem_policy);
+    }
+    else if(!cpu_sets.empty())
+    {
+        fly::base::prefer_node(-1);
+    }
 }
 
 template<typename T>
@@ -44,17 +75,38 @@ void Poller<T>::start()
     m_scheduler->start();
 }
 
+//see Poller_Task::stop, the executors exit once their poller task finished draining
 template<typename T>
-void Poller<T>::stop()
+void Poller<T>::stop(uint32 drain_timeout_ms)
 {
     for(auto poll_task : m_poller_tasks)
     {
-        poll_task->stop();
+        poll_task->stop(drain_timeout_ms);
     }
 
     m_scheduler->stop();
 }
 
+//summed over the poller tasks, done once all of them are
+template<typename T>
+Drain_Progress Poller<T>::drain_progress()
+{
+    Drain_Progress progress;
+    progress.m_done = true;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        Drain_Progress task_progress = poller_task->drain_progress();
+        progress.m_draining = progress.m_draining || task_progress.m_draining;
+        progress.m_done = progress.m_done && task_progress.m_done;
+        progress.m_connection_num += task_progress.m_connection_num;
+        progress.m_pending_bytes += task_progress.m_pending_bytes;
+        progress.m_dropped_num += task_progress.m_dropped_num;
+    }
+
+    return progress;
+}
+
 template<typename T>
 void Poller<T>::wait()
 {
@@ -64,7 +116,440 @@ void Poller<T>::wait()
 template<typename T>
 bool Poller<T>::register_connection(std::shared_ptr<Connection<T>> connection)
 {
-    return m_poller_tasks[connection->id() % m_poller_task_num]->register_connection(connection);
+    //accepted by a poller which owns its listen fd, stay there
+    if(connection->m_poller_task != nullptr)
+    {
+        return connection->poller_task()->register_connection(connection);
+    }
+    
+    uint32 idx = m_placement_policy->place(connection->id(), connection->peer_addr(), loads());
+    
+    return m_poller_tasks[idx % m_poller_task_num]->register_connection(connection);
+}
+
+//listen fd i is driven by poller task i % num, with one fd per task (SO_REUSEPORT)
+//each task keeps the connections it accepts
+template<typename T>
+bool Poller<T>::listen(const std::vector<int32> &listen_fds, std::function<void(std::shared_ptr<Connection<T>>)> cb)
+{
+    bool local = listen_fds.size() >= m_poller_task_num;
+    
+    for(uint32 i = 0; i < listen_fds.size(); ++i)
+    {
+        if(!m_poller_tasks[i % m_poller_task_num]->listen(listen_fds[i], cb, local))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename T>
+uint32 Poller<T>::poller_task_num()
+{
+    return m_poller_task_num;
+}
+
+//call it before any connection is registered
+template<typename T>
+void Poller<T>::set_placement_policy(std::shared_ptr<Placement_Policy> placement_policy)
+{
+    m_placement_policy = placement_policy;
+}
+
+template<typename T>
+std::vector<Poller_Load> Poller<T>::loads()
+{
+    std::vector<Poller_Load> loads;
+    loads.reserve(m_poller_task_num);
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        loads.push_back(poller_task->load());
+    }
+
+    return loads;
+}
+
+//the defaults for the sockets of the Servers and Clients on this Poller, see Server::set_socket_options
+template<typename T>
+void Poller<T>::set_socket_options(const Socket_Options &options)
+{
+    m_socket_options = options;
+}
+
+template<typename T>
+const Socket_Options& Poller<T>::socket_options()
+{
+    return m_socket_options;
+}
+
+//udp sockets are spread round robin, each one is served by a single poller task, see Udp_Socket::open
+template<typename T>
+bool Poller<T>::register_udp_socket(std::shared_ptr<Udp_Socket<T>> udp_socket)
+{
+    Poller_Task<T> *poller_task = m_poller_tasks[m_udp_socket_num.fetch_add(1, std::memory_order_relaxed) % m_poller_task_num];
+    udp_socket->m_poller_task = poller_task;
+    poller_task->register_udp_socket(udp_socket);
+
+    return true;
+}
+
+//pending connects are spread round robin too, see Poller_Task::connect
+template<typename T>
+void Poller<T>::connect(int32 fd, uint32 timeout_ms, std::function<void(int32)> cb)
+{
+    m_poller_tasks[m_connect_num.fetch_add(1, std::memory_order_relaxed) % m_poller_task_num]->connect(fd, timeout_ms, cb);
+}
+
+//timers not tied to a connection, they fire on the first poller task like the rebalance timer
+template<typename T>
+uint64 Poller<T>::run_after(uint32 delay_ms, std::function<void()> cb)
+{
+    return m_poller_tasks[0]->run_after(delay_ms, cb);
+}
+
+template<typename T>
+void Poller<T>::cancel_timer(uint64 timer_id)
+{
+    m_poller_tasks[0]->cancel_timer(timer_id);
+}
+
+//moves connection to poller task target of this Poller, see Poller_Task::migrate
+template<typename T>
+bool Poller<T>::migrate(std::shared_ptr<Connection<T>> connection, uint32 target)
+{
+    Poller_Task<T> *poller_task = connection->poller_task();
+    
+    if(poller_task == nullptr || target >= m_poller_task_num)
+    {
+        return false;
+    }
+
+    return poller_task->migrate(connection, m_poller_tasks[target]);
+}
+
+//every interval_ms one connection moves from the poller task with the most recent cpu time to the one with
+//the least, once they differ by more than imbalance_pct of the former. 0 disables it
+template<typename T>
+void Poller<T>::set_rebalance(uint32 interval_ms, uint32 imbalance_pct)
+{
+    if(m_rebalance_timer != 0)
+    {
+        m_poller_tasks[0]->cancel_timer(m_rebalance_timer);
+        m_rebalance_timer = 0;
+    }
+
+    m_imbalance_pct = imbalance_pct;
+
+    if(interval_ms > 0 && m_poller_task_num > 1)
+    {
+        m_rebalance_timer = m_poller_tasks[0]->run_every(interval_ms, std::bind(&Poller::rebalance, this));
+    }
+}
+
+template<typename T>
+void Poller<T>::rebalance()
+{
+    //below this a busy poller task isn't worth a migration, the load sample window is 200ms
+    const uint64 MIN_BUSY_CPU_US = 20000;
+    std::vector<Poller_Load> loads = this->loads();
+    uint32 busy = 0;
+    uint32 idle = 0;
+
+    for(uint32 i = 1; i < loads.size(); ++i)
+    {
+        if(loads[i].m_recent_cpu_us > loads[busy].m_recent_cpu_us)
+        {
+            busy = i;
+        }
+
+        if(loads[i].m_recent_cpu_us < loads[idle].m_recent_cpu_us)
+        {
+            idle = i;
+        }
+    }
+
+    uint64 busy_us = loads[busy].m_recent_cpu_us;
+    uint64 idle_us = loads[idle].m_recent_cpu_us;
+
+    if(busy == idle || busy_us < MIN_BUSY_CPU_US || (busy_us - idle_us) * 100 <= busy_us * m_imbalance_pct)
+    {
+        return;
+    }
+
+    //half of the gap would even them out
+    m_poller_tasks[busy]->shed(m_poller_tasks[idle], (busy_us - idle_us) * 500 / busy_us);
+}
+
+template<typename T>
+uint64 Poller<T>::migrate_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->migrate_count();
+    }
+
+    return count;
+}
+
+//see Poller_Task::set_spin
+template<typename T>
+void Poller<T>::set_spin(uint32 spin_us, uint32 spin_polls, uint32 busy_poll_us)
+{
+    for(auto poller_task : m_poller_tasks)
+    {
+        poller_task->set_spin(spin_us, spin_polls, busy_poll_us);
+    }
+}
+
+template<typename T>
+uint64 Poller<T>::spin_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->spin_count();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::sleep_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->sleep_count();
+    }
+
+    return count;
+}
+
+//limits the messages received from each peer ip over all its connections, call it before start()
+//the peer table is expired by a timer of the first poller task, a limit without any rate removes it
+template<typename T>
+void Poller<T>::set_peer_rate_limit(const Rate_Limit &limit, uint32 capacity)
+{
+    std::shared_ptr<Peer_Rate_Table> peer_rate_table(new Peer_Rate_Table(limit, capacity));
+
+    if(!peer_rate_table->limiter().enabled())
+    {
+        peer_rate_table.reset();
+    }
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        poller_task->set_peer_rate_table(peer_rate_table);
+    }
+
+    if(m_peer_expire_timer != 0)
+    {
+        m_poller_tasks[0]->cancel_timer(m_peer_expire_timer);
+        m_peer_expire_timer = 0;
+    }
+
+    if(peer_rate_table)
+    {
+        m_peer_expire_timer = m_poller_tasks[0]->run_every(Peer_Rate_Table::EXPIRE_INTERVAL_MS, [peer_rate_table]
+        {
+            peer_rate_table->expire(fly::base::monotonic_ms());
+        });
+    }
+}
+
+template<typename T>
+uint64 Poller<T>::rate_delay_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->rate_delay_count();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::rate_drop_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->rate_drop_count();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::rate_close_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->rate_close_count();
+    }
+
+    return count;
+}
+
+template<typename T>
+POLLER_BACKEND Poller<T>::backend()
+{
+    return m_backend;
+}
+
+template<typename T>
+uint64 Poller<T>::chunk_pool_hit_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->chunk_pool()->hit_count();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::chunk_pool_miss_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->chunk_pool()->miss_count();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::flush_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->flush_count();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::flush_iovec_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->flush_iovec_count();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::flush_bytes()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->flush_bytes();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::copy_bytes()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->copy_bytes();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::zerocopy_bytes()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->zerocopy_bytes();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::zerocopy_copied_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->zerocopy_copied_count();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::sendfile_bytes()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->sendfile_bytes();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::send_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->send_count();
+    }
+
+    return count;
+}
+
+template<typename T>
+uint64 Poller<T>::write_wakeup_count()
+{
+    uint64 count = 0;
+
+    for(auto poller_task : m_poller_tasks)
+    {
+        count += poller_task->write_wakeup_count();
+    }
+
+    return count;
 }
 
 template class Poller<Json>;
@@ -25,6 +25,7 @@
 #include <vector>
 #include "fly/task/scheduler.hpp"
 #include "fly/net/poller_task.hpp"
+#include "fly/net/socket_options.hpp"
 
 namespace fly {
 namespace net {
@@ -33,16 +34,59 @@ template<typename T>
 class Poller
 {
 public:
-    Poller(uint32 num);
+    Poller(uint32 num, POLLER_BACKEND backend = POLLER_EPOLL, PLACEMENT_POLICY placement = PLACEMENT_ROUND_ROBIN,
+           std::vector<std::vector<uint32>> cpu_sets = {});
     void wait();
     void start();
-    void stop();
+    void stop(uint32 drain_timeout_ms = 0);
+    Drain_Progress drain_progress();
     bool register_connection(std::shared_ptr<Connection<T>> connection);
+    bool listen(const std::vector<int32> &listen_fds, std::function<void(std::shared_ptr<Connection<T>>)> cb);
+    bool register_udp_socket(std::shared_ptr<Udp_Socket<T>> udp_socket);
+    void connect(int32 fd, uint32 timeout_ms, std::function<void(int32)> cb);
+    uint64 run_after(uint32 delay_ms, std::function<void()> cb);
+    void cancel_timer(uint64 timer_id);
+    POLLER_BACKEND backend();
+    uint32 poller_task_num();
+    void set_placement_policy(std::shared_ptr<Placement_Policy> placement_policy);
+    std::vector<Poller_Load> loads();
+    void set_socket_options(const Socket_Options &options);
+    const Socket_Options& socket_options();
+    bool migrate(std::shared_ptr<Connection<T>> connection, uint32 target);
+    void set_rebalance(uint32 interval_ms, uint32 imbalance_pct = 50);
+    uint64 migrate_count();
+    void set_spin(uint32 spin_us, uint32 spin_polls = 0, uint32 busy_poll_us = 0);
+    uint64 spin_count();
+    uint64 sleep_count();
+    void set_peer_rate_limit(const Rate_Limit &limit, uint32 capacity = 65536);
+    uint64 rate_delay_count();
+    uint64 rate_drop_count();
+    uint64 rate_close_count();
+    uint64 chunk_pool_hit_count();
+    uint64 chunk_pool_miss_count();
+    uint64 flush_count();
+    uint64 flush_iovec_count();
+    uint64 flush_bytes();
+    uint64 copy_bytes();
+    uint64 zerocopy_bytes();
+    uint64 zerocopy_copied_count();
+    uint64 sendfile_bytes();
+    uint64 send_count();
+    uint64 write_wakeup_count();
     
 private:
+    void rebalance();
     std::unique_ptr<fly::task::Scheduler> m_scheduler;
     std::vector<Poller_Task<T>*> m_poller_tasks;
     uint32 m_poller_task_num = 0;
+    POLLER_BACKEND m_backend;
+    std::shared_ptr<Placement_Policy> m_placement_policy;
+    uint64 m_peer_expire_timer = 0;
+    uint64 m_rebalance_timer = 0;
+    uint32 m_imbalance_pct = 0;
+    std::atomic<uint32> m_udp_socket_num {0};
+    std::atomic<uint32> m_connect_num {0};
+    Socket_Options m_socket_options;
 };
 
 }
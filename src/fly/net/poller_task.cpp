@@ -21,16 +21,46 @@
 
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <arpa/inet.h>
+#include <limits.h>
+#include <algorithm>
 #include <unistd.h>
 #include "fly/base/logger.hpp"
 #include "fly/net/poller_task.hpp"
+#include "fly/net/udp_socket.hpp"
 
 namespace fly {
 namespace net {
 
+//the poller task running on this thread, timers added from it skip the queue
+static thread_local void *t_current_poller_task = nullptr;
+
+//the window of Poller_Load::m_recent_cpu_us
+static const uint32 LOAD_SAMPLE_MS = 200;
+static const uint32 DRAIN_CHECK_MS = 10;
+
 template<typename T>
-Poller_Task<T>::Poller_Task(uint64 seq) : Loop_Task(seq)
+Poller_Task<T>::Poller_Task(uint64 seq, POLLER_BACKEND backend) : Loop_Task(seq)
 {
+    m_chunk_pool = new Message_Chunk_Pool;
+    m_backend = backend;
+
+    if(m_backend == POLLER_URING)
+    {
+        init_uring();
+        run_every(LOAD_SAMPLE_MS, std::bind(&Poller_Task::sample_load, this));
+        
+        return;
+    }
+    
     m_fd = epoll_create1(0);
     
     if(m_fd < 0)
@@ -63,6 +93,22 @@ Poller_Task<T>::Poller_Task(uint64 seq) : Loop_Task(seq)
         return; 
     }
 
+    m_timer_event_fd = eventfd(0, 0);
+
+    if(m_timer_event_fd < 0)
+    {
+        LOG_FATAL("timer event eventfd failed in Poller_Task::Poller_Task");
+        return; 
+    }
+
+    m_read_event_fd = eventfd(0, 0);
+
+    if(m_read_event_fd < 0)
+    {
+        LOG_FATAL("read event eventfd failed in Poller_Task::Poller_Task");
+        return; 
+    }
+
     struct epoll_event event;
     m_close_udata.reset(new Connection<T>(m_close_event_fd, Addr("close_event", 0)));
     event.data.ptr = m_close_udata.get();
@@ -92,17 +138,136 @@ Poller_Task<T>::Poller_Task(uint64 seq) : Loop_Task(seq)
     if(ret < 0)
     {
         LOG_FATAL("stop event epoll_ctl failed in Poller_Task::Poller_Task");
+        return;
+    }
+
+    m_timer_udata.reset(new Connection<T>(m_timer_event_fd, Addr("timer_event", 0)));
+    event.data.ptr = m_timer_udata.get();
+    ret = epoll_ctl(m_fd, EPOLL_CTL_ADD, m_timer_event_fd, &event);
+    
+    if(ret < 0)
+    {
+        LOG_FATAL("timer event epoll_ctl failed in Poller_Task::Poller_Task");
+        return;
+    }
+
+    m_read_udata.reset(new Connection<T>(m_read_event_fd, Addr("read_event", 0)));
+    event.data.ptr = m_read_udata.get();
+    ret = epoll_ctl(m_fd, EPOLL_CTL_ADD, m_read_event_fd, &event);
+    
+    if(ret < 0)
+    {
+        LOG_FATAL("read event epoll_ctl failed in Poller_Task::Poller_Task");
+        return;
+    }
+
+    run_every(LOAD_SAMPLE_MS, std::bind(&Poller_Task::sample_load, this));
+}
+
+//chunks read by this task may still be queued in connections which outlive it
+template<typename T>
+Poller_Task<T>::~Poller_Task()
+{
+    m_chunk_pool->retire();
+
+    if(m_wake_event_fd >= 0)
+    {
+        close(m_wake_event_fd);
+    }
+}
+
+template<typename T>
+bool Poller_Task<T>::init_uring()
+{
+    const uint32 URING_ENTRIES = 1024;
+    const uint32 URING_BUF_NUM = 512;
+    const uint32 URING_BUF_SIZE = 16 * 1024;
+    m_uring.reset(new Uring);
+
+    if(!m_uring->init(URING_ENTRIES))
+    {
+        LOG_FATAL("uring init failed in Poller_Task::init_uring");
+        
+        return false;
     }
+
+    if(!m_uring->init_buf_ring(0, URING_BUF_NUM, URING_BUF_SIZE))
+    {
+        LOG_FATAL("uring init_buf_ring failed in Poller_Task::init_uring");
+        
+        return false;
+    }
+
+    //threads which don't own a ring wake the poller up through this eventfd
+    m_wake_event_fd = eventfd(0, 0);
+    
+    if(m_wake_event_fd < 0)
+    {
+        LOG_FATAL("wake event eventfd failed in Poller_Task::init_uring");
+        
+        return false;
+    }
+    
+    m_uring->prep_read(m_wake_event_fd, &m_wake_data, sizeof(uint64), Uring::pack(nullptr, URING_TAG_EVENTFD));
+
+    return true;
+}
+
+template<typename T>
+POLLER_BACKEND Poller_Task<T>::backend()
+{
+    return m_backend;
 }
 
 template<typename T>
 bool Poller_Task<T>::register_connection(std::shared_ptr<Connection<T>> connection)
 {
+    //a draining poller takes no new connections
+    if(m_draining.load(std::memory_order_relaxed))
+    {
+        close(connection->m_fd);
+        connection->m_closed.store(true, std::memory_order_relaxed);
+
+        return false;
+    }
+    
     struct epoll_event event;
     event.data.ptr = connection.get();
     event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
     connection->m_poller_task = this;
     connection->m_self = connection;
+    connection->m_last_recv_ms = fly::base::monotonic_ms();
+
+    if(m_peer_rate_table)
+    {
+        connection->m_peer_key = Peer_Rate_Table::key(connection->m_peer_addr);
+    }
+
+    //set before the registration, the ones set in init_cb will arm themselves
+    if(connection->m_idle_timeout > 0)
+    {
+        watch_idle(connection, connection->m_idle_gen.load(std::memory_order_relaxed), connection->m_idle_timeout, connection->m_idle_timeout);
+    }
+
+    if(connection->m_heartbeat_interval > 0)
+    {
+        watch_heartbeat(connection, connection->m_heartbeat_gen.load(std::memory_order_relaxed), connection->m_heartbeat_interval,
+                        connection->m_heartbeat_cb, connection->m_heartbeat_interval);
+    }
+    
+    int32 busy_poll_us = m_busy_poll_us.load(std::memory_order_relaxed);
+
+    //raising it above net.core.busy_read needs CAP_NET_ADMIN
+    if(busy_poll_us > 0 && setsockopt(connection->m_fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) < 0)
+    {
+        LOG_DEBUG_ERROR("setsockopt SO_BUSY_POLL failed in Poller_Task::register_connection: %s", strerror(errno));
+    }
+    
+    //init_cb may already send, the write command must find the context in place
+    if(m_uring)
+    {
+        connection->m_uring_ctx.reset(new Uring_Context);
+    }
     
     if(!connection->m_init_cb(connection))
     {
@@ -111,7 +276,18 @@ bool Poller_Task<T>::register_connection(std::shared_ptr<Connection<T>> connecti
         connection->m_self.reset();
         return false;
     }
+
+    m_connection_num.fetch_add(1, std::memory_order_relaxed);
+
+    if(m_uring)
+    {
+        m_register_queue.push(connection);
+        uring_wake();
+        
+        return true;
+    }
     
+    //queued only once the add succeeded, m_self keeps the connection alive until then
     int32 ret = epoll_ctl(m_fd, EPOLL_CTL_ADD, connection->m_fd, &event);
 
     if(ret < 0)
@@ -119,19 +295,38 @@ bool Poller_Task<T>::register_connection(std::shared_ptr<Connection<T>> connecti
         LOG_FATAL("epoll_ctl failed in Poller_Task::register_connection: %s", strerror(errno));
         close(connection->m_fd);
         connection->m_closed.store(true, std::memory_order_relaxed);
+        m_connection_num.fetch_sub(1, std::memory_order_relaxed);
         connection->m_be_closed_cb(connection->shared_from_this());
         connection->m_self.reset();
         
         return false;
     }
 
+    //added to m_connections by the poller thread at the end of its batch. the first EPOLLOUT may have been
+    //handled before the push, so wake it up once more
+    m_register_queue.push(connection);
+    uint64 data = 1;
+
+    if(write(m_write_event_fd, &data, sizeof(uint64)) != sizeof(uint64))
+    {
+        LOG_FATAL("write m_write_event_fd failed in Poller_Task::register_connection");
+    }
+    
     return true;
 }
 
 template<typename T>
 void Poller_Task<T>::close_connection(std::shared_ptr<Connection<T>> connection)
 {
-    m_close_queue.push_direct(connection);
+    m_close_queue.push(connection);
+
+    if(m_uring)
+    {
+        uring_wake();
+        
+        return;
+    }
+    
     uint64 data = 1;
     int32 num = write(m_close_event_fd, &data, sizeof(uint64));
 
@@ -141,9 +336,21 @@ void Poller_Task<T>::close_connection(std::shared_ptr<Connection<T>> connection)
     }
 }
 
+//drain_timeout_ms > 0 stops reading and accepting first and keeps flushing the send queues until they
+//are empty or the timeout passed, see drain_progress(). the loop ends after that
 template<typename T>
-void Poller_Task<T>::stop()
+void Poller_Task<T>::stop(uint32 drain_timeout_ms)
 {
+    m_drain_timeout_ms.store(drain_timeout_ms, std::memory_order_relaxed);
+    
+    if(m_uring)
+    {
+        m_uring_stop.store(true, std::memory_order_relaxed);
+        uring_wake();
+        
+        return;
+    }
+    
     uint64 data = 1;
     int32 num = write(m_stop_event_fd, &data, sizeof(uint64));
     
@@ -154,242 +361,2207 @@ void Poller_Task<T>::stop()
 }
 
 template<typename T>
-void Poller_Task<T>::write_connection(std::shared_ptr<Connection<T>> connection)
+uint64 Poller_Task<T>::zerocopy_bytes()
 {
-    m_write_queue.push_direct(connection);
-    uint64 data = 1;
-    int32 num = write(m_write_event_fd, &data, sizeof(uint64));
-    
-    if(num != sizeof(uint64))
-    {
-        LOG_FATAL("write m_write_event_fd failed in Poller_Task::write_connection");
-    }
+    return m_zerocopy_bytes.load(std::memory_order_relaxed);
 }
 
 template<typename T>
-void Poller_Task<T>::do_write(std::shared_ptr<Connection<T>> connection)
+uint64 Poller_Task<T>::copy_bytes()
 {
-    int32 fd = connection->m_fd;
-    Message_Chunk_Queue &send_queue = connection->m_send_msg_queue;
-    
-    while(Message_Chunk *message_chunk = send_queue.pop())
-    {
-        int32 message_length = message_chunk->length();
-        int32 num = write(fd, message_chunk->read_ptr(), message_length);
+    return m_flush_bytes.load(std::memory_order_relaxed) - m_zerocopy_bytes.load(std::memory_order_relaxed)
+        - m_sendfile_bytes.load(std::memory_order_relaxed);
+}
 
-        if(num < 0)
-        {
-            if(errno == EAGAIN || errno == EWOULDBLOCK)
-            {
-                send_queue.push_front(message_chunk);
-                
-                break;
-            }
-        }
+template<typename T>
+uint64 Poller_Task<T>::sendfile_bytes()
+{
+    return m_sendfile_bytes.load(std::memory_order_relaxed);
+}
 
-        if(num == 0)
-        {
-            LOG_FATAL("write return 0, it's impossible, in Poller_Task::do_write(arg)");
-        }
-        
-        if(num <= 0)
-        {
-            epoll_ctl(m_fd, EPOLL_CTL_DEL, fd, NULL);
-            close(fd);
-            connection->m_self.reset();
-            connection->m_closed.store(true, std::memory_order_relaxed);
-            connection->m_be_closed_cb(connection);
-            
-            break;
-        }
-                
-        if(num < message_length)
-        {
-            message_chunk->read_ptr(num);
-            send_queue.push_front(message_chunk);
+template<typename T>
+uint64 Poller_Task<T>::zerocopy_copied_count()
+{
+    return m_zerocopy_copied_count.load(std::memory_order_relaxed);
+}
 
-            break;
-        }
-        else
-        {
-            delete message_chunk;
-        }
-    }
+template<typename T>
+uint64 Poller_Task<T>::send_count()
+{
+    return m_send_count.load(std::memory_order_relaxed);
 }
 
 template<typename T>
-void Poller_Task<T>::do_write()
+uint64 Poller_Task<T>::write_wakeup_count()
 {
-    uint64 data = 0;
-    int32 num = read(m_write_event_fd, &data, sizeof(uint64));
+    return m_write_wakeup_count.load(std::memory_order_relaxed);
+}
 
-    if(num != sizeof(uint64))
+template<typename T>
+Poller_Load Poller_Task<T>::load()
+{
+    Poller_Load load;
+    load.m_connection_num = m_connection_num.load(std::memory_order_relaxed);
+    load.m_recent_cpu_us = m_recent_cpu_us.load(std::memory_order_relaxed);
+    load.m_cpu_us = m_cpu_us.load(std::memory_order_relaxed);
+
+    return load;
+}
+
+//runs on the poller thread, so the thread cpu clock is the one of this task
+template<typename T>
+void Poller_Task<T>::sample_load()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    uint64 cpu_us = (uint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    m_recent_cpu_us.store(cpu_us - m_cpu_us.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_cpu_us.store(cpu_us, std::memory_order_relaxed);
+}
+
+//after a batch with events the loop polls without blocking until spin_us microseconds or spin_polls
+//empty polls have passed, whichever is set and runs out first. both 0 turns spinning off.
+//busy_poll_us is applied as SO_BUSY_POLL to the connections registered afterwards
+template<typename T>
+void Poller_Task<T>::set_spin(uint32 spin_us, uint32 spin_polls, uint32 busy_poll_us)
+{
+    m_spin_us.store(spin_us, std::memory_order_relaxed);
+    m_spin_polls.store(spin_polls, std::memory_order_relaxed);
+    m_busy_poll_us.store(busy_poll_us, std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Poller_Task<T>::spin_count()
+{
+    return m_spin_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Poller_Task<T>::sleep_count()
+{
+    return m_sleep_count.load(std::memory_order_relaxed);
+}
+
+//shared by all the poller tasks of a Poller, set before any connection is registered
+template<typename T>
+void Poller_Task<T>::set_peer_rate_table(std::shared_ptr<Peer_Rate_Table> peer_rate_table)
+{
+    m_peer_rate_table = peer_rate_table;
+}
+
+template<typename T>
+uint64 Poller_Task<T>::rate_delay_count()
+{
+    return m_rate_delay_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Poller_Task<T>::rate_drop_count()
+{
+    return m_rate_drop_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Poller_Task<T>::rate_close_count()
+{
+    return m_rate_close_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+bool Poller_Task<T>::spinning()
+{
+    uint32 spin_us = m_spin_us.load(std::memory_order_relaxed);
+    uint32 spin_polls = m_spin_polls.load(std::memory_order_relaxed);
+
+    if(spin_us == 0 && spin_polls == 0)
     {
-        LOG_FATAL("read m_write_event_fd failed in Poller_Task::do_write");
-        
-        return;
+        return false;
     }
-    
-    std::list<std::shared_ptr<Connection<T>>> write_queue;
 
-    if(m_write_queue.pop(write_queue))
+    if(spin_us > 0 && fly::base::monotonic_us() - m_last_active_us >= spin_us)
     {
-        for(auto &connection : write_queue)
-        {
-            if(!connection->m_closed.load(std::memory_order_relaxed))
-            {
-                do_write(connection);
-            }
-        }
+        return false;
     }
+
+    return spin_polls == 0 || m_idle_polls < spin_polls;
 }
 
 template<typename T>
-void Poller_Task<T>::do_close()
+void Poller_Task<T>::spin_done(bool spin, bool active)
 {
-    uint64 data = 0;
-    int32 num = read(m_close_event_fd, &data, sizeof(uint64));
-    
-    if(num != sizeof(uint64))
+    if(spin)
     {
-        LOG_FATAL("read m_close_event_fd failed in Poller_Task::do_close");
-        
-        return;
+        m_spin_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        m_sleep_count.fetch_add(1, std::memory_order_relaxed);
     }
 
-    std::list<std::shared_ptr<Connection<T>>> close_queue;
-
-    if(m_close_queue.pop(close_queue))
+    if(active)
     {
-        for(auto &connection : close_queue)
+        if(m_spin_us.load(std::memory_order_relaxed) > 0 || m_spin_polls.load(std::memory_order_relaxed) > 0)
         {
-            if(!connection->m_closed.load(std::memory_order_relaxed))
-            {
-                int32 fd = connection->m_fd;
-                int ret = epoll_ctl(m_fd, EPOLL_CTL_DEL, fd, NULL);
-
-                if(ret < 0)
-                {
-                    LOG_FATAL("epoll_ctl EPOLL_CTL_DEL failed in Poller_Task::do_close: %s", strerror(errno));
-                }
-                
-                close(fd);
-                connection->m_self.reset();
-                connection->m_closed.store(true, std::memory_order_relaxed);
-                connection->m_close_cb(connection);
-            }
+            m_last_active_us = fly::base::monotonic_us();
+            m_idle_polls = 0;
         }
     }
+    else if(spin)
+    {
+        ++m_idle_polls;
+    }
 }
 
 template<typename T>
-void Poller_Task<T>::run_in_loop()
+uint64 Poller_Task<T>::run_after(uint32 delay_ms, std::function<void()> cb)
 {
-    struct epoll_event events[2048];
-    int32 fd_num = epoll_wait(m_fd, events, 2048, -1);
-    
-    if(fd_num < 0)
+    uint64 id = m_timer_id_allocator.new_id();
+    add_timer(id, delay_ms, 0, cb);
+
+    return id;
+}
+
+template<typename T>
+uint64 Poller_Task<T>::run_every(uint32 interval_ms, std::function<void()> cb)
+{
+    uint64 id = m_timer_id_allocator.new_id();
+    add_timer(id, interval_ms, interval_ms, cb);
+
+    return id;
+}
+
+template<typename T>
+void Poller_Task<T>::cancel_timer(uint64 timer_id)
+{
+    add_timer(timer_id, 0, 0, nullptr);
+}
+
+//the wheel is only touched by the poller thread, other threads go through m_timer_queue
+//an empty cb means cancel
+template<typename T>
+void Poller_Task<T>::add_timer(uint64 id, uint32 delay_ms, uint32 interval_ms, std::function<void()> cb)
+{
+    if(t_current_poller_task == this)
     {
-        LOG_DEBUG_ERROR("epoll_wait failed in Poller_Task::run_in_loop %s", strerror(errno));
+        if(cb)
+        {
+            m_timer_wheel.add(id, delay_ms, interval_ms, cb);
+        }
+        else
+        {
+            m_timer_wheel.cancel(id);
+        }
 
         return;
     }
 
-    for(auto i = 0; i < fd_num; ++i)
-    {
-        Connection<T> *connection = static_cast<Connection<T>*>(events[i].data.ptr);
-        int32 fd = connection->m_fd;
-        uint32 event = events[i].events;
+    std::unique_ptr<Timer_Cmd> cmd(new Timer_Cmd);
+    cmd->m_id = id;
+    cmd->m_delay_ms = delay_ms;
+    cmd->m_interval_ms = interval_ms;
+    cmd->m_cb = cb;
+    m_timer_queue.push(std::move(cmd));
 
-        if(event & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
-        {
-            if(connection->m_closed.load(std::memory_order_relaxed))
-            {
-                continue;
-            }
+    if(m_uring)
+    {
+        uring_wake();
 
-            int ret = epoll_ctl(m_fd, EPOLL_CTL_DEL, fd, NULL);
+        return;
+    }
+    
+    uint64 data = 1;
+    int32 num = write(m_timer_event_fd, &data, sizeof(uint64));
+    
+    if(num != sizeof(uint64))
+    {
+        LOG_FATAL("write m_timer_event_fd failed in Poller_Task::add_timer");
+    }
+}
 
-            if(ret < 0)
-            {
-                LOG_FATAL("epoll_ctl EPOLL_CTL_DEL failed in Poller_Task::run_in_loop: %s", strerror(errno));
-            }
+template<typename T>
+void Poller_Task<T>::do_timer()
+{
+    std::vector<std::unique_ptr<Timer_Cmd>> timer_queue;
 
-            close(fd);
-            connection->m_closed.store(true, std::memory_order_relaxed);
-            connection->m_be_closed_cb(connection->shared_from_this());
-            connection->m_self.reset();
-        }
-        else if(event & EPOLLIN)
+    if(m_timer_queue.pop(timer_queue))
+    {
+        for(auto &cmd : timer_queue)
         {
-            if(fd == m_close_event_fd)
-            {
-                do_close();
-            }
-            else if(fd == m_write_event_fd)
-            {
-                do_write();
-            }
-            else if(fd == m_stop_event_fd)
+            if(cmd->m_cb)
             {
-                Loop_Task::stop();
-                close(m_fd);
-                break;
+                m_timer_wheel.add(cmd->m_id, cmd->m_delay_ms, cmd->m_interval_ms, cmd->m_cb);
             }
             else
             {
-                if(connection->m_closed.load(std::memory_order_relaxed))
-                {
-                    continue;
-                }
-                
-                while(true)
-                {
-                    const uint32 REQ_SIZE = 2 * 1024 * 1024;
-                    Message_Chunk_Queue &recv_queue = connection->m_recv_msg_queue;
-                    std::unique_ptr<Message_Chunk> message_chunk(new Message_Chunk(REQ_SIZE));
-                    int32 num = read(fd, message_chunk->read_ptr(), REQ_SIZE);
-
-                    if(num < 0)
-                    {
-                        if(errno == EAGAIN || errno == EWOULDBLOCK)
-                        {
-                            break;
-                        }
-                    }
-                    
-                    if(num <= 0)
-                    {
-                        epoll_ctl(m_fd, EPOLL_CTL_DEL, fd, NULL);
-                        close(fd);
-                        connection->m_closed.store(true, std::memory_order_relaxed);
-                        connection->m_be_closed_cb(connection->shared_from_this());
-                        connection->m_self.reset();
-
-                        break;
-                    }
-                    
-                    message_chunk->write_ptr(num);
-                    recv_queue.push(message_chunk.release());
-                    connection->parse();
-
-                    if(num < REQ_SIZE)
-                    {
-                        break;
-                    }
-                }
+                m_timer_wheel.cancel(cmd->m_id);
             }
         }
+    }
+}
 
-        if(event & EPOLLOUT)
+//one pending check per connection, rescheduled to when it could expire at the earliest,
+//so traffic on the connection doesn't touch the wheel at all
+template<typename T>
+void Poller_Task<T>::watch_idle(std::shared_ptr<Connection<T>> connection, uint32 gen, uint32 timeout_ms, uint32 delay_ms)
+{
+    std::weak_ptr<Connection<T>> weak_connection = connection;
+    
+    run_after(delay_ms, [=]()
+    {
+        std::shared_ptr<Connection<T>> connection = weak_connection.lock();
+
+        if(!connection || connection->m_closed.load(std::memory_order_relaxed) || connection->m_idle_gen.load(std::memory_order_relaxed) != gen)
         {
-            if(connection->m_closed.load(std::memory_order_relaxed))
-            {
-                continue;
-            }
-            
-            do_write(connection->shared_from_this());
+            return;
+        }
+        
+        uint64 idle_ms = m_now_ms > connection->m_last_recv_ms ? m_now_ms - connection->m_last_recv_ms : 0;
+
+        if(idle_ms >= timeout_ms)
+        {
+            LOG_DEBUG_INFO("connection from %s:%d idle for %llu ms, close it", connection->m_peer_addr.host().c_str(), connection->m_peer_addr.port(), idle_ms);
+            connection->close();
+
+            return;
+        }
+
+        watch_idle(connection, gen, timeout_ms, timeout_ms - idle_ms);
+    });
+}
+
+//the heartbeat cb is called when nothing has been received for interval_ms
+template<typename T>
+void Poller_Task<T>::watch_heartbeat(std::shared_ptr<Connection<T>> connection, uint32 gen, uint32 interval_ms,
+                                     std::function<void(std::shared_ptr<Connection<T>>)> cb, uint32 delay_ms)
+{
+    std::weak_ptr<Connection<T>> weak_connection = connection;
+    
+    run_after(delay_ms, [=]()
+    {
+        std::shared_ptr<Connection<T>> connection = weak_connection.lock();
+
+        if(!connection || connection->m_closed.load(std::memory_order_relaxed) || connection->m_heartbeat_gen.load(std::memory_order_relaxed) != gen)
+        {
+            return;
+        }
+        
+        uint64 idle_ms = m_now_ms > connection->m_last_recv_ms ? m_now_ms - connection->m_last_recv_ms : 0;
+
+        if(idle_ms >= interval_ms)
+        {
+            cb(connection);
+            watch_heartbeat(connection, gen, interval_ms, cb, interval_ms);
+
+            return;
+        }
+
+        watch_heartbeat(connection, gen, interval_ms, cb, interval_ms - idle_ms);
+    });
+}
+
+template<typename T>
+Message_Chunk_Pool* Poller_Task<T>::chunk_pool()
+{
+    return m_chunk_pool;
+}
+
+template<typename T>
+void Poller_Task<T>::write_connection(std::shared_ptr<Connection<T>> connection)
+{
+    m_send_count.fetch_add(1, std::memory_order_relaxed);
+
+    //already queued for flushing, the pending flush will pick up the new chunks too
+    if(connection->m_write_pending.exchange(true))
+    {
+        return;
+    }
+
+    //sent from the poller thread itself (e.g. in dispatch_cb), flushed at the end of the current batch
+    if(t_current_poller_task == this)
+    {
+        m_local_write_queue.push_back(connection);
+
+        return;
+    }
+    
+    m_write_queue.push(connection);
+
+    //only the transition of the pending set from empty to non-empty wakes the poller up
+    if(m_write_signaled.exchange(true))
+    {
+        return;
+    }
+
+    m_write_wakeup_count.fetch_add(1, std::memory_order_relaxed);
+    
+    if(m_uring)
+    {
+        uring_wake();
+        
+        return;
+    }
+    
+    uint64 data = 1;
+    int32 num = write(m_write_event_fd, &data, sizeof(uint64));
+    
+    if(num != sizeof(uint64))
+    {
+        LOG_FATAL("write m_write_event_fd failed in Poller_Task::write_connection");
+    }
+}
+
+template<typename T>
+void Poller_Task<T>::resume_read(std::shared_ptr<Connection<T>> connection)
+{
+    //resumed from the poller thread itself (e.g. in dispatch_cb), read at the end of the current batch
+    if(t_current_poller_task == this)
+    {
+        m_local_read_queue.push_back(connection);
+
+        return;
+    }
+
+    m_read_queue.push(connection);
+
+    if(m_uring)
+    {
+        uring_wake();
+        
+        return;
+    }
+    
+    uint64 data = 1;
+    int32 num = write(m_read_event_fd, &data, sizeof(uint64));
+    
+    if(num != sizeof(uint64))
+    {
+        LOG_FATAL("write m_read_event_fd failed in Poller_Task::resume_read");
+    }
+}
+
+//moves a connection of this poller task to target (of the same backend) with its queued chunks and parse state.
+//done on this poller thread within a timer tick, it's given up if the connection closes or either side drains meanwhile
+template<typename T>
+bool Poller_Task<T>::migrate(std::shared_ptr<Connection<T>> connection, Poller_Task<T> *target)
+{
+    if(target == this || target->m_backend != m_backend || connection->poller_task() != this
+       || connection->m_closed.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+
+    run_after(0, [=]
+    {
+        do_migrate(connection, target);
+    });
+
+    return true;
+}
+
+template<typename T>
+void Poller_Task<T>::do_migrate(std::shared_ptr<Connection<T>> connection, Poller_Task<T> *target)
+{
+    if(connection->m_closed.load(std::memory_order_relaxed) || connection->poller_task() != this || migrate_target(connection.get()) != nullptr)
+    {
+        return;
+    }
+
+    //handed over to this poller task but still in its register queue, it can't be moved on before it's registered
+    if(m_connections.find(connection.get()) == m_connections.end())
+    {
+        return;
+    }
+
+    if(m_draining.load(std::memory_order_relaxed) || target->m_draining.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    if(m_uring)
+    {
+        //the requests in flight on this ring have to complete first, the recv is re-armed on the target ring
+        Uring_Context *ctx = connection->m_uring_ctx.get();
+        m_migrating[connection.get()] = target;
+
+        if(!ctx->m_recv_stopped && !ctx->m_recv_cancelling)
+        {
+            m_uring->prep_cancel(Uring::pack(connection.get(), URING_TAG_RECV), Uring::pack(nullptr, URING_TAG_IGNORE));
+            ctx->m_recv_cancelling = true;
         }
+
+        uring_migrate(connection.get());
+
+        return;
+    }
+
+    if(epoll_ctl(m_fd, EPOLL_CTL_DEL, connection->m_fd, NULL) < 0)
+    {
+        LOG_ERROR("epoll_ctl EPOLL_CTL_DEL failed in Poller_Task::do_migrate: %s", strerror(errno));
+
+        return;
+    }
+
+    hand_over(connection, target);
+}
+
+template<typename T>
+Poller_Task<T>* Poller_Task<T>::migrate_target(Connection<T> *connection)
+{
+    if(m_migrating.empty())
+    {
+        return nullptr;
+    }
+
+    auto iter = m_migrating.find(connection);
+
+    return iter == m_migrating.end() ? nullptr : iter->second;
+}
+
+//hands a migrating connection over once this ring holds no request of it anymore
+template<typename T>
+void Poller_Task<T>::uring_migrate(Connection<T> *connection)
+{
+    Uring_Context *ctx = connection->m_uring_ctx.get();
+
+    if(ctx->m_pending_ops > 0)
+    {
+        return;
+    }
+
+    Poller_Task<T> *target = migrate_target(connection);
+    m_migrating.erase(connection);
+    ctx->m_recv_stopped = false;
+    ctx->m_recv_cancelling = false;
+    hand_over(connection->shared_from_this(), target);
+}
+
+//the senders see the new poller task from here on, what they queued here meanwhile is forwarded
+template<typename T>
+void Poller_Task<T>::hand_over(std::shared_ptr<Connection<T>> connection, Poller_Task<T> *target)
+{
+    m_connections.erase(connection.get());
+    m_connection_num.fetch_sub(1, std::memory_order_relaxed);
+    connection->m_poller_task.store(target, std::memory_order_release);
+    target->adopt(connection);
+}
+
+//called from the thread of the poller task the connection is migrated from
+template<typename T>
+void Poller_Task<T>::adopt(std::shared_ptr<Connection<T>> connection)
+{
+    m_connection_num.fetch_add(1, std::memory_order_relaxed);
+    m_migrate_count.fetch_add(1, std::memory_order_relaxed);
+
+    //the watchers left on the old poller task see a new gen and stop
+    if(connection->m_idle_timeout > 0)
+    {
+        uint32 gen = connection->m_idle_gen.fetch_add(1, std::memory_order_relaxed) + 1;
+        watch_idle(connection, gen, connection->m_idle_timeout, connection->m_idle_timeout);
+    }
+
+    if(connection->m_heartbeat_interval > 0)
+    {
+        uint32 gen = connection->m_heartbeat_gen.fetch_add(1, std::memory_order_relaxed) + 1;
+        watch_heartbeat(connection, gen, connection->m_heartbeat_interval, connection->m_heartbeat_cb, connection->m_heartbeat_interval);
+    }
+
+    m_register_queue.push(connection);
+
+    if(m_uring)
+    {
+        uring_wake();
+
+        return;
+    }
+
+    //edge triggered, the add reports what is readable and writable already so nothing buffered is missed
+    struct epoll_event event;
+    event.data.ptr = connection.get();
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+
+    if(epoll_ctl(m_fd, EPOLL_CTL_ADD, connection->m_fd, &event) < 0)
+    {
+        LOG_FATAL("epoll_ctl failed in Poller_Task::adopt: %s", strerror(errno));
+        close_connection(connection);
+    }
+}
+
+//migrates one connection to target, the one whose received bytes since the last shed come closest to
+//permille of all received here meanwhile. called by the rebalancer of Poller
+template<typename T>
+void Poller_Task<T>::shed(Poller_Task<T> *target, uint32 permille)
+{
+    run_after(0, [=]
+    {
+        do_shed(target, permille);
+    });
+}
+
+template<typename T>
+void Poller_Task<T>::do_shed(Poller_Task<T> *target, uint32 permille)
+{
+    uint64 total = 0;
+
+    for(auto *connection : m_connections)
+    {
+        total += connection->m_recv_bytes - connection->m_shed_bytes;
+    }
+
+    uint64 want = total * permille / 1000;
+    Connection<T> *best = nullptr;
+    uint64 best_diff = 0;
+
+    for(auto *connection : m_connections)
+    {
+        uint64 bytes = connection->m_recv_bytes - connection->m_shed_bytes;
+        connection->m_shed_bytes = connection->m_recv_bytes;
+
+        if(bytes == 0)
+        {
+            continue;
+        }
+
+        uint64 diff = bytes > want ? bytes - want : want - bytes;
+
+        if(best == nullptr || diff < best_diff)
+        {
+            best = connection;
+            best_diff = diff;
+        }
+    }
+
+    if(best != nullptr)
+    {
+        do_migrate(best->shared_from_this(), target);
+    }
+}
+
+template<typename T>
+uint64 Poller_Task<T>::migrate_count()
+{
+    return m_migrate_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+void Poller_Task<T>::do_write(std::shared_ptr<Connection<T>> connection)
+{
+    //migrated away after this write was queued here
+    if(connection->poller_task() != this)
+    {
+        connection->poller_task()->write_connection(connection);
+
+        return;
+    }
+    
+    int32 fd = connection->m_fd;
+    Message_Chunk_Queue &send_queue = connection->m_send_msg_queue;
+    Message_Chunk *message_chunks[IOV_MAX];
+    struct iovec iov[IOV_MAX];
+    
+    while(uint32 count = send_queue.pop(message_chunks, IOV_MAX))
+    {
+        //a file chunk goes out alone with sendfile and a zerocopy chunk alone with MSG_ZEROCOPY,
+        //the chunks before it with a plain writev
+        uint32 special_idx = 0;
+
+        while(special_idx < count && !is_special_chunk(connection.get(), message_chunks[special_idx]))
+        {
+            ++special_idx;
+        }
+
+        if(special_idx < count)
+        {
+            uint32 send_count = special_idx == 0 ? 1 : special_idx;
+            send_queue.push_front(message_chunks + send_count, count - send_count);
+            count = send_count;
+        }
+        
+        for(uint32 i = 0; i < count; ++i)
+        {
+            iov[i].iov_base = message_chunks[i]->read_ptr();
+            iov[i].iov_len = message_chunks[i]->length();
+        }
+        
+        int32 num;
+
+        if(message_chunks[0]->file_fd() >= 0)
+        {
+            num = send_file_chunk(connection.get(), message_chunks[0]);
+        }
+        else if(connection->m_zerocopy_threshold > 0 && message_chunks[0]->holder())
+        {
+            num = send_zerocopy(connection.get(), message_chunks[0], iov);
+        }
+        else
+        {
+            num = writev(fd, iov, count);
+        }
+
+        if(num < 0)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                send_queue.push_front(message_chunks, count);
+                
+                break;
+            }
+        }
+
+        if(num == 0)
+        {
+            LOG_FATAL("writev return 0, it's impossible, in Poller_Task::do_write(arg)");
+        }
+        
+        if(num <= 0)
+        {
+            for(uint32 i = 0; i < count; ++i)
+            {
+                delete message_chunks[i];
+            }
+            
+            epoll_ctl(m_fd, EPOLL_CTL_DEL, fd, NULL);
+            close(fd);
+            connection->m_self.reset();
+            connection->m_closed.store(true, std::memory_order_relaxed);
+            m_connection_num.fetch_sub(1, std::memory_order_relaxed);
+            m_connections.erase(connection.get());
+            connection->m_be_closed_cb(connection);
+            
+            break;
+        }
+
+        //partial write, the rest will be flushed on the next EPOLLOUT
+        if(!write_done(send_queue, message_chunks, count, num))
+        {
+            break;
+        }
+    }
+
+    check_drain(connection.get());
+}
+
+//epoll only, the uring registrations are picked up by uring_do_cmds
+template<typename T>
+void Poller_Task<T>::do_register()
+{
+    std::vector<std::shared_ptr<Connection<T>>> queue;
+
+    if(!m_register_queue.pop(queue))
+    {
+        return;
+    }
+
+    for(auto &connection : queue)
+    {
+        if(connection->m_closed.load(std::memory_order_relaxed))
+        {
+            continue;
+        }
+
+        m_connections.insert(connection.get());
+
+        if(m_draining.load(std::memory_order_relaxed))
+        {
+            connection->drain();
+        }
+    }
+}
+
+//called once the loop is asked to stop, true while a drain still keeps it running
+template<typename T>
+bool Poller_Task<T>::draining()
+{
+    if(m_drain_done.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+
+    if(!m_draining.load(std::memory_order_relaxed))
+    {
+        uint32 drain_timeout_ms = m_drain_timeout_ms.load(std::memory_order_relaxed);
+
+        if(drain_timeout_ms == 0)
+        {
+            return false;
+        }
+
+        begin_drain(drain_timeout_ms);
+    }
+    else if(m_drain_timeout_ms.load(std::memory_order_relaxed) == 0)
+    {
+        //a plain stop() during the drain cuts it short
+        return false;
+    }
+
+    return !m_drain_done.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+void Poller_Task<T>::begin_drain(uint32 drain_timeout_ms)
+{
+    m_draining.store(true, std::memory_order_relaxed);
+    m_drain_deadline_ms = m_now_ms + drain_timeout_ms;
+
+    for(auto &listener : m_listeners)
+    {
+        if(m_uring)
+        {
+            m_uring->prep_cancel(Uring::pack(listener.get(), URING_TAG_ACCEPT), Uring::pack(nullptr, URING_TAG_IGNORE));
+        }
+        else
+        {
+            epoll_ctl(m_fd, EPOLL_CTL_DEL, listener->m_fd, NULL);
+        }
+    }
+
+    if(!m_uring)
+    {
+        do_register();
+    }
+    
+    for(auto *connection : m_connections)
+    {
+        connection->drain();
+    }
+
+    LOG_INFO("poller task %lu starts draining %lu connections, timeout: %u ms", seq(), m_connections.size(), drain_timeout_ms);
+    run_every(DRAIN_CHECK_MS, std::bind(&Poller_Task::drain_step, this));
+    drain_step();
+}
+
+//a connection is flushed once its send queue is empty and the kernel has no unacked bytes of it,
+//closing it earlier could lose them to a reset
+template<typename T>
+void Poller_Task<T>::drain_step()
+{
+    if(m_drain_done.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    
+    uint32 connection_num = 0;
+    uint64 pending_bytes = 0;
+
+    for(auto *connection : m_connections)
+    {
+        uint64 bytes = connection->m_send_msg_queue.length();
+        int32 unsent = 0;
+
+        if(ioctl(connection->m_fd, SIOCOUTQ, &unsent) == 0)
+        {
+            bytes += unsent;
+        }
+
+        //popped from the queue by a send still in flight
+        if(connection->m_uring_ctx)
+        {
+            for(auto *message_chunk : connection->m_uring_ctx->m_send_chunks)
+            {
+                bytes += message_chunk->length();
+            }
+        }
+
+        if(bytes > 0)
+        {
+            ++connection_num;
+            pending_bytes += bytes;
+        }
+    }
+
+    m_drain_connection_num.store(connection_num, std::memory_order_relaxed);
+    m_drain_pending_bytes.store(pending_bytes, std::memory_order_relaxed);
+
+    if(connection_num > 0 && m_now_ms < m_drain_deadline_ms)
+    {
+        return;
+    }
+
+    if(connection_num > 0)
+    {
+        LOG_WARN("poller task %lu drain timed out, %u connections left %lu bytes unflushed", seq(), connection_num, pending_bytes);
+        m_drain_dropped_num.store(connection_num, std::memory_order_relaxed);
+    }
+
+    m_drain_done.store(true, std::memory_order_relaxed);
+}
+
+template<typename T>
+Drain_Progress Poller_Task<T>::drain_progress()
+{
+    Drain_Progress progress;
+    progress.m_draining = m_draining.load(std::memory_order_relaxed);
+    progress.m_done = m_drain_done.load(std::memory_order_relaxed);
+    progress.m_connection_num = m_drain_connection_num.load(std::memory_order_relaxed);
+    progress.m_pending_bytes = m_drain_pending_bytes.load(std::memory_order_relaxed);
+    progress.m_dropped_num = m_drain_dropped_num.load(std::memory_order_relaxed);
+
+    return progress;
+}
+
+template<typename T>
+void Poller_Task<T>::check_drain(Connection<T> *connection)
+{
+    if(connection->m_send_high_watermark == 0 || connection->m_closed.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    //pairs with the fence in Connection::send_blocked
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if(!connection->m_send_blocked.load(std::memory_order_relaxed) || connection->m_send_msg_queue.length() > connection->m_send_low_watermark)
+    {
+        return;
+    }
+
+    if(connection->m_send_blocked.exchange(false) && connection->m_drain_cb)
+    {
+        connection->m_drain_cb(connection->shared_from_this());
+    }
+}
+
+template<typename T>
+bool Poller_Task<T>::is_special_chunk(Connection<T> *connection, Message_Chunk *message_chunk)
+{
+    return message_chunk->file_fd() >= 0 || (connection->m_zerocopy_threshold > 0 && message_chunk->holder());
+}
+
+//the file chunk keeps its own offset, a partial send just advances it
+template<typename T>
+int32 Poller_Task<T>::send_file_chunk(Connection<T> *connection, Message_Chunk *message_chunk)
+{
+    off_t offset = message_chunk->file_offset();
+    ssize_t num = sendfile(connection->m_fd, message_chunk->file_fd(), &offset, message_chunk->length());
+
+    //the file is shorter than what was promised to the peer, the stream can't be kept in sync
+    if(num == 0)
+    {
+        LOG_ERROR("file truncated under sendfile in Poller_Task::send_file_chunk");
+        errno = EIO;
+        
+        return -1;
+    }
+
+    if(num > 0)
+    {
+        m_sendfile_bytes.fetch_add(num, std::memory_order_relaxed);
+    }
+    
+    return num;
+}
+
+//the buffer is held in m_zerocopy_pending until its completion shows up on the error queue
+template<typename T>
+int32 Poller_Task<T>::send_zerocopy(Connection<T> *connection, Message_Chunk *message_chunk, struct iovec *iov)
+{
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 1;
+    int32 num = sendmsg(connection->m_fd, &msg, MSG_ZEROCOPY);
+
+    //out of optmem for the notifications, copy this one
+    if(num < 0 && errno == ENOBUFS)
+    {
+        return writev(connection->m_fd, iov, 1);
+    }
+    
+    if(num > 0)
+    {
+        connection->m_zerocopy_pending.emplace_back(connection->m_zerocopy_seq++, message_chunk->holder());
+        m_zerocopy_bytes.fetch_add(num, std::memory_order_relaxed);
+    }
+
+    return num;
+}
+
+//drains the zerocopy completions from the error queue, false if the socket has a real error
+template<typename T>
+bool Poller_Task<T>::zerocopy_done(Connection<T> *connection)
+{
+    char control[128];
+    
+    while(true)
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if(recvmsg(connection->m_fd, &msg, MSG_ERRQUEUE) < 0)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+
+            return false;
+        }
+
+        for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if(!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) && !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+            {
+                continue;
+            }
+
+            struct sock_extended_err *err = (struct sock_extended_err*)CMSG_DATA(cmsg);
+
+            if(err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                return false;
+            }
+
+            //sends [ee_info, ee_data] are released, the kernel may have copied them after all
+            uint32 lo = err->ee_info;
+            uint32 hi = err->ee_data;
+            auto &pending = connection->m_zerocopy_pending;
+
+            if(err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                m_zerocopy_copied_count.fetch_add(hi - lo + 1, std::memory_order_relaxed);
+            }
+            
+            while(!pending.empty() && pending.front().first - lo <= hi - lo)
+            {
+                pending.pop_front();
+            }
+        }
+    }
+
+    int32 error = 0;
+    socklen_t length = sizeof(error);
+
+    return getsockopt(connection->m_fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+}
+
+//frees the chunks fully covered by the num written bytes and puts the rest back in order
+template<typename T>
+bool Poller_Task<T>::write_done(Message_Chunk_Queue &send_queue, Message_Chunk **message_chunks, uint32 count, uint32 num)
+{
+    m_flush_count.fetch_add(1, std::memory_order_relaxed);
+    m_flush_iovec_count.fetch_add(count, std::memory_order_relaxed);
+    m_flush_bytes.fetch_add(num, std::memory_order_relaxed);
+    uint32 remain_bytes = num;
+    uint32 i = 0;
+
+    for(; i < count; ++i)
+    {
+        uint32 message_length = message_chunks[i]->length();
+
+        if(remain_bytes < message_length)
+        {
+            break;
+        }
+
+        remain_bytes -= message_length;
+        delete message_chunks[i];
+    }
+
+    if(i < count)
+    {
+        message_chunks[i]->read_ptr(remain_bytes);
+        send_queue.push_front(message_chunks + i, count - i);
+
+        return false;
+    }
+
+    return true;
+}
+
+template<typename T>
+uint64 Poller_Task<T>::flush_count()
+{
+    return m_flush_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Poller_Task<T>::flush_iovec_count()
+{
+    return m_flush_iovec_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Poller_Task<T>::flush_bytes()
+{
+    return m_flush_bytes.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+void Poller_Task<T>::do_write()
+{
+    uint64 data = 0;
+    int32 num = read(m_write_event_fd, &data, sizeof(uint64));
+
+    if(num != sizeof(uint64))
+    {
+        LOG_FATAL("read m_write_event_fd failed in Poller_Task::do_write");
+        
+        return;
+    }
+    
+    //cleared before popping, a send racing with this pop signals again
+    m_write_signaled.exchange(false);
+    std::vector<std::shared_ptr<Connection<T>>> write_queue;
+
+    if(m_write_queue.pop(write_queue))
+    {
+        for(auto &connection : write_queue)
+        {
+            connection->m_write_pending.exchange(false);
+            
+            if(!connection->m_closed.load(std::memory_order_relaxed))
+            {
+                do_write(connection);
+            }
+        }
+    }
+}
+
+template<typename T>
+void Poller_Task<T>::do_read()
+{
+    uint64 data = 0;
+    int32 num = read(m_read_event_fd, &data, sizeof(uint64));
+
+    if(num != sizeof(uint64))
+    {
+        LOG_FATAL("read m_read_event_fd failed in Poller_Task::do_read");
+        
+        return;
+    }
+    
+    std::vector<std::shared_ptr<Connection<T>>> read_queue;
+
+    if(m_read_queue.pop(read_queue))
+    {
+        m_local_read_queue.insert(m_local_read_queue.end(), read_queue.begin(), read_queue.end());
+    }
+}
+
+//edge triggered, a paused connection leaves the rest in the socket and resume_read picks it up
+template<typename T>
+void Poller_Task<T>::do_read(Connection<T> *connection)
+{
+    while(connection->m_read_pause.load(std::memory_order_relaxed) == 0)
+    {
+        Message_Chunk_Queue &recv_queue = connection->m_recv_msg_queue;
+        std::unique_ptr<Message_Chunk> message_chunk(m_chunk_pool->new_chunk(connection->m_recv_size_class));
+        const uint32 REQ_SIZE = message_chunk->size();
+        int32 num = read(connection->m_fd, message_chunk->write_ptr(), REQ_SIZE);
+
+        if(num < 0)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+        }
+        
+        if(num <= 0)
+        {
+            epoll_ctl(m_fd, EPOLL_CTL_DEL, connection->m_fd, NULL);
+            close(connection->m_fd);
+            connection->m_closed.store(true, std::memory_order_relaxed);
+            m_connection_num.fetch_sub(1, std::memory_order_relaxed);
+            m_connections.erase(connection);
+            connection->m_be_closed_cb(connection->shared_from_this());
+            connection->m_self.reset();
+
+            break;
+        }
+        
+        message_chunk->write_ptr(num);
+        connection->m_last_recv_ms = m_now_ms;
+        connection->m_recv_bytes += num;
+        recv_queue.push(message_chunk.release());
+        connection->parse();
+
+        //adapt the size class of the next read to what the peer actually sends
+        if((uint32)num == REQ_SIZE)
+        {
+            if(connection->m_recv_size_class < Message_Chunk_Pool::SIZE_CLASS_NUM - 1)
+            {
+                ++connection->m_recv_size_class;
+            }
+        }
+        else
+        {
+            if(connection->m_recv_size_class > 0 && (uint32)num <= m_chunk_pool->class_size(connection->m_recv_size_class - 1))
+            {
+                --connection->m_recv_size_class;
+            }
+            
+            break;
+        }
+    }
+}
+
+//resumed connections first parse what they buffered while paused, then read what the socket holds
+template<typename T>
+void Poller_Task<T>::do_local_read()
+{
+    while(!m_local_read_queue.empty())
+    {
+        std::vector<std::shared_ptr<Connection<T>>> read_queue;
+        read_queue.swap(m_local_read_queue);
+
+        for(auto &connection : read_queue)
+        {
+            if(connection->m_closed.load(std::memory_order_relaxed) || connection->m_read_pause.load(std::memory_order_relaxed) != 0)
+            {
+                continue;
+            }
+
+            if(connection->poller_task() != this)
+            {
+                connection->poller_task()->resume_read(connection);
+
+                continue;
+            }
+            
+            connection->parse();
+
+            if(m_uring)
+            {
+                uring_do_read(connection.get());
+            }
+            else
+            {
+                do_read(connection.get());
+            }
+        }
+    }
+}
+
+template<typename T>
+void Poller_Task<T>::do_local_write()
+{
+    //be_closed_cb of a failed flush may send on other connections, loop until nothing is left
+    while(!m_local_write_queue.empty())
+    {
+        std::vector<std::shared_ptr<Connection<T>>> write_queue;
+        write_queue.swap(m_local_write_queue);
+
+        for(auto &connection : write_queue)
+        {
+            connection->m_write_pending.exchange(false);
+
+            if(connection->m_closed.load(std::memory_order_relaxed))
+            {
+                continue;
+            }
+            
+            if(m_uring)
+            {
+                uring_do_write(connection.get());
+            }
+            else
+            {
+                do_write(connection);
+            }
+        }
+    }
+}
+
+template<typename T>
+void Poller_Task<T>::do_close()
+{
+    uint64 data = 0;
+    int32 num = read(m_close_event_fd, &data, sizeof(uint64));
+    
+    if(num != sizeof(uint64))
+    {
+        LOG_FATAL("read m_close_event_fd failed in Poller_Task::do_close");
+        
+        return;
+    }
+
+    std::vector<std::shared_ptr<Connection<T>>> close_queue;
+
+    if(m_close_queue.pop(close_queue))
+    {
+        for(auto &connection : close_queue)
+        {
+            if(connection->poller_task() != this)
+            {
+                connection->poller_task()->close_connection(connection);
+
+                continue;
+            }
+            
+            if(!connection->m_closed.load(std::memory_order_relaxed))
+            {
+                int32 fd = connection->m_fd;
+                int ret = epoll_ctl(m_fd, EPOLL_CTL_DEL, fd, NULL);
+
+                if(ret < 0)
+                {
+                    LOG_FATAL("epoll_ctl EPOLL_CTL_DEL failed in Poller_Task::do_close: %s", strerror(errno));
+                }
+                
+                close(fd);
+                connection->m_self.reset();
+                connection->m_closed.store(true, std::memory_order_relaxed);
+                m_connection_num.fetch_sub(1, std::memory_order_relaxed);
+                m_connections.erase(connection.get());
+                connection->m_close_cb(connection);
+            }
+        }
+    }
+}
+
+template<typename T>
+void Poller_Task<T>::run_in_loop()
+{
+    if(m_uring)
+    {
+        run_in_loop_uring();
+        
+        return;
+    }
+    
+    t_current_poller_task = this;
+    Message_Chunk_Pool::current(m_chunk_pool);
+    struct epoll_event events[2048];
+    bool spin = spinning();
+    int32 fd_num = epoll_wait(m_fd, events, 2048, spin ? 0 : m_timer_wheel.next_timeout(fly::base::monotonic_ms()));
+    m_now_ms = fly::base::monotonic_ms();
+    spin_done(spin, fd_num > 0);
+    
+    if(fd_num < 0)
+    {
+        LOG_DEBUG_ERROR("epoll_wait failed in Poller_Task::run_in_loop %s", strerror(errno));
+
+        return;
+    }
+
+    for(auto i = 0; i < fd_num; ++i)
+    {
+        if((events[i].data.u64 & 3) == 1)
+        {
+            do_accept(reinterpret_cast<Listener*>(events[i].data.u64 & ~(uint64)3));
+
+            continue;
+        }
+
+        if((events[i].data.u64 & 3) == 3)
+        {
+            on_connect_ready(reinterpret_cast<Pending_Connect*>(events[i].data.u64 & ~(uint64)3), 0);
+
+            continue;
+        }
+        
+        if((events[i].data.u64 & 3) == 2)
+        {
+            Udp_Socket<T> *udp_socket = reinterpret_cast<Udp_Socket<T>*>(events[i].data.u64 & ~(uint64)3);
+
+            if(!udp_socket->m_closed.load(std::memory_order_relaxed))
+            {
+                udp_socket->do_recv(false);
+            }
+
+            continue;
+        }
+        
+        Connection<T> *connection = static_cast<Connection<T>*>(events[i].data.ptr);
+        int32 fd = connection->m_fd;
+        uint32 event = events[i].events;
+
+        //EPOLLERR also reports zerocopy completions, only a real error closes the connection
+        if((event & EPOLLERR) && connection->m_zerocopy_threshold > 0 && !connection->m_closed.load(std::memory_order_relaxed))
+        {
+            if(zerocopy_done(connection))
+            {
+                event &= ~EPOLLERR;
+            }
+        }
+        
+        //the shutdown(SHUT_RD) of a drain reports EPOLLRDHUP, the connection stays until it's flushed
+        if(m_draining.load(std::memory_order_relaxed))
+        {
+            event &= ~EPOLLRDHUP;
+        }
+        
+        if(event & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+        {
+            if(connection->m_closed.load(std::memory_order_relaxed))
+            {
+                continue;
+            }
+
+            int ret = epoll_ctl(m_fd, EPOLL_CTL_DEL, fd, NULL);
+
+            if(ret < 0)
+            {
+                LOG_FATAL("epoll_ctl EPOLL_CTL_DEL failed in Poller_Task::run_in_loop: %s", strerror(errno));
+            }
+
+            close(fd);
+            connection->m_closed.store(true, std::memory_order_relaxed);
+            m_connection_num.fetch_sub(1, std::memory_order_relaxed);
+            m_connections.erase(connection);
+            connection->m_be_closed_cb(connection->shared_from_this());
+            connection->m_self.reset();
+        }
+        else if(event & EPOLLIN)
+        {
+            if(fd == m_close_event_fd)
+            {
+                do_close();
+            }
+            else if(fd == m_write_event_fd)
+            {
+                do_write();
+            }
+            else if(fd == m_timer_event_fd)
+            {
+                uint64 data = 0;
+                
+                if(read(m_timer_event_fd, &data, sizeof(uint64)) != sizeof(uint64))
+                {
+                    LOG_FATAL("read m_timer_event_fd failed in Poller_Task::run_in_loop");
+                }
+                
+                do_timer();
+            }
+            else if(fd == m_stop_event_fd)
+            {
+                uint64 data = 0;
+                
+                if(read(m_stop_event_fd, &data, sizeof(uint64)) != sizeof(uint64))
+                {
+                    LOG_FATAL("read m_stop_event_fd failed in Poller_Task::run_in_loop");
+                }
+
+                m_stop = true;
+            }
+            else if(fd == m_read_event_fd)
+            {
+                do_read();
+            }
+            else if(!connection->m_closed.load(std::memory_order_relaxed))
+            {
+                do_read(connection);
+            }
+        }
+
+        if(event & EPOLLOUT)
+        {
+            if(connection->m_closed.load(std::memory_order_relaxed))
+            {
+                continue;
+            }
+            
+            do_write(connection->shared_from_this());
+        }
+    }
+
+    m_timer_wheel.advance(m_now_ms);
+    do_local_read();
+    do_local_write();
+    do_register();
+
+    if(m_stop && !draining())
+    {
+        Loop_Task::stop();
+        close(m_fd);
+    }
+}
+
+//accept is driven by this poller's loop: multishot accept on the ring, batched accept4 on epoll
+//local means connections accepted here are registered to this poller without a cross-thread handoff
+template<typename T>
+bool Poller_Task<T>::listen(int32 listen_fd, std::function<void(std::shared_ptr<Connection<T>>)> cb, bool local)
+{
+    Listener *listener = new Listener;
+    listener->m_fd = listen_fd;
+    listener->m_local = local;
+    listener->m_cb = cb;
+    
+    if(m_uring)
+    {
+        m_listen_queue.push(listener);
+        uring_wake();
+
+        return true;
+    }
+
+    //level triggered, the low bits of data tell a listener (1), a udp socket (2) or a connect (3) from a connection
+    struct epoll_event event;
+    event.data.u64 = reinterpret_cast<uint64>(listener) | 1;
+    event.events = EPOLLIN;
+    m_listeners.emplace_back(listener);
+    
+    if(epoll_ctl(m_fd, EPOLL_CTL_ADD, listen_fd, &event) < 0)
+    {
+        LOG_FATAL("epoll_ctl failed in Poller_Task::listen: %s", strerror(errno));
+        m_listeners.pop_back();
+        
+        return false;
+    }
+    
+    return true;
+}
+
+//the socket is kept alive by its m_self until close_udp_socket is done with it
+template<typename T>
+void Poller_Task<T>::register_udp_socket(std::shared_ptr<Udp_Socket<T>> udp_socket)
+{
+    udp_socket->m_self = udp_socket;
+    run_after(0, std::bind(&Poller_Task::do_register_udp_socket, this, udp_socket));
+}
+
+template<typename T>
+void Poller_Task<T>::close_udp_socket(std::shared_ptr<Udp_Socket<T>> udp_socket)
+{
+    run_after(0, std::bind(&Poller_Task::do_close_udp_socket, this, udp_socket));
+}
+
+template<typename T>
+void Poller_Task<T>::do_register_udp_socket(std::shared_ptr<Udp_Socket<T>> udp_socket)
+{
+    if(m_uring)
+    {
+        Udp_Socket<T> *socket = udp_socket.get();
+        socket->m_uring_poll.m_cb = [this, socket](int32 res, uint32 flags) { uring_on_poll(socket, res, flags); };
+        m_uring->prep_poll(socket->m_fd, POLLIN, true, Uring::pack(&socket->m_uring_poll, URING_TAG_POLL));
+
+        return;
+    }
+    
+    struct epoll_event event;
+    event.data.u64 = reinterpret_cast<uint64>(udp_socket.get()) | 2;
+    event.events = EPOLLIN;
+
+    if(epoll_ctl(m_fd, EPOLL_CTL_ADD, udp_socket->m_fd, &event) < 0)
+    {
+        LOG_FATAL("epoll_ctl failed in Poller_Task::do_register_udp_socket: %s", strerror(errno));
+        udp_socket->m_closed.store(true, std::memory_order_relaxed);
+        udp_socket->m_self.reset();
+    }
+}
+
+//on the ring the fd is closed once the cancelled poll reported its last cqe, see uring_on_poll
+template<typename T>
+void Poller_Task<T>::do_close_udp_socket(std::shared_ptr<Udp_Socket<T>> udp_socket)
+{
+    if(m_uring)
+    {
+        m_uring->prep_cancel(Uring::pack(&udp_socket->m_uring_poll, URING_TAG_POLL), Uring::pack(nullptr, URING_TAG_IGNORE));
+
+        return;
+    }
+
+    epoll_ctl(m_fd, EPOLL_CTL_DEL, udp_socket->m_fd, NULL);
+    close(udp_socket->m_fd);
+    udp_socket->m_fd = -1;
+    udp_socket->m_self.reset();
+}
+
+//the ring only reports new data, so the socket is read until it's empty
+template<typename T>
+void Poller_Task<T>::uring_on_poll(Udp_Socket<T> *udp_socket, int32 res, uint32 flags)
+{
+    bool closed = udp_socket->m_closed.load(std::memory_order_relaxed);
+    
+    if(res > 0 && (res & POLLIN) && !closed)
+    {
+        udp_socket->do_recv(true);
+    }
+
+    if(flags & IORING_CQE_F_MORE)
+    {
+        return;
+    }
+
+    if(!closed)
+    {
+        m_uring->prep_poll(udp_socket->m_fd, POLLIN, true, Uring::pack(&udp_socket->m_uring_poll, URING_TAG_POLL));
+
+        return;
+    }
+    
+    close(udp_socket->m_fd);
+    udp_socket->m_fd = -1;
+    udp_socket->m_self.reset();
+}
+
+//fd has a nonblocking connect in progress, cb gets 0 or the errno once it's done, ETIMEDOUT if it isn't within
+//timeout_ms (0 waits as long as the kernel retries). cb runs on the poller thread and owns fd from then on
+template<typename T>
+void Poller_Task<T>::connect(int32 fd, uint32 timeout_ms, std::function<void(int32)> cb)
+{
+    Pending_Connect *pending = new Pending_Connect;
+    pending->m_fd = fd;
+    pending->m_cb = cb;
+    run_after(0, std::bind(&Poller_Task::do_connect, this, pending, timeout_ms));
+}
+
+template<typename T>
+void Poller_Task<T>::do_connect(Pending_Connect *pending, uint32 timeout_ms)
+{
+    if(timeout_ms > 0)
+    {
+        pending->m_timer_id = run_after(timeout_ms, std::bind(&Poller_Task::on_connect_timeout, this, pending));
+    }
+    
+    if(m_uring)
+    {
+        pending->m_uring_poll.m_cb = [this, pending](int32 res, uint32 flags) { on_connect_ready(pending, res); };
+        m_uring->prep_poll(pending->m_fd, POLLOUT, false, Uring::pack(&pending->m_uring_poll, URING_TAG_POLL));
+
+        return;
+    }
+    
+    struct epoll_event event;
+    event.data.u64 = reinterpret_cast<uint64>(pending) | 3;
+    event.events = EPOLLOUT;
+
+    if(epoll_ctl(m_fd, EPOLL_CTL_ADD, pending->m_fd, &event) < 0)
+    {
+        LOG_FATAL("epoll_ctl failed in Poller_Task::do_connect: %s", strerror(errno));
+        on_connect_ready(pending, -errno);
+    }
+}
+
+//writable or failed, SO_ERROR tells which. res < 0 is an error of the poll itself
+template<typename T>
+void Poller_Task<T>::on_connect_ready(Pending_Connect *pending, int32 res)
+{
+    //the poll of a timed out connect on the ring, cancelled or not, cb already got ETIMEDOUT
+    if(pending->m_timed_out)
+    {
+        delete pending;
+
+        return;
+    }
+    
+    if(pending->m_timer_id != 0)
+    {
+        cancel_timer(pending->m_timer_id);
+    }
+
+    if(!m_uring)
+    {
+        epoll_ctl(m_fd, EPOLL_CTL_DEL, pending->m_fd, NULL);
+    }
+    
+    int32 error = -res;
+
+    if(res >= 0)
+    {
+        socklen_t length = sizeof(error);
+
+        if(getsockopt(pending->m_fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+        {
+            error = errno;
+        }
+    }
+
+    std::function<void(int32)> cb = std::move(pending->m_cb);
+    delete pending;
+    cb(error);
+}
+
+//on the ring the poll has to report before pending can go, see on_connect_ready
+template<typename T>
+void Poller_Task<T>::on_connect_timeout(Pending_Connect *pending)
+{
+    std::function<void(int32)> cb = std::move(pending->m_cb);
+
+    if(m_uring)
+    {
+        pending->m_timed_out = true;
+        m_uring->prep_cancel(Uring::pack(&pending->m_uring_poll, URING_TAG_POLL), Uring::pack(nullptr, URING_TAG_IGNORE));
+    }
+    else
+    {
+        epoll_ctl(m_fd, EPOLL_CTL_DEL, pending->m_fd, NULL);
+        delete pending;
+    }
+
+    cb(ETIMEDOUT);
+}
+
+template<typename T>
+void Poller_Task<T>::do_accept(Listener *listener)
+{
+    //bounded so that a connect storm can't starve the established connections
+    const uint32 ACCEPT_BATCH = 256;
+    
+    for(uint32 i = 0; i < ACCEPT_BATCH; ++i)
+    {
+        struct sockaddr_storage client_addr;
+        socklen_t length = sizeof(client_addr);
+        int32 client_fd = accept4(listener->m_fd, (sockaddr*)&client_addr, &length, SOCK_NONBLOCK);
+
+        if(client_fd >= 0)
+        {
+            new_connection(listener, client_fd, Addr((sockaddr*)&client_addr, length));
+
+            continue;
+        }
+        
+        if(errno == EINTR || errno == ECONNABORTED)
+        {
+            continue;
+        }
+        
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+
+        LOG_DEBUG_FATAL("accept4 failed in Poller_Task::do_accept: %s", strerror(errno));
+
+        //the listen fd is shut down or broken, stop accepting on it
+        //out of fds etc. are retried on the next round since the listen fd is level triggered
+        if(errno == EINVAL || errno == EBADF || errno == ENOTSOCK)
+        {
+            epoll_ctl(m_fd, EPOLL_CTL_DEL, listener->m_fd, NULL);
+        }
+
+        break;
+    }
+}
+
+template<typename T>
+void Poller_Task<T>::new_connection(Listener *listener, int32 fd, const Addr &peer_addr)
+{
+    LOG_DEBUG_INFO("new connection from %s arrived", peer_addr.to_string().c_str());
+    std::shared_ptr<Connection<T>> connection = std::make_shared<Connection<T>>(fd, peer_addr);
+
+    if(listener->m_local)
+    {
+        connection->m_poller_task = this;
+    }
+    
+    listener->m_cb(connection);
+}
+
+//same thread: handled at the end of the current batch; other ring: IORING_OP_MSG_RING; others: eventfd
+template<typename T>
+void Poller_Task<T>::uring_wake()
+{
+    //nobody reaps the ring any more, what is queued stays there
+    if(m_uring_stopped.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    
+    Uring *current = Uring::current();
+
+    if(current == m_uring.get())
+    {
+        m_uring_has_cmds = true;
+
+        return;
+    }
+
+    if(current != nullptr)
+    {
+        current->prep_msg_ring(m_uring->fd(), Uring::pack(nullptr, URING_TAG_WAKE), Uring::pack(nullptr, URING_TAG_IGNORE));
+
+        return;
+    }
+    
+    uint64 data = 1;
+    int32 num = write(m_wake_event_fd, &data, sizeof(uint64));
+    
+    if(num != sizeof(uint64))
+    {
+        LOG_FATAL("write m_wake_event_fd failed in Poller_Task::uring_wake");
+    }
+}
+
+template<typename T>
+void Poller_Task<T>::uring_do_cmds()
+{
+    std::vector<Listener*> listen_queue;
+
+    if(m_listen_queue.pop(listen_queue))
+    {
+        for(auto *listener : listen_queue)
+        {
+            m_listeners.emplace_back(listener);
+            m_uring->prep_accept_multishot(listener->m_fd, Uring::pack(listener, URING_TAG_ACCEPT));
+        }
+    }
+    
+    std::vector<std::shared_ptr<Connection<T>>> queue;
+    
+    if(m_register_queue.pop(queue))
+    {
+        for(auto &connection : queue)
+        {
+            if(!connection->m_closed.load(std::memory_order_relaxed))
+            {
+                m_connections.insert(connection.get());
+
+                if(m_draining.load(std::memory_order_relaxed))
+                {
+                    connection->drain();
+                }
+
+                //a migrated connection may come paused and with chunks left to send
+                if(connection->m_read_pause.load(std::memory_order_relaxed) != 0)
+                {
+                    connection->m_uring_ctx->m_recv_stopped = true;
+                }
+                else
+                {
+                    m_uring->prep_recv_multishot(connection->m_fd, Uring::pack(connection.get(), URING_TAG_RECV));
+                    ++connection->m_uring_ctx->m_pending_ops;
+                }
+
+                uring_do_write(connection.get());
+            }
+        }
+
+        queue.clear();
+    }
+
+    m_write_signaled.exchange(false);
+
+    if(m_write_queue.pop(queue))
+    {
+        for(auto &connection : queue)
+        {
+            connection->m_write_pending.exchange(false);
+            uring_do_write(connection.get());
+        }
+
+        queue.clear();
+    }
+
+    if(m_read_queue.pop(queue))
+    {
+        m_local_read_queue.insert(m_local_read_queue.end(), queue.begin(), queue.end());
+        queue.clear();
+    }
+
+    if(m_close_queue.pop(queue))
+    {
+        for(auto &connection : queue)
+        {
+            uring_do_close(connection.get(), false);
+        }
+    }
+
+    do_timer();
+}
+
+template<typename T>
+void Poller_Task<T>::uring_do_write(Connection<T> *connection)
+{
+    Uring_Context *ctx = connection->m_uring_ctx.get();
+
+    if(connection->m_closed.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    //migrated away after this write was queued here
+    if(connection->poller_task() != this)
+    {
+        connection->poller_task()->write_connection(connection->shared_from_this());
+
+        return;
+    }
+
+    //only one send in flight per connection, the next one is issued by its completion.
+    //a migrating one is issued by the target ring after the hand over
+    if(ctx->m_sending || migrate_target(connection) != nullptr)
+    {
+        return;
+    }
+
+    Message_Chunk *message_chunks[IOV_MAX];
+    uint32 count = connection->m_send_msg_queue.pop(message_chunks, IOV_MAX);
+
+    if(count == 0)
+    {
+        return;
+    }
+
+    //no sendfile on the ring, a file chunk is copied through a pooled buffer a slice at a time
+    uint32 file_idx = 0;
+
+    while(file_idx < count && message_chunks[file_idx]->file_fd() < 0)
+    {
+        ++file_idx;
+    }
+
+    if(file_idx > 0 && file_idx < count)
+    {
+        connection->m_send_msg_queue.push_front(message_chunks + file_idx, count - file_idx);
+        count = file_idx;
+    }
+    else if(file_idx == 0)
+    {
+        connection->m_send_msg_queue.push_front(message_chunks + 1, count - 1);
+        Message_Chunk *file_chunk = message_chunks[0];
+        Message_Chunk *message_chunk = m_chunk_pool->new_chunk(Message_Chunk_Pool::SIZE_CLASS_NUM - 1);
+        uint32 size = std::min(file_chunk->length(), message_chunk->size());
+        ssize_t num = pread(file_chunk->file_fd(), message_chunk->read_ptr(), size, file_chunk->file_offset());
+
+        if(num <= 0)
+        {
+            LOG_ERROR("pread failed in Poller_Task::uring_do_write: %s", num < 0 ? strerror(errno) : "file truncated");
+            delete file_chunk;
+            delete message_chunk;
+            uring_do_close(connection, true);
+
+            return;
+        }
+
+        message_chunk->write_ptr(num);
+        file_chunk->read_ptr(num);
+
+        if(file_chunk->length() > 0)
+        {
+            connection->m_send_msg_queue.push_front(file_chunk);
+        }
+        else
+        {
+            delete file_chunk;
+        }
+
+        message_chunks[0] = message_chunk;
+        count = 1;
+    }
+
+    ctx->m_send_chunks.assign(message_chunks, message_chunks + count);
+    ctx->m_send_iov.resize(count);
+
+    for(uint32 i = 0; i < count; ++i)
+    {
+        ctx->m_send_iov[i].iov_base = message_chunks[i]->read_ptr();
+        ctx->m_send_iov[i].iov_len = message_chunks[i]->length();
+    }
+
+    m_uring->prep_writev(connection->m_fd, ctx->m_send_iov.data(), count, Uring::pack(connection, URING_TAG_SEND));
+    ctx->m_sending = true;
+    ++ctx->m_pending_ops;
+}
+
+template<typename T>
+void Poller_Task<T>::uring_do_close(Connection<T> *connection, bool be_closed)
+{
+    if(connection->m_closed.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    if(connection->poller_task() != this)
+    {
+        connection->poller_task()->close_connection(connection->shared_from_this());
+
+        return;
+    }
+    
+    m_migrating.erase(connection);
+
+    Uring_Context *ctx = connection->m_uring_ctx.get();
+    m_uring->prep_cancel(Uring::pack(connection, URING_TAG_RECV), Uring::pack(nullptr, URING_TAG_IGNORE));
+
+    if(ctx->m_sending)
+    {
+        m_uring->prep_cancel(Uring::pack(connection, URING_TAG_SEND), Uring::pack(nullptr, URING_TAG_IGNORE));
+    }
+    
+    close(connection->m_fd);
+    connection->m_closed.store(true, std::memory_order_relaxed);
+    m_connection_num.fetch_sub(1, std::memory_order_relaxed);
+    m_connections.erase(connection);
+
+    if(be_closed)
+    {
+        connection->m_be_closed_cb(connection->shared_from_this());
+    }
+    else
+    {
+        connection->m_close_cb(connection->shared_from_this());
+    }
+    
+    uring_release(connection);
+}
+
+//drop the self reference once the kernel no longer holds any request of this connection
+template<typename T>
+void Poller_Task<T>::uring_release(Connection<T> *connection)
+{
+    if(connection->m_uring_ctx->m_pending_ops == 0)
+    {
+        connection->m_self.reset();
+    }
+}
+
+template<typename T>
+void Poller_Task<T>::uring_on_recv(Connection<T> *connection, int32 res, uint32 flags)
+{
+    Uring_Context *ctx = connection->m_uring_ctx.get();
+    bool more = flags & IORING_CQE_F_MORE;
+
+    if(!more)
+    {
+        --ctx->m_pending_ops;
+    }
+
+    if(flags & IORING_CQE_F_BUFFER)
+    {
+        uint16 bid = flags >> IORING_CQE_BUFFER_SHIFT;
+
+        if(res > 0 && !connection->m_closed.load(std::memory_order_relaxed))
+        {
+            Message_Chunk *message_chunk = m_chunk_pool->new_chunk(m_chunk_pool->size_class(res));
+            memcpy(message_chunk->write_ptr(), m_uring->buf(bid), res);
+            message_chunk->write_ptr(res);
+            connection->m_last_recv_ms = m_now_ms;
+            connection->m_recv_bytes += res;
+            connection->m_recv_msg_queue.push(message_chunk);
+            m_uring->recycle_buf(bid);
+            connection->parse();
+        }
+        else
+        {
+            m_uring->recycle_buf(bid);
+        }
+    }
+
+    if(connection->m_closed.load(std::memory_order_relaxed))
+    {
+        uring_release(connection);
+
+        return;
+    }
+
+    //the recv is re-armed by the target ring, a peer close or an error shows up there again
+    if(migrate_target(connection) != nullptr)
+    {
+        if(!more)
+        {
+            uring_migrate(connection);
+        }
+
+        return;
+    }
+    
+    //the multishot recv was cancelled because reading got paused, or ended by the shutdown(SHUT_RD) of a drain
+    if(!more && ((res == -ECANCELED && ctx->m_recv_cancelling) || (res == 0 && m_draining.load(std::memory_order_relaxed))))
+    {
+        res = -ENOBUFS;
+    }
+    
+    //0 means the peer closed, -ENOBUFS only means the provided buffers ran out for a moment
+    if(res == 0 || (res < 0 && res != -ENOBUFS))
+    {
+        uring_do_close(connection, true);
+
+        return;
+    }
+
+    bool paused = connection->m_read_pause.load(std::memory_order_relaxed) != 0;
+    
+    if(!more)
+    {
+        ctx->m_recv_cancelling = false;
+
+        //stays unarmed until resume_read, the kernel buffers and the tcp window push back on the peer
+        if(paused)
+        {
+            ctx->m_recv_stopped = true;
+
+            return;
+        }
+        
+        m_uring->prep_recv_multishot(connection->m_fd, Uring::pack(connection, URING_TAG_RECV));
+        ++ctx->m_pending_ops;
+    }
+    else if(paused && !ctx->m_recv_cancelling)
+    {
+        m_uring->prep_cancel(Uring::pack(connection, URING_TAG_RECV), Uring::pack(nullptr, URING_TAG_IGNORE));
+        ctx->m_recv_cancelling = true;
+    }
+}
+
+//re-arms the recv stopped by a pause, a cancel still in flight re-arms it on its completion instead
+template<typename T>
+void Poller_Task<T>::uring_do_read(Connection<T> *connection)
+{
+    Uring_Context *ctx = connection->m_uring_ctx.get();
+
+    if(!ctx->m_recv_stopped || migrate_target(connection) != nullptr)
+    {
+        return;
+    }
+
+    ctx->m_recv_stopped = false;
+    m_uring->prep_recv_multishot(connection->m_fd, Uring::pack(connection, URING_TAG_RECV));
+    ++ctx->m_pending_ops;
+}
+
+template<typename T>
+void Poller_Task<T>::uring_on_send(Connection<T> *connection, int32 res)
+{
+    Uring_Context *ctx = connection->m_uring_ctx.get();
+    --ctx->m_pending_ops;
+    ctx->m_sending = false;
+
+    if(connection->m_closed.load(std::memory_order_relaxed) || res <= 0)
+    {
+        for(auto *message_chunk : ctx->m_send_chunks)
+        {
+            delete message_chunk;
+        }
+
+        ctx->m_send_chunks.clear();
+
+        if(connection->m_closed.load(std::memory_order_relaxed))
+        {
+            uring_release(connection);
+        }
+        else
+        {
+            LOG_DEBUG_ERROR("uring writev failed in Poller_Task::uring_on_send: %s", strerror(-res));
+            uring_do_close(connection, true);
+        }
+        
+        return;
+    }
+
+    write_done(connection->m_send_msg_queue, ctx->m_send_chunks.data(), ctx->m_send_chunks.size(), res);
+    ctx->m_send_chunks.clear();
+    check_drain(connection);
+
+    if(migrate_target(connection) != nullptr)
+    {
+        uring_migrate(connection);
+
+        return;
+    }
+    
+    uring_do_write(connection);
+}
+
+template<typename T>
+void Poller_Task<T>::uring_on_accept(Listener *listener, int32 res, uint32 flags)
+{
+    if(res < 0)
+    {
+        LOG_DEBUG_FATAL("uring accept return < 0: %s", strerror(-res));
+
+        //the listen fd is shut down or broken, stop accepting on it
+        if(!(flags & IORING_CQE_F_MORE))
+        {
+            m_listeners.remove_if([listener](const std::unique_ptr<Listener> &item) { return item.get() == listener; });
+        }
+        
+        return;
+    }
+
+    if(!(flags & IORING_CQE_F_MORE))
+    {
+        m_uring->prep_accept_multishot(listener->m_fd, Uring::pack(listener, URING_TAG_ACCEPT));
+    }
+
+    struct sockaddr_storage client_addr;
+    socklen_t length = sizeof(client_addr);
+    getpeername(res, (sockaddr*)&client_addr, &length);
+    new_connection(listener, res, Addr((sockaddr*)&client_addr, length));
+}
+
+template<typename T>
+void Poller_Task<T>::run_in_loop_uring()
+{
+    Uring::current(m_uring.get());
+    t_current_poller_task = this;
+    Message_Chunk_Pool::current(m_chunk_pool);
+    int32 timeout = m_timer_wheel.next_timeout(fly::base::monotonic_ms());
+    bool spin = spinning();
+
+    //a timeout sqe wakes the ring up for the timer wheel, re-armed only when the next timer is earlier
+    if(timeout >= 0 && !m_uring_has_cmds && !spin)
+    {
+        uint64 expire_ms = fly::base::monotonic_ms() + timeout;
+
+        if(m_uring_timeout_ms == 0 || expire_ms < m_uring_timeout_ms)
+        {
+            m_uring_timeout_ms = expire_ms;
+            m_uring_timeout.tv_sec = timeout / 1000;
+            m_uring_timeout.tv_nsec = (timeout % 1000) * 1000000;
+            m_uring->prep_timeout(&m_uring_timeout, Uring::pack(nullptr, URING_TAG_TIMEOUT));
+        }
+    }
+    
+    //all the sqes prepared during the last batch are submitted here with a single syscall,
+    //a spinning loop only peeks the completion ring, no syscall if there is nothing to submit.
+    //EBUSY means the cq overflowed, reaping it below lets the next submit through
+    if(m_uring->submit_and_wait(m_uring_has_cmds || spin ? 0 : 1) < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+    {
+        return;
+    }
+
+    m_now_ms = fly::base::monotonic_ms();
+    bool active = false;
+
+    while(struct io_uring_cqe *cqe = m_uring->peek_cqe())
+    {
+        uint64 user_data = cqe->user_data;
+        int32 res = cqe->res;
+        uint32 flags = cqe->flags;
+        m_uring->cqe_seen();
+        active = true;
+        void *ptr = Uring::unpack_ptr(user_data);
+        
+        switch(Uring::unpack_tag(user_data))
+        {
+        case URING_TAG_RECV:
+            uring_on_recv(static_cast<Connection<T>*>(ptr), res, flags);
+            break;
+        case URING_TAG_SEND:
+            uring_on_send(static_cast<Connection<T>*>(ptr), res);
+            break;
+        case URING_TAG_ACCEPT:
+            uring_on_accept(static_cast<Listener*>(ptr), res, flags);
+            break;
+        case URING_TAG_POLL:
+            static_cast<Uring_Poll*>(ptr)->m_cb(res, flags);
+            break;
+        case URING_TAG_EVENTFD:
+            m_uring->prep_read(m_wake_event_fd, &m_wake_data, sizeof(uint64), Uring::pack(nullptr, URING_TAG_EVENTFD));
+            m_uring_has_cmds = true;
+            break;
+        case URING_TAG_WAKE:
+            m_uring_has_cmds = true;
+            break;
+        case URING_TAG_TIMEOUT:
+            m_uring_timeout_ms = 0;
+            break;
+        default:
+            break;
+        }
+    }
+
+    spin_done(spin, active);
+
+    while(m_uring_has_cmds)
+    {
+        m_uring_has_cmds = false;
+        uring_do_cmds();
+    }
+
+    m_timer_wheel.advance(m_now_ms);
+    do_local_read();
+    do_local_write();
+
+    if(m_uring_stop.load(std::memory_order_relaxed) && !draining())
+    {
+        //the ring and the eventfd live on until ~Poller_Task, other threads may still be waking the task
+        Loop_Task::stop();
+        Uring::current(nullptr);
+        m_uring_stopped.store(true, std::memory_order_release);
     }
 }
 
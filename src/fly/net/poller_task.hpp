@@ -22,37 +22,227 @@
 #ifndef FLY__NET__POLLER_TASK
 #define FLY__NET__POLLER_TASK
 
+#include <list>
+#include <unordered_set>
+#include <unordered_map>
 #include "fly/task/loop_task.hpp"
 #include "fly/net/connection.hpp"
-#include "fly/base/lock_queue.hpp"
+#include "fly/net/message_chunk_pool.hpp"
+#include "fly/net/uring.hpp"
+#include "fly/net/placement_policy.hpp"
+#include "fly/base/mpsc_queue.hpp"
+#include "fly/base/timer_wheel.hpp"
 
 namespace fly {
 namespace net {
 
+enum POLLER_BACKEND
+{
+    POLLER_EPOLL,
+    POLLER_URING
+};
+
+//progress of a stop(drain_timeout_ms), refreshed every few ms while it runs
+//m_dropped_num are the connections still unflushed when the timeout passed
+struct Drain_Progress
+{
+    bool m_draining = false;
+    bool m_done = false;
+    uint32 m_connection_num = 0;
+    uint64 m_pending_bytes = 0;
+    uint32 m_dropped_num = 0;
+};
+
+template<typename T>
+class Udp_Socket;
+
 template<typename T>
 class Poller_Task : public fly::task::Loop_Task
 {
+    friend class Connection<T>;
+    
 public:
-    Poller_Task(uint64 seq);
+    Poller_Task(uint64 seq, POLLER_BACKEND backend = POLLER_EPOLL);
+    ~Poller_Task();
     bool register_connection(std::shared_ptr<Connection<T>> connection);
+    bool listen(int32 listen_fd, std::function<void(std::shared_ptr<Connection<T>>)> cb, bool local = false);
     virtual void run_in_loop() override;
     void close_connection(std::shared_ptr<Connection<T>> connection);
     void write_connection(std::shared_ptr<Connection<T>> connection);
-    void stop();
+    void stop(uint32 drain_timeout_ms = 0);
+    Drain_Progress drain_progress();
+    POLLER_BACKEND backend();
+    Message_Chunk_Pool* chunk_pool();
+    uint64 flush_count();
+    uint64 flush_iovec_count();
+    uint64 flush_bytes();
+    uint64 copy_bytes();
+    uint64 zerocopy_bytes();
+    uint64 zerocopy_copied_count();
+    uint64 sendfile_bytes();
+    uint64 send_count();
+    uint64 write_wakeup_count();
+    Poller_Load load();
+    void set_spin(uint32 spin_us, uint32 spin_polls = 0, uint32 busy_poll_us = 0);
+    uint64 spin_count();
+    uint64 sleep_count();
+    uint64 run_after(uint32 delay_ms, std::function<void()> cb);
+    uint64 run_every(uint32 interval_ms, std::function<void()> cb);
+    void cancel_timer(uint64 timer_id);
+    void resume_read(std::shared_ptr<Connection<T>> connection);
+    bool migrate(std::shared_ptr<Connection<T>> connection, Poller_Task<T> *target);
+    void shed(Poller_Task<T> *target, uint32 permille);
+    uint64 migrate_count();
+    void set_peer_rate_table(std::shared_ptr<Peer_Rate_Table> peer_rate_table);
+    uint64 rate_delay_count();
+    uint64 rate_drop_count();
+    uint64 rate_close_count();
+    void register_udp_socket(std::shared_ptr<Udp_Socket<T>> udp_socket);
+    void close_udp_socket(std::shared_ptr<Udp_Socket<T>> udp_socket);
+    void connect(int32 fd, uint32 timeout_ms, std::function<void(int32)> cb);
     
 private:
+    struct Listener
+    {
+        int32 m_fd;
+        bool m_local;
+        std::function<void(std::shared_ptr<Connection<T>>)> m_cb;
+    };
+
+    struct Pending_Connect
+    {
+        int32 m_fd;
+        uint64 m_timer_id = 0;
+        bool m_timed_out = false;
+        Uring_Poll m_uring_poll;
+        std::function<void(int32)> m_cb;
+    };
+    
+    struct Timer_Cmd
+    {
+        uint64 m_id;
+        uint32 m_delay_ms;
+        uint32 m_interval_ms;
+        std::function<void()> m_cb;
+    };
+    
     void do_close();
+    void do_register();
+    void do_migrate(std::shared_ptr<Connection<T>> connection, Poller_Task<T> *target);
+    Poller_Task<T>* migrate_target(Connection<T> *connection);
+    void uring_migrate(Connection<T> *connection);
+    void hand_over(std::shared_ptr<Connection<T>> connection, Poller_Task<T> *target);
+    void adopt(std::shared_ptr<Connection<T>> connection);
+    void do_shed(Poller_Task<T> *target, uint32 permille);
+    bool draining();
+    void begin_drain(uint32 drain_timeout_ms);
+    void drain_step();
+    void do_timer();
+    void sample_load();
+    bool spinning();
+    void spin_done(bool spin, bool active);
+    void add_timer(uint64 id, uint32 delay_ms, uint32 interval_ms, std::function<void()> cb);
+    void watch_idle(std::shared_ptr<Connection<T>> connection, uint32 gen, uint32 timeout_ms, uint32 delay_ms);
+    void watch_heartbeat(std::shared_ptr<Connection<T>> connection, uint32 gen, uint32 interval_ms,
+                         std::function<void(std::shared_ptr<Connection<T>>)> cb, uint32 delay_ms);
+    void do_accept(Listener *listener);
+    void do_register_udp_socket(std::shared_ptr<Udp_Socket<T>> udp_socket);
+    void do_close_udp_socket(std::shared_ptr<Udp_Socket<T>> udp_socket);
+    void uring_on_poll(Udp_Socket<T> *udp_socket, int32 res, uint32 flags);
+    void do_connect(Pending_Connect *pending, uint32 timeout_ms);
+    void on_connect_ready(Pending_Connect *pending, int32 res);
+    void on_connect_timeout(Pending_Connect *pending);
+    void new_connection(Listener *listener, int32 fd, const Addr &peer_addr);
+    void do_read();
+    void do_read(Connection<T> *connection);
+    void do_local_read();
     void do_write();
     void do_write(std::shared_ptr<Connection<T>> connection);
-    int32 m_fd;
-    int32 m_close_event_fd;
-    int32 m_write_event_fd;
-    int32 m_stop_event_fd;
+    void do_local_write();
+    void check_drain(Connection<T> *connection);
+    bool is_special_chunk(Connection<T> *connection, Message_Chunk *message_chunk);
+    int32 send_file_chunk(Connection<T> *connection, Message_Chunk *message_chunk);
+    int32 send_zerocopy(Connection<T> *connection, Message_Chunk *message_chunk, struct iovec *iov);
+    bool zerocopy_done(Connection<T> *connection);
+    bool write_done(Message_Chunk_Queue &send_queue, Message_Chunk **message_chunks, uint32 count, uint32 num);
+    bool init_uring();
+    void run_in_loop_uring();
+    void uring_wake();
+    void uring_do_cmds();
+    void uring_do_read(Connection<T> *connection);
+    void uring_do_write(Connection<T> *connection);
+    void uring_do_close(Connection<T> *connection, bool be_closed);
+    void uring_release(Connection<T> *connection);
+    void uring_on_recv(Connection<T> *connection, int32 res, uint32 flags);
+    void uring_on_send(Connection<T> *connection, int32 res);
+    void uring_on_accept(Listener *listener, int32 res, uint32 flags);
+    int32 m_fd = -1;
+    int32 m_close_event_fd = -1;
+    int32 m_write_event_fd = -1;
+    int32 m_stop_event_fd = -1;
+    int32 m_timer_event_fd = -1;
+    int32 m_read_event_fd = -1;
+    POLLER_BACKEND m_backend;
+    std::unique_ptr<Uring> m_uring;
+    int32 m_wake_event_fd = -1;
+    uint64 m_wake_data = 0;
+    bool m_uring_has_cmds = false;
+    std::atomic<bool> m_uring_stop {false};
+    std::atomic<bool> m_uring_stopped {false};
+    std::list<std::unique_ptr<Listener>> m_listeners;
+    std::unordered_set<Connection<T>*> m_connections;
+    std::unordered_map<Connection<T>*, Poller_Task<T>*> m_migrating;
+    std::atomic<uint64> m_migrate_count {0};
+    fly::base::MPSC_Queue<std::shared_ptr<Connection<T>>> m_register_queue;
+    fly::base::MPSC_Queue<Listener*> m_listen_queue;
     std::unique_ptr<Connection<T>> m_close_udata;
     std::unique_ptr<Connection<T>> m_write_udata;
     std::unique_ptr<Connection<T>> m_stop_udata;
-    fly::base::Lock_Queue<std::shared_ptr<Connection<T>>> m_close_queue;
-    fly::base::Lock_Queue<std::shared_ptr<Connection<T>>> m_write_queue;
+    std::unique_ptr<Connection<T>> m_timer_udata;
+    std::unique_ptr<Connection<T>> m_read_udata;
+    fly::base::Timer_Wheel m_timer_wheel;
+    fly::base::ID_Allocator m_timer_id_allocator;
+    fly::base::MPSC_Queue<std::unique_ptr<Timer_Cmd>> m_timer_queue;
+    uint64 m_now_ms = 0;
+    uint64 m_uring_timeout_ms = 0;
+    struct __kernel_timespec m_uring_timeout;
+    Message_Chunk_Pool *m_chunk_pool;
+    std::atomic<uint64> m_flush_count {0};
+    std::atomic<uint64> m_flush_iovec_count {0};
+    std::atomic<uint64> m_flush_bytes {0};
+    std::atomic<uint64> m_zerocopy_bytes {0};
+    std::atomic<uint64> m_zerocopy_copied_count {0};
+    std::atomic<uint64> m_sendfile_bytes {0};
+    std::atomic<uint64> m_send_count {0};
+    std::atomic<uint64> m_write_wakeup_count {0};
+    std::atomic<bool> m_write_signaled {false};
+    std::atomic<uint32> m_connection_num {0};
+    std::atomic<uint64> m_cpu_us {0};
+    std::atomic<uint64> m_recent_cpu_us {0};
+    std::atomic<uint32> m_spin_us {0};
+    std::atomic<uint32> m_spin_polls {0};
+    std::atomic<uint32> m_busy_poll_us {0};
+    std::atomic<uint64> m_spin_count {0};
+    std::atomic<uint64> m_sleep_count {0};
+    std::shared_ptr<Peer_Rate_Table> m_peer_rate_table;
+    std::atomic<uint64> m_rate_delay_count {0};
+    std::atomic<uint64> m_rate_drop_count {0};
+    std::atomic<uint64> m_rate_close_count {0};
+    uint64 m_last_active_us = 0;
+    bool m_stop = false;
+    std::atomic<uint32> m_drain_timeout_ms {0};
+    std::atomic<bool> m_draining {false};
+    std::atomic<bool> m_drain_done {false};
+    uint64 m_drain_deadline_ms = 0;
+    std::atomic<uint32> m_drain_connection_num {0};
+    std::atomic<uint64> m_drain_pending_bytes {0};
+    std::atomic<uint32> m_drain_dropped_num {0};
+    uint32 m_idle_polls = 0;
+    fly::base::MPSC_Queue<std::shared_ptr<Connection<T>>> m_close_queue;
+    fly::base::MPSC_Queue<std::shared_ptr<Connection<T>>> m_write_queue;
+    std::vector<std::shared_ptr<Connection<T>>> m_local_write_queue;
+    fly::base::MPSC_Queue<std::shared_ptr<Connection<T>>> m_read_queue;
+    std::vector<std::shared_ptr<Connection<T>>> m_local_read_queue;
 };
 
 }
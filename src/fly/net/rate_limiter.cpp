@@ -0,0 +1,276 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 09:31:05                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <algorithm>
+#include <functional>
+#include "fly/net/rate_limiter.hpp"
+
+namespace fly {
+namespace net {
+
+static const uint64 NS_PER_SEC = 1000000000;
+static const uint64 EMPTY_KEY = 0;
+static const uint64 TOMBSTONE_KEY = 1;
+static const uint64 CLAIMING_KEY = 2;
+static const uint32 MAX_PROBE = 16;
+static const uint64 PEER_IDLE_MS = 60000;
+
+//tokens * 1e9 / rate without overflowing for large bursts
+static uint64 tokens_ns(uint64 tokens, uint64 rate)
+{
+    return tokens / rate * NS_PER_SEC + tokens % rate * NS_PER_SEC / rate;
+}
+
+Rate_Limiter::Rate_Limiter(const Rate_Limit &limit)
+{
+    m_limit = limit;
+
+    if(m_limit.m_msgs_per_sec > 0)
+    {
+        m_msg_cost_ns = tokens_ns(1, m_limit.m_msgs_per_sec);
+        m_msg_burst_ns = tokens_ns(m_limit.m_msg_burst > 0 ? m_limit.m_msg_burst : m_limit.m_msgs_per_sec, m_limit.m_msgs_per_sec);
+    }
+
+    if(m_limit.m_bytes_per_sec > 0)
+    {
+        m_byte_burst_ns = tokens_ns(m_limit.m_byte_burst > 0 ? m_limit.m_byte_burst : m_limit.m_bytes_per_sec, m_limit.m_bytes_per_sec);
+    }
+}
+
+//0 if a message of length bytes fits both buckets, otherwise the ns until it would fit
+//a rejected message takes nothing from either bucket
+uint64 Rate_Limiter::admit(Rate_Buckets &buckets, uint32 length, uint64 now_ns) const
+{
+    if(m_limit.m_msgs_per_sec > 0)
+    {
+        uint64 wait_ns = buckets.m_msgs.consume(m_msg_cost_ns, m_msg_burst_ns, now_ns);
+
+        if(wait_ns > 0)
+        {
+            return wait_ns;
+        }
+    }
+
+    if(m_limit.m_bytes_per_sec > 0)
+    {
+        uint64 wait_ns = buckets.m_bytes.consume(tokens_ns(length, m_limit.m_bytes_per_sec), m_byte_burst_ns, now_ns);
+
+        if(wait_ns > 0)
+        {
+            if(m_limit.m_msgs_per_sec > 0)
+            {
+                buckets.m_msgs.refund(m_msg_cost_ns);
+            }
+
+            return wait_ns;
+        }
+    }
+
+    return 0;
+}
+
+//gives back what an admitted message took, when another limit rejected it
+void Rate_Limiter::refund(Rate_Buckets &buckets, uint32 length) const
+{
+    if(m_limit.m_msgs_per_sec > 0)
+    {
+        buckets.m_msgs.refund(m_msg_cost_ns);
+    }
+
+    if(m_limit.m_bytes_per_sec > 0)
+    {
+        buckets.m_bytes.refund(tokens_ns(length, m_limit.m_bytes_per_sec));
+    }
+}
+
+RATE_LIMIT_ACTION Rate_Limiter::action() const
+{
+    return m_limit.m_action;
+}
+
+//how long empty buckets take to fill up again
+uint64 Rate_Limiter::refill_ms() const
+{
+    return std::max(m_msg_burst_ns, m_byte_burst_ns) / 1000000 + 1;
+}
+
+bool Rate_Limiter::enabled() const
+{
+    return m_limit.m_msgs_per_sec > 0 || m_limit.m_bytes_per_sec > 0;
+}
+
+Peer_Rate_Table::Peer_Rate_Table(const Rate_Limit &limit, uint32 capacity) : m_limiter(limit)
+{
+    m_capacity = MAX_PROBE;
+
+    while(m_capacity < capacity)
+    {
+        m_capacity <<= 1;
+    }
+
+    m_entries.reset(new Entry[m_capacity]);
+    m_idle_ms = std::max(PEER_IDLE_MS, m_limiter.refill_ms());
+}
+
+uint64 Peer_Rate_Table::key(const Addr &addr)
+{
+    uint64 key = addr.host_hash();
+
+    //0, 1 and 2 mark empty, expired and half claimed slots
+    return key <= CLAIMING_KEY ? key + 3 : key;
+}
+
+//the buckets of the peer, inserted on first use. nullptr if its probe window is full, the peer isn't limited then
+Rate_Buckets* Peer_Rate_Table::find(uint64 key, uint64 now_ms)
+{
+    uint32 mask = m_capacity - 1;
+    uint32 start = (key ^ (key >> 32)) & mask;
+
+    while(true)
+    {
+        Entry *free_entry = nullptr;
+        uint64 free_key = EMPTY_KEY;
+        bool claiming = false;
+
+        for(uint32 i = 0; i < MAX_PROBE; ++i)
+        {
+            Entry &entry = m_entries[(start + i) & mask];
+            uint64 entry_key = entry.m_key.load(std::memory_order_acquire);
+
+            if(entry_key == key)
+            {
+                entry.m_last_ms.store(now_ms, std::memory_order_seq_cst);
+
+                //pairs with expire(), either it sees the new stamp or the slot is seen taken back here
+                if(entry.m_key.load(std::memory_order_seq_cst) == key)
+                {
+                    return &entry.m_buckets;
+                }
+
+                claiming = true;
+
+                break;
+            }
+
+            //being claimed, maybe for this very peer, or being expired, wait for it
+            if(entry_key == CLAIMING_KEY)
+            {
+                claiming = true;
+
+                break;
+            }
+
+            if(entry_key <= TOMBSTONE_KEY && free_entry == nullptr)
+            {
+                free_entry = &entry;
+                free_key = entry_key;
+            }
+
+            //inserts take the first free slot, nothing lies behind an empty one
+            if(entry_key == EMPTY_KEY)
+            {
+                break;
+            }
+        }
+
+        if(claiming)
+        {
+            continue;
+        }
+
+        if(free_entry == nullptr)
+        {
+            return nullptr;
+        }
+
+        //the buckets are reset while the slot is held, before any user of the new peer can see it
+        if(free_entry->m_key.compare_exchange_strong(free_key, CLAIMING_KEY, std::memory_order_acq_rel))
+        {
+            free_entry->m_buckets.m_msgs.reset();
+            free_entry->m_buckets.m_bytes.reset();
+
+            //stamped before it's published so expire() won't take it back at once
+            free_entry->m_last_ms.store(now_ms, std::memory_order_relaxed);
+            free_entry->m_key.store(key, std::memory_order_release);
+            m_size.fetch_add(1, std::memory_order_relaxed);
+
+            return &free_entry->m_buckets;
+        }
+
+        //someone else claimed the slot, maybe for the same peer, probe again
+    }
+}
+
+//only called from one poller thread, returns the number of expired peers
+uint32 Peer_Rate_Table::expire(uint64 now_ms)
+{
+    uint32 num = 0;
+
+    for(uint32 i = 0; i < m_capacity; ++i)
+    {
+        Entry &entry = m_entries[i];
+        uint64 key = entry.m_key.load(std::memory_order_relaxed);
+
+        if(key <= CLAIMING_KEY)
+        {
+            continue;
+        }
+
+        if(entry.m_last_ms.load(std::memory_order_relaxed) + m_idle_ms > now_ms)
+        {
+            continue;
+        }
+
+        //held as claiming while it's decided, so no new peer can take the slot meanwhile
+        if(!entry.m_key.compare_exchange_strong(key, CLAIMING_KEY, std::memory_order_seq_cst))
+        {
+            continue;
+        }
+
+        //a find() refreshed the peer in between, it may already hold the buckets
+        if(entry.m_last_ms.load(std::memory_order_seq_cst) + m_idle_ms > now_ms)
+        {
+            entry.m_key.store(key, std::memory_order_release);
+
+            continue;
+        }
+
+        entry.m_key.store(TOMBSTONE_KEY, std::memory_order_release);
+        ++num;
+    }
+
+    m_size.fetch_sub(num, std::memory_order_relaxed);
+
+    return num;
+}
+
+const Rate_Limiter& Peer_Rate_Table::limiter() const
+{
+    return m_limiter;
+}
+
+uint32 Peer_Rate_Table::size()
+{
+    return m_size.load(std::memory_order_relaxed);
+}
+
+}
+}
@@ -0,0 +1,110 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 09:31:05                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__NET__RATE_LIMITER
+#define FLY__NET__RATE_LIMITER
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include "fly/base/token_bucket.hpp"
+#include "fly/net/addr.hpp"
+
+namespace fly {
+namespace net {
+
+//what happens to a message which breaches its limit
+enum RATE_LIMIT_ACTION
+{
+    RATE_LIMIT_DELAY,   //reading is paused until the bucket refilled, tcp pushes back on the peer
+    RATE_LIMIT_DROP,    //the message is discarded unparsed
+    RATE_LIMIT_CLOSE    //the connection is closed
+};
+
+//a rate of 0 is unlimited, a burst of 0 is one second worth of the rate
+struct Rate_Limit
+{
+    uint32 m_msgs_per_sec = 0;
+    uint32 m_msg_burst = 0;
+    uint64 m_bytes_per_sec = 0;
+    uint64 m_byte_burst = 0;
+    RATE_LIMIT_ACTION m_action = RATE_LIMIT_DROP;
+};
+
+//the state of one limited party, the limits themselves live in the Rate_Limiter
+struct Rate_Buckets
+{
+    fly::base::Token_Bucket m_msgs;
+    fly::base::Token_Bucket m_bytes;
+};
+
+class Rate_Limiter
+{
+public:
+    Rate_Limiter(const Rate_Limit &limit);
+    uint64 admit(Rate_Buckets &buckets, uint32 length, uint64 now_ns) const;
+    void refund(Rate_Buckets &buckets, uint32 length) const;
+    RATE_LIMIT_ACTION action() const;
+    uint64 refill_ms() const;
+    bool enabled() const;
+
+private:
+    Rate_Limit m_limit;
+    uint64 m_msg_cost_ns = 0;
+    uint64 m_msg_burst_ns = 0;
+    uint64 m_byte_burst_ns = 0;
+};
+
+//peer ip -> buckets, shared by the poller tasks of a Poller. open addressing over a fixed power of two array,
+//slots are claimed with a cas so find() is lock-free. expire() is driven by a poller timer and turns the
+//entries of idle peers into tombstones, a peer idle for refill_ms has a full bucket so nothing is lost
+class Peer_Rate_Table
+{
+public:
+    Peer_Rate_Table(const Rate_Limit &limit, uint32 capacity = 65536);
+    Peer_Rate_Table(const Peer_Rate_Table&) = delete;
+    Peer_Rate_Table& operator=(const Peer_Rate_Table&) = delete;
+    static uint64 key(const Addr &addr);
+    Rate_Buckets* find(uint64 key, uint64 now_ms);
+    uint32 expire(uint64 now_ms);
+    const Rate_Limiter& limiter() const;
+    uint32 size();
+    static const uint32 EXPIRE_INTERVAL_MS = 10000;
+
+private:
+    struct Entry
+    {
+        std::atomic<uint64> m_key {0};
+        std::atomic<uint64> m_last_ms {0};
+        Rate_Buckets m_buckets;
+    };
+
+    Rate_Limiter m_limiter;
+    std::unique_ptr<Entry[]> m_entries;
+    uint32 m_capacity = 0;
+    uint64 m_idle_ms = 0;
+    std::atomic<uint32> m_size {0};
+};
+
+}
+}
+
+#endif
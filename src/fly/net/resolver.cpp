@@ -0,0 +1,329 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 16:41:09                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <string.h>
+#include <netdb.h>
+#include <future>
+#include <algorithm>
+#include "fly/net/resolver.hpp"
+#include "fly/base/logger.hpp"
+
+namespace fly {
+namespace net {
+
+Resolver::Resolver(uint32 thread_num, uint32 ttl_ms, uint32 negative_ttl_ms)
+{
+    m_lookup = &Resolver::getaddrinfo_lookup;
+    m_ttl = ttl_ms;
+    m_negative_ttl = negative_ttl_ms;
+
+    for(uint32 i = 0; i < std::max(thread_num, 1u); ++i)
+    {
+        m_threads.push_back(std::thread(std::bind(&Resolver::run, this)));
+    }
+}
+
+//waits for the lookups in flight, the callers of the queued ones get EAI_AGAIN
+Resolver::~Resolver()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stop = true;
+    }
+
+    m_cond.notify_all();
+
+    for(auto &thread : m_threads)
+    {
+        thread.join();
+    }
+
+    std::vector<std::function<void(int32, const std::vector<Addr>&)>> waiters;
+    
+    for(auto &iter : m_entries)
+    {
+        waiters.insert(waiters.end(), iter.second.m_waiters.begin(), iter.second.m_waiters.end());
+    }
+
+    m_entries.clear();
+    std::vector<Addr> addrs;
+
+    for(auto &cb : waiters)
+    {
+        cb(EAI_AGAIN, addrs);
+    }
+}
+
+//shared by the clients which weren't given one
+std::shared_ptr<Resolver> Resolver::instance()
+{
+    static std::shared_ptr<Resolver> resolver = std::make_shared<Resolver>();
+
+    return resolver;
+}
+
+//cb gets the addrs of host at once if they are cached, else on a resolver thread once the lookup is done
+void Resolver::resolve(const std::string &host, uint16 port, std::function<void(int32, const std::vector<Addr>&)> cb)
+{
+    std::string key = host + ":" + base::to_string(port);
+    uint64 now = base::monotonic_ms();
+    std::unique_lock<std::mutex> locker(m_mutex);
+
+    if(m_stop)
+    {
+        locker.unlock();
+        cb(EAI_AGAIN, std::vector<Addr>());
+
+        return;
+    }
+    
+    Entry &entry = m_entries[key];
+    
+    if(now < entry.m_expire_ms)
+    {
+        m_hit_count.fetch_add(1, std::memory_order_relaxed);
+        
+        //in use near the end of its ttl, look it up again while the cached one is still served
+        if(now >= entry.m_refresh_ms && !entry.m_querying)
+        {
+            entry.m_querying = true;
+            m_queries.push_back(key);
+            m_refresh_count.fetch_add(1, std::memory_order_relaxed);
+            m_cond.notify_one();
+        }
+
+        int32 error = entry.m_error;
+        std::vector<Addr> addrs = entry.m_addrs;
+        locker.unlock();
+        cb(error, addrs);
+
+        return;
+    }
+    
+    m_miss_count.fetch_add(1, std::memory_order_relaxed);
+    entry.m_waiters.push_back(cb);
+
+    if(entry.m_querying)
+    {
+        m_coalesced_count.fetch_add(1, std::memory_order_relaxed);
+
+        return;
+    }
+    
+    entry.m_host = host;
+    entry.m_port = port;
+    entry.m_querying = true;
+    m_queries.push_back(key);
+    m_cond.notify_one();
+}
+
+//blocks while the name isn't cached
+int32 Resolver::resolve(const std::string &host, uint16 port, std::vector<Addr> &addrs)
+{
+    std::promise<int32> promise;
+    std::future<int32> future = promise.get_future();
+    resolve(host, port, [&](int32 error, const std::vector<Addr> &result)
+    {
+        addrs = result;
+        promise.set_value(error);
+    });
+
+    return future.get();
+}
+
+//call it before the first resolve
+void Resolver::set_lookup(Lookup lookup)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_lookup = lookup;
+}
+
+//applies to answers from now on
+void Resolver::set_ttl(uint32 ttl_ms, uint32 negative_ttl_ms)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_ttl = ttl_ms;
+    m_negative_ttl = negative_ttl_ms;
+}
+
+//forgets every answer, the lookups in flight still complete
+void Resolver::clear()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    for(auto iter = m_entries.begin(); iter != m_entries.end();)
+    {
+        if(iter->second.m_querying)
+        {
+            iter->second.m_expire_ms = 0;
+            ++iter;
+        }
+        else
+        {
+            iter = m_entries.erase(iter);
+        }
+    }
+}
+
+int32 Resolver::getaddrinfo_lookup(const std::string &host, uint16 port, std::vector<Addr> &addrs)
+{
+    struct addrinfo hint;
+    memset(&hint, 0, sizeof(hint));
+    hint.ai_family = AF_UNSPEC;
+    hint.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result;
+    int32 ret = getaddrinfo(host.c_str(), base::to_string(port).c_str(), &hint, &result);
+
+    if(ret != 0)
+    {
+        return ret;
+    }
+
+    for(struct addrinfo *iter = result; iter != NULL; iter = iter->ai_next)
+    {
+        addrs.push_back(Addr(iter->ai_addr, iter->ai_addrlen));
+    }
+
+    freeaddrinfo(result);
+
+    return 0;
+}
+
+void Resolver::run()
+{
+    std::unique_lock<std::mutex> locker(m_mutex);
+    
+    while(true)
+    {
+        m_cond.wait(locker, [&]{return m_stop || !m_queries.empty();});
+
+        if(m_stop)
+        {
+            break;
+        }
+        
+        std::string key = m_queries.front();
+        m_queries.pop_front();
+        Entry &entry = m_entries[key];
+        std::string host = entry.m_host;
+        uint16 port = entry.m_port;
+        Lookup lookup = m_lookup;
+        locker.unlock();
+        std::vector<Addr> addrs;
+        int32 error = lookup(host, port, addrs);
+        m_query_count.fetch_add(1, std::memory_order_relaxed);
+
+        if(error != 0)
+        {
+            LOG_DEBUG_ERROR("resolve %s failed in Resolver::run: %s", key.c_str(), gai_strerror(error));
+        }
+        
+        locker.lock();
+        uint64 now = base::monotonic_ms();
+
+        if(now >= m_sweep_ms)
+        {
+            sweep(now);
+        }
+        
+        Entry &done = m_entries[key];
+        done.m_querying = false;
+
+        //a failed refresh keeps serving the answer it should have replaced until that one expires
+        if(error != 0 && now < done.m_expire_ms && done.m_error == 0)
+        {
+            done.m_refresh_ms = done.m_expire_ms;
+        }
+        else
+        {
+            done.m_error = error;
+            done.m_addrs = addrs;
+            done.m_expire_ms = now + (error == 0 ? m_ttl : m_negative_ttl);
+            done.m_refresh_ms = error == 0 ? now + m_ttl / 4 * 3 : done.m_expire_ms;
+        }
+        
+        std::vector<std::function<void(int32, const std::vector<Addr>&)>> waiters;
+        waiters.swap(done.m_waiters);
+        error = done.m_error;
+        addrs = done.m_addrs;
+        locker.unlock();
+
+        for(auto &cb : waiters)
+        {
+            cb(error, addrs);
+        }
+
+        locker.lock();
+    }
+}
+
+//erases the expired answers nobody is waiting for, called with the lock held at most once a second
+void Resolver::sweep(uint64 now)
+{
+    m_sweep_ms = now + SWEEP_INTERVAL_MS;
+
+    for(auto iter = m_entries.begin(); iter != m_entries.end();)
+    {
+        if(!iter->second.m_querying && now >= iter->second.m_expire_ms)
+        {
+            iter = m_entries.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+uint32 Resolver::size()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    return m_entries.size();
+}
+
+uint64 Resolver::hit_count()
+{
+    return m_hit_count.load(std::memory_order_relaxed);
+}
+
+uint64 Resolver::miss_count()
+{
+    return m_miss_count.load(std::memory_order_relaxed);
+}
+
+uint64 Resolver::query_count()
+{
+    return m_query_count.load(std::memory_order_relaxed);
+}
+
+uint64 Resolver::coalesced_count()
+{
+    return m_coalesced_count.load(std::memory_order_relaxed);
+}
+
+uint64 Resolver::refresh_count()
+{
+    return m_refresh_count.load(std::memory_order_relaxed);
+}
+
+}
+}
@@ -0,0 +1,98 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 16:41:09                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__NET__RESOLVER
+#define FLY__NET__RESOLVER
+
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include <condition_variable>
+#include "fly/net/addr.hpp"
+
+namespace fly {
+namespace net {
+
+//caches host name lookups for the clients. the lookups run on dedicated threads, a name is queried once however
+//many callers wait for it. answers live ttl_ms, failures negative_ttl_ms, and an answer still in use is refreshed
+//in the background before it expires. expired answers are swept out as lookups complete. errors are the EAI_*
+//codes of getaddrinfo
+class Resolver
+{
+public:
+    //the query itself, getaddrinfo by default. replace it to resolve from a hosts file or a stub
+    typedef std::function<int32(const std::string &host, uint16 port, std::vector<Addr> &addrs)> Lookup;
+    Resolver(uint32 thread_num = 1, uint32 ttl_ms = 60000, uint32 negative_ttl_ms = 5000);
+    ~Resolver();
+    static std::shared_ptr<Resolver> instance();
+    void resolve(const std::string &host, uint16 port, std::function<void(int32, const std::vector<Addr>&)> cb);
+    int32 resolve(const std::string &host, uint16 port, std::vector<Addr> &addrs);
+    void set_lookup(Lookup lookup);
+    void set_ttl(uint32 ttl_ms, uint32 negative_ttl_ms);
+    void clear();
+    uint64 hit_count();
+    uint64 miss_count();
+    uint64 query_count();
+    uint64 coalesced_count();
+    uint64 refresh_count();
+    uint32 size();
+    
+private:
+    struct Entry
+    {
+        std::string m_host;
+        uint16 m_port;
+        int32 m_error = 0;
+        std::vector<Addr> m_addrs;
+        uint64 m_expire_ms = 0;
+        uint64 m_refresh_ms = 0;
+        bool m_querying = false;
+        std::vector<std::function<void(int32, const std::vector<Addr>&)>> m_waiters;
+    };
+    
+    static int32 getaddrinfo_lookup(const std::string &host, uint16 port, std::vector<Addr> &addrs);
+    void run();
+    void sweep(uint64 now);
+    static const uint32 SWEEP_INTERVAL_MS = 1000;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::unordered_map<std::string, Entry> m_entries;
+    std::deque<std::string> m_queries;
+    std::vector<std::thread> m_threads;
+    Lookup m_lookup;
+    uint32 m_ttl;
+    uint32 m_negative_ttl;
+    uint64 m_sweep_ms = 0;
+    bool m_stop = false;
+    std::atomic<uint64> m_hit_count {0};
+    std::atomic<uint64> m_miss_count {0};
+    std::atomic<uint64> m_query_count {0};
+    std::atomic<uint64> m_coalesced_count {0};
+    std::atomic<uint64> m_refresh_count {0};
+};
+
+}
+}
+
+#endif
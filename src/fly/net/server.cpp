@@ -35,11 +35,12 @@ Server<T>::Server(const Addr &addr,
                   std::function<void(std::unique_ptr<Message<T>>)> dispatch_cb,
                   std::function<void(std::shared_ptr<Connection<T>>)> close_cb,
                   std::function<void(std::shared_ptr<Connection<T>>)> be_closed_cb,
-                  std::shared_ptr<Poller<T>> poller, uint32 max_msg_length)
+                  std::shared_ptr<Poller<T>> poller, uint32 max_msg_length, bool reuse_port)
 {
     m_poller = poller;
+    m_reuse_port = reuse_port;
 
-    m_acceptor.reset(new Acceptor<T>(addr, [=](std::shared_ptr<Connection<T>> connection)
+    m_accept_cb = [=](std::shared_ptr<Connection<T>> connection)
     {
         connection->m_id = connection->m_id_allocator.new_id();
         connection->m_max_msg_length = max_msg_length;
@@ -50,9 +51,11 @@ Server<T>::Server(const Addr &addr,
 
         if(!m_poller->register_connection(connection))
         {
-            LOG_DEBUG_INFO("register_connection from %s:%d failed", connection->peer_addr().m_host.c_str(), connection->peer_addr().m_port);
+            LOG_DEBUG_INFO("register_connection from %s:%d failed", connection->peer_addr().host().c_str(), connection->peer_addr().port());
         }
-    }));
+    };
+    
+    m_acceptor.reset(new Acceptor<T>(addr, m_accept_cb));
 }
 
 template<typename T>
@@ -61,11 +64,12 @@ Server<T>::Server(const Addr &addr,
                   std::function<void(std::unique_ptr<Message<T>>)> dispatch_cb,
                   std::function<void(std::shared_ptr<Connection<T>>)> close_cb,
                   std::function<void(std::shared_ptr<Connection<T>>)> be_closed_cb,
-                  uint32 poller_num, uint32 max_msg_length)
+                  uint32 poller_num, uint32 max_msg_length, POLLER_BACKEND backend, bool reuse_port)
 {
-    m_poller.reset(new Poller<T>(poller_num));
+    m_poller.reset(new Poller<T>(poller_num, backend));
+    m_reuse_port = reuse_port;
 
-    m_acceptor.reset(new Acceptor<T>(addr, [=](std::shared_ptr<Connection<T>> connection)
+    m_accept_cb = [=](std::shared_ptr<Connection<T>> connection)
     {
         connection->m_id = connection->m_id_allocator.new_id();
         connection->m_max_msg_length = max_msg_length;
@@ -76,9 +80,11 @@ Server<T>::Server(const Addr &addr,
 
         if(!m_poller->register_connection(connection))
         {
-            LOG_DEBUG_INFO("register_connection from %s:%d failed", connection->peer_addr().m_host.c_str(), connection->peer_addr().m_port);
+            LOG_DEBUG_INFO("register_connection from %s:%d failed", connection->peer_addr().host().c_str(), connection->peer_addr().port());
         }
-    }));
+    };
+    
+    m_acceptor.reset(new Acceptor<T>(addr, m_accept_cb));
 }
 
 template<typename T>
@@ -89,20 +95,42 @@ bool Server<T>::start()
         m_poller->start();
     }
 
+    m_acceptor->set_socket_options(m_socket_options.over(m_poller->socket_options()));
+
+    //every poller task accepts on its own SO_REUSEPORT listen fd, no acceptor thread and no handoff
+    if(m_reuse_port)
+    {
+        return m_acceptor->listen(m_poller->poller_task_num()) && m_poller->listen(m_acceptor->listen_fds(), m_accept_cb);
+    }
+    
+    //the uring backend accepts with a multishot accept inside the poller, no acceptor thread
+    if(m_poller->backend() == POLLER_URING)
+    {
+        return m_acceptor->listen() && m_poller->listen(m_acceptor->listen_fds(), m_accept_cb);
+    }
+    
     return m_acceptor->start();
 }
 
+//drain_timeout_ms > 0 flushes what's queued for the clients before the pollers exit, see Poller_Task::stop
 template<typename T>
-void Server<T>::stop()
+void Server<T>::stop(uint32 drain_timeout_ms)
 {
     m_acceptor->stop();
 
     if(m_poller.unique())
     {
-        m_poller->stop();
+        m_poller->stop(drain_timeout_ms);
     }
 }
 
+//overrides the options of the poller, the accepted sockets inherit them from the listen sockets. call it before start()
+template<typename T>
+void Server<T>::set_socket_options(const Socket_Options &options)
+{
+    m_socket_options = options;
+}
+
 template<typename T>
 void Server<T>::wait()
 {
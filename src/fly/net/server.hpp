@@ -38,20 +38,25 @@ public:
            std::function<void(std::unique_ptr<Message<T>>)> dispatch_cb,
            std::function<void(std::shared_ptr<Connection<T>>)> close_cb,
            std::function<void(std::shared_ptr<Connection<T>>)> be_closed_cb,
-           std::shared_ptr<Poller<T>> poller, uint32 max_msg_length = 1024 * 1024 * 1024);
+           std::shared_ptr<Poller<T>> poller, uint32 max_msg_length = 1024 * 1024 * 1024, bool reuse_port = false);
     Server(const Addr &addr,
            std::function<bool(std::shared_ptr<Connection<T>>)> init_cb,
            std::function<void(std::unique_ptr<Message<T>>)> dispatch_cb,
            std::function<void(std::shared_ptr<Connection<T>>)> close_cb,
            std::function<void(std::shared_ptr<Connection<T>>)> be_closed_cb,
-           uint32 poller_num = 1, uint32 max_msg_length = 1024 * 1024 * 1024);
+           uint32 poller_num = 1, uint32 max_msg_length = 1024 * 1024 * 1024, POLLER_BACKEND backend = POLLER_EPOLL,
+           bool reuse_port = false);
     void wait();
     bool start();
-    void stop();
+    void stop(uint32 drain_timeout_ms = 0);
+    void set_socket_options(const Socket_Options &options);
     
 private:
     std::unique_ptr<Acceptor<T>> m_acceptor;
     std::shared_ptr<Poller<T>> m_poller;
+    std::function<void(std::shared_ptr<Connection<T>>)> m_accept_cb;
+    bool m_reuse_port = false;
+    Socket_Options m_socket_options;
 };
 
 }
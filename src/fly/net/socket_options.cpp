@@ -0,0 +1,92 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 14:05:31                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "fly/base/logger.hpp"
+#include "fly/net/socket_options.hpp"
+
+namespace fly {
+namespace net {
+
+//the options set here, the rest taken from base
+Socket_Options Socket_Options::over(const Socket_Options &base) const
+{
+    Socket_Options options;
+    options.m_nodelay = m_nodelay >= 0 ? m_nodelay : base.m_nodelay;
+    options.m_send_buf = m_send_buf >= 0 ? m_send_buf : base.m_send_buf;
+    options.m_recv_buf = m_recv_buf >= 0 ? m_recv_buf : base.m_recv_buf;
+    options.m_keepalive = m_keepalive >= 0 ? m_keepalive : base.m_keepalive;
+    options.m_keepalive_idle = m_keepalive_idle >= 0 ? m_keepalive_idle : base.m_keepalive_idle;
+    options.m_keepalive_interval = m_keepalive_interval >= 0 ? m_keepalive_interval : base.m_keepalive_interval;
+    options.m_keepalive_count = m_keepalive_count >= 0 ? m_keepalive_count : base.m_keepalive_count;
+    options.m_user_timeout = m_user_timeout >= 0 ? m_user_timeout : base.m_user_timeout;
+    options.m_notsent_lowat = m_notsent_lowat >= 0 ? m_notsent_lowat : base.m_notsent_lowat;
+
+    return options;
+}
+
+static bool set_option(int32 fd, int32 level, int32 name, int32 value, const char *name_str)
+{
+    if(value < 0)
+    {
+        return true;
+    }
+
+    if(setsockopt(fd, level, name, &value, sizeof(value)) < 0)
+    {
+        LOG_ERROR("setsockopt %s = %d failed in Socket_Options::apply: %s", name_str, value, strerror(errno));
+
+        return false;
+    }
+
+    return true;
+}
+
+//a failed option is logged and skipped, the others are still applied. udp and unix sockets only take the buffer sizes
+bool Socket_Options::apply(int32 fd) const
+{
+    bool ok = set_option(fd, SOL_SOCKET, SO_SNDBUF, m_send_buf, "SO_SNDBUF");
+    ok = set_option(fd, SOL_SOCKET, SO_RCVBUF, m_recv_buf, "SO_RCVBUF") && ok;
+    int32 protocol = 0;
+    socklen_t length = sizeof(protocol);
+    
+    if(getsockopt(fd, SOL_SOCKET, SO_PROTOCOL, &protocol, &length) < 0 || protocol != IPPROTO_TCP)
+    {
+        return ok;
+    }
+    
+    ok = set_option(fd, IPPROTO_TCP, TCP_NODELAY, m_nodelay, "TCP_NODELAY") && ok;
+    ok = set_option(fd, SOL_SOCKET, SO_KEEPALIVE, m_keepalive, "SO_KEEPALIVE") && ok;
+    ok = set_option(fd, IPPROTO_TCP, TCP_KEEPIDLE, m_keepalive_idle, "TCP_KEEPIDLE") && ok;
+    ok = set_option(fd, IPPROTO_TCP, TCP_KEEPINTVL, m_keepalive_interval, "TCP_KEEPINTVL") && ok;
+    ok = set_option(fd, IPPROTO_TCP, TCP_KEEPCNT, m_keepalive_count, "TCP_KEEPCNT") && ok;
+    ok = set_option(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, m_user_timeout, "TCP_USER_TIMEOUT") && ok;
+    ok = set_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, m_notsent_lowat, "TCP_NOTSENT_LOWAT") && ok;
+
+    return ok;
+}
+
+}
+}
@@ -0,0 +1,50 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 14:05:31                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__NET__SOCKET_OPTIONS
+#define FLY__NET__SOCKET_OPTIONS
+
+#include "fly/base/common.hpp"
+
+namespace fly {
+namespace net {
+
+//-1 leaves the kernel default, see socket(7) and tcp(7)
+struct Socket_Options
+{
+    int32 m_nodelay = -1;               //TCP_NODELAY, 0 or 1
+    int32 m_send_buf = -1;              //SO_SNDBUF bytes
+    int32 m_recv_buf = -1;              //SO_RCVBUF bytes
+    int32 m_keepalive = -1;             //SO_KEEPALIVE, 0 or 1
+    int32 m_keepalive_idle = -1;        //TCP_KEEPIDLE seconds
+    int32 m_keepalive_interval = -1;    //TCP_KEEPINTVL seconds
+    int32 m_keepalive_count = -1;       //TCP_KEEPCNT probes
+    int32 m_user_timeout = -1;          //TCP_USER_TIMEOUT ms
+    int32 m_notsent_lowat = -1;         //TCP_NOTSENT_LOWAT bytes
+    
+    Socket_Options over(const Socket_Options &base) const;
+    bool apply(int32 fd) const;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,503 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 16:02:37                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include "fly/base/logger.hpp"
+#include "fly/net/udp_socket.hpp"
+
+namespace fly {
+namespace net {
+
+static const uint32 UDP_BATCH = 64;
+
+//epoll is level triggered, a flood on one socket can't starve the others
+static const uint32 MAX_RECV_ROUNDS = 16;
+
+//kernel limits of one UDP_SEGMENT send
+static const uint32 MAX_GSO_SEGMENTS = 64;
+static const uint32 MAX_GSO_BYTES = 65000;
+
+//a GRO'ed read holds up to 64KB of segments
+static const uint32 GRO_BUF_SIZE = 65535;
+static const uint32 CONTROL_SIZE = CMSG_SPACE(sizeof(uint16)) > CMSG_SPACE(sizeof(int32)) ? CMSG_SPACE(sizeof(uint16)) : CMSG_SPACE(sizeof(int32));
+
+template<typename T>
+Datagram<T>::Datagram(std::shared_ptr<Udp_Socket<T>> udp_socket, const Addr &peer_addr, const char *data, uint32 length)
+    : m_udp_socket(udp_socket), m_peer_addr(peer_addr), m_raw_data(data, length)
+{
+}
+
+template<typename T>
+const std::string& Datagram<T>::raw_data()
+{
+    return m_raw_data;
+}
+
+template<typename T>
+uint32 Datagram<T>::length()
+{
+    return m_raw_data.length();
+}
+
+template<typename T>
+const Addr& Datagram<T>::peer_addr()
+{
+    return m_peer_addr;
+}
+
+template<typename T>
+std::shared_ptr<Udp_Socket<T>> Datagram<T>::get_socket()
+{
+    return m_udp_socket;
+}
+
+template<typename T>
+Udp_Socket<T>::Udp_Socket(const Addr &addr, std::function<void(std::unique_ptr<Datagram<T>>)> dispatch_cb,
+                          std::shared_ptr<Poller<T>> poller, uint32 max_datagram_size, bool offload)
+{
+    m_addr = addr;
+    m_dispatch_cb = dispatch_cb;
+    m_poller = poller;
+    m_max_datagram_size = max_datagram_size;
+    m_offload = offload;
+}
+
+template<typename T>
+Udp_Socket<T>::~Udp_Socket()
+{
+    if(m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+}
+
+//overrides the options of the poller, call it before open()
+template<typename T>
+void Udp_Socket<T>::set_socket_options(const Socket_Options &options)
+{
+    m_socket_options = options;
+}
+
+//binds to addr (port 0 picks a free one, see local_addr) and hands the socket to a poller task
+template<typename T>
+bool Udp_Socket<T>::open()
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_length = m_addr.sock_addr(&addr);
+
+    if(addr_length == 0 || m_addr.family() == AF_UNIX)
+    {
+        LOG_FATAL("addr %s is not an ip address in Udp_Socket::open", m_addr.to_string().c_str());
+
+        return false;
+    }
+    
+    m_fd = socket(m_addr.family(), SOCK_DGRAM | SOCK_NONBLOCK, 0);
+
+    if(m_fd < 0)
+    {
+        LOG_FATAL("socket failed in Udp_Socket::open: %s", strerror(errno));
+
+        return false;
+    }
+
+    m_socket_options.over(m_poller->socket_options()).apply(m_fd);
+    
+    if(bind(m_fd, (sockaddr*)&addr, addr_length) < 0)
+    {
+        LOG_FATAL("bind failed in Udp_Socket::open, addr is %s: %s", m_addr.to_string().c_str(), strerror(errno));
+        
+        return false;
+    }
+
+    addr_length = sizeof(addr);
+    getsockname(m_fd, (sockaddr*)&addr, &addr_length);
+    m_local_addr = Addr((sockaddr*)&addr, addr_length);
+    int32 opt = 1;
+
+    //both need linux 5.0+, without them every datagram is a syscall entry of its own
+    if(m_offload)
+    {
+        m_gro = setsockopt(m_fd, IPPROTO_UDP, UDP_GRO, &opt, sizeof(opt)) == 0;
+
+        if(!m_gro)
+        {
+            LOG_INFO("UDP_GRO is not supported in Udp_Socket::open: %s", strerror(errno));
+        }
+
+        //a segment size of 0 keeps the socket default unsegmented, only the per message cmsg turns it on
+        int32 segment_size = 0;
+        m_gso = setsockopt(m_fd, IPPROTO_UDP, UDP_SEGMENT, &segment_size, sizeof(segment_size)) == 0;
+
+        if(!m_gso)
+        {
+            LOG_INFO("UDP_SEGMENT is not supported in Udp_Socket::open: %s", strerror(errno));
+        }
+    }
+    
+    m_recv_buf_size = m_gro ? std::max(m_max_datagram_size, GRO_BUF_SIZE) : m_max_datagram_size;
+    m_recv_buf.resize(UDP_BATCH * m_recv_buf_size);
+    m_recv_msgs.resize(UDP_BATCH);
+    m_recv_iov.resize(UDP_BATCH);
+    m_recv_addrs.resize(UDP_BATCH);
+    m_recv_control.resize(UDP_BATCH * CONTROL_SIZE);
+    m_send_msgs.resize(UDP_BATCH);
+    m_send_iov.resize(UDP_BATCH * MAX_GSO_SEGMENTS);
+    m_send_addrs.resize(UDP_BATCH);
+    m_send_control.resize(UDP_BATCH * CONTROL_SIZE);
+    m_send_segments.resize(UDP_BATCH);
+    memset(m_recv_msgs.data(), 0, UDP_BATCH * sizeof(struct mmsghdr));
+    
+    for(uint32 i = 0; i < UDP_BATCH; ++i)
+    {
+        m_recv_iov[i].iov_base = m_recv_buf.data() + i * m_recv_buf_size;
+        m_recv_iov[i].iov_len = m_recv_buf_size;
+        m_recv_msgs[i].msg_hdr.msg_iov = &m_recv_iov[i];
+        m_recv_msgs[i].msg_hdr.msg_iovlen = 1;
+        m_recv_msgs[i].msg_hdr.msg_name = &m_recv_addrs[i];
+        m_recv_msgs[i].msg_hdr.msg_control = m_gro ? m_recv_control.data() + i * CONTROL_SIZE : nullptr;
+    }
+    
+    return m_poller->register_udp_socket(this->shared_from_this());
+}
+
+template<typename T>
+void Udp_Socket<T>::close()
+{
+    if(m_closed.exchange(true))
+    {
+        return;
+    }
+
+    if(m_poller_task != nullptr)
+    {
+        m_poller_task->close_udp_socket(this->shared_from_this());
+    }
+}
+
+template<typename T>
+bool Udp_Socket<T>::closed()
+{
+    return m_closed.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+const Addr& Udp_Socket<T>::local_addr()
+{
+    return m_local_addr;
+}
+
+//from any thread, the poller task flushes everything queued so far with one sendmmsg per 64 datagrams
+template<typename T>
+bool Udp_Socket<T>::send(const Addr &peer_addr, const void *data, uint32 size)
+{
+    if(m_poller_task == nullptr || m_closed.load(std::memory_order_relaxed) || size > m_max_datagram_size)
+    {
+        return false;
+    }
+
+    Outgoing outgoing;
+    outgoing.m_peer_addr = peer_addr;
+    outgoing.m_data.assign((const char*)data, size);
+    m_send_queue.push(std::move(outgoing));
+
+    //one flush pending at a time, it picks up everything pushed before it runs
+    if(!m_send_scheduled.exchange(true))
+    {
+        m_poller_task->run_after(0, std::bind(&Udp_Socket::do_send, this->shared_from_this()));
+    }
+    
+    return true;
+}
+
+//runs on the poller thread, splits GRO'ed reads back into the datagrams of the peer
+template<typename T>
+void Udp_Socket<T>::do_recv(bool drain)
+{
+    std::shared_ptr<Udp_Socket> self = this->shared_from_this();
+    
+    for(uint32 round = 0; drain || round < MAX_RECV_ROUNDS; ++round)
+    {
+        for(uint32 i = 0; i < UDP_BATCH; ++i)
+        {
+            m_recv_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+            m_recv_msgs[i].msg_hdr.msg_controllen = m_gro ? CONTROL_SIZE : 0;
+            m_recv_msgs[i].msg_hdr.msg_flags = 0;
+        }
+        
+        int32 num = recvmmsg(m_fd, m_recv_msgs.data(), UDP_BATCH, MSG_DONTWAIT, nullptr);
+
+        if(num <= 0)
+        {
+            if(num < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_DEBUG_ERROR("recvmmsg failed in Udp_Socket::do_recv: %s", strerror(errno));
+            }
+
+            return;
+        }
+
+        m_recv_batch_count.fetch_add(1, std::memory_order_relaxed);
+        
+        for(int32 i = 0; i < num; ++i)
+        {
+            struct msghdr &hdr = m_recv_msgs[i].msg_hdr;
+
+            //longer than max_datagram_size, the tail is lost
+            if(hdr.msg_flags & MSG_TRUNC)
+            {
+                m_drop_count.fetch_add(1, std::memory_order_relaxed);
+
+                continue;
+            }
+            
+            uint32 length = m_recv_msgs[i].msg_len;
+            uint32 segment = length;
+
+            for(struct cmsghdr *cmsg = m_gro ? CMSG_FIRSTHDR(&hdr) : nullptr; cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+            {
+                if(cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
+                {
+                    int32 gso_size = 0;
+                    memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+                    segment = gso_size > 0 ? gso_size : length;
+                }
+            }
+            
+            Addr peer_addr((sockaddr*)hdr.msg_name, hdr.msg_namelen);
+            const char *data = (const char*)m_recv_iov[i].iov_base;
+            uint32 offset = 0;
+
+            //an empty datagram is dispatched too
+            do
+            {
+                uint32 size = std::min(segment, length - offset);
+                m_recv_count.fetch_add(1, std::memory_order_relaxed);
+                m_dispatch_cb(std::unique_ptr<Datagram<T>>(new Datagram<T>(self, peer_addr, data + offset, size)));
+                offset += size;
+            } while(offset < length);
+        }
+
+        if(num < (int32)UDP_BATCH)
+        {
+            return;
+        }
+    }
+}
+
+//how many datagrams from m_sending[idx] on can go out as one UDP_SEGMENT send: same peer, same size, only
+//the last one may be shorter
+template<typename T>
+uint32 Udp_Socket<T>::gso_run(uint32 idx)
+{
+    const Outgoing &first = m_sending[idx];
+    uint32 size = first.m_data.size();
+    uint32 bytes = size;
+    uint32 num = 1;
+
+    if(!m_gso || size == 0)
+    {
+        return 1;
+    }
+    
+    while(idx + num < m_sending.size() && num < MAX_GSO_SEGMENTS)
+    {
+        const Outgoing &next = m_sending[idx + num];
+        uint32 next_size = next.m_data.size();
+
+        if(next_size == 0 || next_size > size || bytes + next_size > MAX_GSO_BYTES || !(next.m_peer_addr == first.m_peer_addr))
+        {
+            break;
+        }
+
+        bytes += next_size;
+        ++num;
+
+        if(next_size < size)
+        {
+            break;
+        }
+    }
+
+    return num;
+}
+
+//runs on the poller thread
+template<typename T>
+void Udp_Socket<T>::do_send()
+{
+    m_send_scheduled.store(false);
+    std::vector<Outgoing> queue;
+
+    if(m_send_queue.pop(queue))
+    {
+        for(auto &outgoing : queue)
+        {
+            m_sending.push_back(std::move(outgoing));
+        }
+    }
+    
+    if(m_closed.load(std::memory_order_relaxed))
+    {
+        m_sending.clear();
+
+        return;
+    }
+    
+    while(!m_sending.empty())
+    {
+        uint32 msg_num = 0;
+        uint32 iov_num = 0;
+        uint32 idx = 0;
+        
+        while(msg_num < UDP_BATCH && idx < m_sending.size())
+        {
+            uint32 segments = gso_run(idx);
+            struct msghdr &hdr = m_send_msgs[msg_num].msg_hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_name = &m_send_addrs[msg_num];
+            hdr.msg_namelen = m_sending[idx].m_peer_addr.sock_addr(&m_send_addrs[msg_num]);
+            hdr.msg_iov = &m_send_iov[iov_num];
+            hdr.msg_iovlen = segments;
+            
+            for(uint32 i = 0; i < segments; ++i)
+            {
+                std::string &data = m_sending[idx + i].m_data;
+                m_send_iov[iov_num].iov_base = &data[0];
+                m_send_iov[iov_num].iov_len = data.size();
+                ++iov_num;
+            }
+
+            if(segments > 1)
+            {
+                hdr.msg_control = m_send_control.data() + msg_num * CONTROL_SIZE;
+                hdr.msg_controllen = CMSG_SPACE(sizeof(uint16));
+                struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+                cmsg->cmsg_level = IPPROTO_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16));
+                uint16 segment_size = m_sending[idx].m_data.size();
+                memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+            }
+            
+            m_send_segments[msg_num] = segments;
+            idx += segments;
+            ++msg_num;
+        }
+
+        int32 num = sendmmsg(m_fd, m_send_msgs.data(), msg_num, MSG_DONTWAIT);
+
+        if(num < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            
+            //the socket buffer drains within microseconds, retry soon instead of watching for writability
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+            {
+                if(!m_send_scheduled.exchange(true))
+                {
+                    m_poller_task->run_after(1, std::bind(&Udp_Socket::do_send, this->shared_from_this()));
+                }
+                
+                return;
+            }
+
+            //the device (EIO) or the kernel (EINVAL, ENOPROTOOPT) can't segment, send them one by one from now on
+            if((errno == EIO || errno == EINVAL || errno == ENOPROTOOPT) && m_send_segments[0] > 1)
+            {
+                LOG_INFO("UDP_SEGMENT is not supported in Udp_Socket::do_send, fall back to plain sends");
+                m_gso = false;
+
+                continue;
+            }
+            
+            //the first datagram is refused (unreachable peer, bad addr etc.), drop it and go on
+            LOG_DEBUG_ERROR("sendmmsg to %s failed in Udp_Socket::do_send: %s", m_sending[0].m_peer_addr.to_string().c_str(), strerror(errno));
+            num = 1;
+            m_drop_count.fetch_add(m_send_segments[0], std::memory_order_relaxed);
+        }
+        else
+        {
+            m_send_batch_count.fetch_add(1, std::memory_order_relaxed);
+
+            for(int32 i = 0; i < num; ++i)
+            {
+                m_send_count.fetch_add(m_send_segments[i], std::memory_order_relaxed);
+            }
+        }
+        
+        for(int32 i = 0; i < num; ++i)
+        {
+            for(uint32 j = 0; j < m_send_segments[i]; ++j)
+            {
+                m_sending.pop_front();
+            }
+        }
+    }
+}
+
+template<typename T>
+uint64 Udp_Socket<T>::recv_count()
+{
+    return m_recv_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Udp_Socket<T>::recv_batch_count()
+{
+    return m_recv_batch_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Udp_Socket<T>::send_count()
+{
+    return m_send_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Udp_Socket<T>::send_batch_count()
+{
+    return m_send_batch_count.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+uint64 Udp_Socket<T>::drop_count()
+{
+    return m_drop_count.load(std::memory_order_relaxed);
+}
+
+template class Datagram<Json>;
+template class Datagram<Wsock>;
+template class Datagram<Proto>;
+template class Udp_Socket<Json>;
+template class Udp_Socket<Wsock>;
+template class Udp_Socket<Proto>;
+
+}
+}
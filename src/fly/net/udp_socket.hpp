@@ -0,0 +1,127 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 16:02:37                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__NET__UDP_SOCKET
+#define FLY__NET__UDP_SOCKET
+
+#include <deque>
+#include <vector>
+#include <sys/socket.h>
+#include "fly/net/poller.hpp"
+#include "fly/base/mpsc_queue.hpp"
+
+namespace fly {
+namespace net {
+
+template<typename T>
+class Udp_Socket;
+
+//one received datagram, the counterpart of Message<T> for a Udp_Socket
+template<typename T>
+class Datagram
+{
+public:
+    Datagram(std::shared_ptr<Udp_Socket<T>> udp_socket, const Addr &peer_addr, const char *data, uint32 length);
+    const std::string& raw_data();
+    uint32 length();
+    const Addr& peer_addr();
+    std::shared_ptr<Udp_Socket<T>> get_socket();
+    
+private:
+    std::shared_ptr<Udp_Socket<T>> m_udp_socket;
+    Addr m_peer_addr;
+    std::string m_raw_data;
+};
+
+//a udp socket driven by one poller task of a Poller<T>. datagrams are received with recvmmsg and handed to
+//dispatch_cb on the poller thread, send() queues from any thread and the poller flushes with sendmmsg.
+//offload turns on UDP_GRO for receiving and UDP_SEGMENT for runs of equal sized datagrams to the same peer
+template<typename T>
+class Udp_Socket : public std::enable_shared_from_this<Udp_Socket<T>>
+{
+    friend class Poller_Task<T>;
+    friend class Poller<T>;
+    
+public:
+    Udp_Socket(const Addr &addr, std::function<void(std::unique_ptr<Datagram<T>>)> dispatch_cb,
+               std::shared_ptr<Poller<T>> poller, uint32 max_datagram_size = 65507, bool offload = false);
+    ~Udp_Socket();
+    bool open();
+    void close();
+    bool closed();
+    bool send(const Addr &peer_addr, const void *data, uint32 size);
+    void set_socket_options(const Socket_Options &options);
+    const Addr& local_addr();
+    uint64 recv_count();
+    uint64 recv_batch_count();
+    uint64 send_count();
+    uint64 send_batch_count();
+    uint64 drop_count();
+    
+private:
+    struct Outgoing
+    {
+        Addr m_peer_addr;
+        std::string m_data;
+    };
+    
+    void do_recv(bool drain);
+    void do_send();
+    uint32 gso_run(uint32 idx);
+    int32 m_fd = -1;
+    Addr m_addr;
+    Addr m_local_addr;
+    uint32 m_max_datagram_size;
+    bool m_offload;
+    bool m_gro = false;
+    bool m_gso = false;
+    uint32 m_recv_buf_size = 0;
+    std::function<void(std::unique_ptr<Datagram<T>>)> m_dispatch_cb;
+    std::shared_ptr<Poller<T>> m_poller;
+    Poller_Task<T> *m_poller_task = nullptr;
+    std::shared_ptr<Udp_Socket> m_self;
+    Uring_Poll m_uring_poll;
+    Socket_Options m_socket_options;
+    std::atomic<bool> m_closed {false};
+    std::atomic<bool> m_send_scheduled {false};
+    fly::base::MPSC_Queue<Outgoing> m_send_queue;
+    std::deque<Outgoing> m_sending;
+    std::vector<char> m_recv_buf;
+    std::vector<struct mmsghdr> m_recv_msgs;
+    std::vector<struct iovec> m_recv_iov;
+    std::vector<struct sockaddr_storage> m_recv_addrs;
+    std::vector<char> m_recv_control;
+    std::vector<struct mmsghdr> m_send_msgs;
+    std::vector<struct iovec> m_send_iov;
+    std::vector<struct sockaddr_storage> m_send_addrs;
+    std::vector<char> m_send_control;
+    std::vector<uint32> m_send_segments;
+    std::atomic<uint64> m_recv_count {0};
+    std::atomic<uint64> m_recv_batch_count {0};
+    std::atomic<uint64> m_send_count {0};
+    std::atomic<uint64> m_send_batch_count {0};
+    std::atomic<uint64> m_drop_count {0};
+};
+
+}
+}
+
+#endif
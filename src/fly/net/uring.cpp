@@ -0,0 +1,454 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 10:06:12                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <cstring>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include "fly/base/logger.hpp"
+#include "fly/net/message_chunk.hpp"
+#include "fly/net/uring.hpp"
+
+namespace fly {
+namespace net {
+
+static thread_local Uring *t_current_uring = nullptr;
+
+Uring_Context::~Uring_Context()
+{
+    for(auto *message_chunk : m_send_chunks)
+    {
+        delete message_chunk;
+    }
+}
+
+//the fd goes first, closing it cancels the recvs still armed on the buffer ring before the buffers are freed
+Uring::~Uring()
+{
+    if(m_fd >= 0)
+    {
+        close(m_fd);
+    }
+
+    if(m_buf_ring != nullptr)
+    {
+        munmap(m_buf_ring, m_buf_ring_size);
+        delete[] m_bufs;
+    }
+
+    if(m_sqes != nullptr)
+    {
+        munmap(m_sqes, m_sqes_size);
+    }
+
+    if(m_cq_ring != nullptr && m_cq_ring != m_sq_ring)
+    {
+        munmap(m_cq_ring, m_cq_ring_size);
+    }
+
+    if(m_sq_ring != nullptr)
+    {
+        munmap(m_sq_ring, m_sq_ring_size);
+    }
+}
+
+bool Uring::init(uint32 entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    m_fd = syscall(__NR_io_uring_setup, entries, &params);
+
+    if(m_fd < 0)
+    {
+        LOG_FATAL("io_uring_setup failed in Uring::init: %s", strerror(errno));
+
+        return false;
+    }
+
+    m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32);
+    m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(m_cq_ring_size > m_sq_ring_size)
+        {
+            m_sq_ring_size = m_cq_ring_size;
+        }
+        
+        m_cq_ring_size = m_sq_ring_size;
+    }
+    
+    m_sq_ring = mmap(0, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+
+    if(m_sq_ring == MAP_FAILED)
+    {
+        m_sq_ring = nullptr;
+        LOG_FATAL("mmap sq ring failed in Uring::init: %s", strerror(errno));
+
+        return false;
+    }
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        m_cq_ring = m_sq_ring;
+    }
+    else
+    {
+        m_cq_ring = mmap(0, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+
+        if(m_cq_ring == MAP_FAILED)
+        {
+            m_cq_ring = nullptr;
+            LOG_FATAL("mmap cq ring failed in Uring::init: %s", strerror(errno));
+
+            return false;
+        }
+    }
+
+    m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(0, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+    
+    if(sqes == MAP_FAILED)
+    {
+        LOG_FATAL("mmap sqes failed in Uring::init: %s", strerror(errno));
+
+        return false;
+    }
+
+    m_sqes = (struct io_uring_sqe*)sqes;
+    char *sq_ring = (char*)m_sq_ring;
+    char *cq_ring = (char*)m_cq_ring;
+    m_sq_entries = params.sq_entries;
+    m_sq_mask = *(uint32*)(sq_ring + params.sq_off.ring_mask);
+    m_sq_head = (uint32*)(sq_ring + params.sq_off.head);
+    m_sq_tail = (uint32*)(sq_ring + params.sq_off.tail);
+    m_sq_flags = (uint32*)(sq_ring + params.sq_off.flags);
+    m_cq_mask = *(uint32*)(cq_ring + params.cq_off.ring_mask);
+    m_cq_head = (uint32*)(cq_ring + params.cq_off.head);
+    m_cq_tail = (uint32*)(cq_ring + params.cq_off.tail);
+    m_cqes = (struct io_uring_cqe*)(cq_ring + params.cq_off.cqes);
+    uint32 *sq_array = (uint32*)(sq_ring + params.sq_off.array);
+
+    //sqe index i always sits in slot i of the sq array
+    for(uint32 i = 0; i < m_sq_entries; ++i)
+    {
+        sq_array[i] = i;
+    }
+
+    m_sqe_tail = *m_sq_tail;
+    m_sq_submitted = m_sqe_tail;
+
+    return true;
+}
+
+//provided buffers shared by all the multishot recv of this ring, count must be a power of 2
+bool Uring::init_buf_ring(uint16 group_id, uint32 count, uint32 size)
+{
+    m_buf_ring_size = count * sizeof(struct io_uring_buf);
+    void *ring = mmap(0, m_buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(ring == MAP_FAILED)
+    {
+        LOG_FATAL("mmap buf ring failed in Uring::init_buf_ring: %s", strerror(errno));
+
+        return false;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64)ring;
+    reg.ring_entries = count;
+    reg.bgid = group_id;
+
+    if(syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        LOG_FATAL("register pbuf ring failed in Uring::init_buf_ring: %s", strerror(errno));
+        munmap(ring, m_buf_ring_size);
+
+        return false;
+    }
+
+    m_buf_ring = (struct io_uring_buf*)ring;
+    m_buf_mask = count - 1;
+    m_buf_size = size;
+    m_buf_group = group_id;
+    m_bufs = new char[(uint64)count * size];
+    
+    for(uint32 i = 0; i < count; ++i)
+    {
+        recycle_buf(i);
+    }
+
+    return true;
+}
+
+int32 Uring::fd()
+{
+    return m_fd;
+}
+
+char* Uring::buf(uint16 bid)
+{
+    return m_bufs + (uint64)bid * m_buf_size;
+}
+
+//the ring tail overlays the resv field of the first entry (struct io_uring_buf_ring isn't usable from c++)
+void Uring::recycle_buf(uint16 bid)
+{
+    uint16 *tail_ptr = &m_buf_ring[0].resv;
+    uint16 tail = __atomic_load_n(tail_ptr, __ATOMIC_RELAXED);
+    struct io_uring_buf *buf = &m_buf_ring[tail & m_buf_mask];
+    buf->addr = (uint64)(m_bufs + (uint64)bid * m_buf_size);
+    buf->len = m_buf_size;
+    buf->bid = bid;
+    __atomic_store_n(tail_ptr, (uint16)(tail + 1), __ATOMIC_RELEASE);
+}
+
+//never fails. while the sq ring stays full (io_uring_enter returns EBUSY until an overflowed cq is reaped) the
+//sqes wait in m_backlog, in order, and go to the ring with the next submit
+struct io_uring_sqe* Uring::get_sqe()
+{
+    if(m_backlog.empty() && m_sqe_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries)
+    {
+        submit();
+    }
+
+    if(!m_backlog.empty() || m_sqe_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries)
+    {
+        if(m_backlog.empty())
+        {
+            LOG_ERROR("sq ring is full in Uring::get_sqe, queueing sqes until it drains");
+        }
+        
+        m_backlog.emplace_back();
+        struct io_uring_sqe *sqe = &m_backlog.back();
+        memset(sqe, 0, sizeof(*sqe));
+
+        return sqe;
+    }
+
+    struct io_uring_sqe *sqe = &m_sqes[m_sqe_tail & m_sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ++m_sqe_tail;
+
+    return sqe;
+}
+
+int32 Uring::submit()
+{
+    return submit_and_wait(0);
+}
+
+//the backlog is moved to the ring first, a ring full at a time
+int32 Uring::submit_and_wait(uint32 wait_nr)
+{
+    while(!m_backlog.empty())
+    {
+        while(!m_backlog.empty() && m_sqe_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) < m_sq_entries)
+        {
+            m_sqes[m_sqe_tail & m_sq_mask] = m_backlog.front();
+            m_backlog.pop_front();
+            ++m_sqe_tail;
+        }
+
+        if(m_backlog.empty())
+        {
+            break;
+        }
+        
+        int32 ret = enter(0);
+
+        if(ret <= 0)
+        {
+            return ret;
+        }
+    }
+
+    return enter(wait_nr);
+}
+
+uint32 Uring::backlog()
+{
+    return m_backlog.size();
+}
+
+int32 Uring::enter(uint32 wait_nr)
+{
+    uint32 to_submit = m_sqe_tail - m_sq_submitted;
+    __atomic_store_n(m_sq_tail, m_sqe_tail, __ATOMIC_RELEASE);
+
+    //completions the full cq couldn't take wait in the kernel, only GETEVENTS moves them over once there's room
+    bool overflow = __atomic_load_n(m_sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW;
+    
+    if(to_submit == 0 && wait_nr == 0 && !overflow)
+    {
+        return 0;
+    }
+
+    uint32 flags = wait_nr > 0 || overflow ? IORING_ENTER_GETEVENTS : 0;
+    int32 ret = syscall(__NR_io_uring_enter, m_fd, to_submit, wait_nr, flags, NULL, 0);
+
+    if(ret < 0)
+    {
+        if(errno != EINTR && errno != EBUSY && errno != EAGAIN)
+        {
+            LOG_FATAL("io_uring_enter failed in Uring::enter: %s", strerror(errno));
+        }
+
+        return ret;
+    }
+
+    m_sq_submitted += ret;
+
+    return ret;
+}
+
+struct io_uring_cqe* Uring::peek_cqe()
+{
+    uint32 head = *m_cq_head;
+
+    if(head == __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE))
+    {
+        return nullptr;
+    }
+
+    return &m_cqes[head & m_cq_mask];
+}
+
+void Uring::cqe_seen()
+{
+    __atomic_store_n(m_cq_head, *m_cq_head + 1, __ATOMIC_RELEASE);
+}
+
+void Uring::prep_recv_multishot(int32 fd, uint64 user_data)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = m_buf_group;
+    sqe->user_data = user_data;
+}
+
+void Uring::prep_accept_multishot(int32 fd, uint64 user_data)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK;
+    sqe->user_data = user_data;
+}
+
+//multishot: a cqe for every readiness change until cancelled, IORING_CQE_F_MORE is cleared on the last one
+void Uring::prep_poll(int32 fd, uint32 events, bool multishot, uint64 user_data)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+}
+
+void Uring::prep_writev(int32 fd, const struct iovec *iov, uint32 count, uint64 user_data)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = (uint64)iov;
+    sqe->len = count;
+    sqe->user_data = user_data;
+}
+
+void Uring::prep_read(int32 fd, void *buf, uint32 size, uint64 user_data)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64)buf;
+    sqe->len = size;
+    sqe->user_data = user_data;
+}
+
+//post a cqe carrying target_user_data into another ring, no eventfd involved
+void Uring::prep_msg_ring(int32 ring_fd, uint64 target_user_data, uint64 user_data)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_MSG_RING;
+    sqe->fd = ring_fd;
+    sqe->addr = IORING_MSG_DATA;
+    sqe->off = target_user_data;
+    sqe->user_data = user_data;
+}
+
+void Uring::prep_cancel(uint64 target_user_data, uint64 user_data)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target_user_data;
+    sqe->user_data = user_data;
+}
+
+//relative timeout, ts must stay valid until the cqe (-ETIME) arrives
+void Uring::prep_timeout(struct __kernel_timespec *ts, uint64 user_data)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64)ts;
+    sqe->len = 1;
+    sqe->user_data = user_data;
+}
+
+Uring* Uring::current()
+{
+    return t_current_uring;
+}
+
+void Uring::current(Uring *uring)
+{
+    t_current_uring = uring;
+}
+
+uint64 Uring::pack(void *ptr, URING_TAG tag)
+{
+    return (uint64)ptr | tag;
+}
+
+void* Uring::unpack_ptr(uint64 user_data)
+{
+    return (void*)(user_data & ~(uint64)7);
+}
+
+URING_TAG Uring::unpack_tag(uint64 user_data)
+{
+    return (URING_TAG)(user_data & 7);
+}
+
+}
+}
@@ -0,0 +1,133 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 10:05:37                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef FLY__NET__URING
+#define FLY__NET__URING
+
+#include <deque>
+#include <functional>
+#include <vector>
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include "fly/base/common.hpp"
+
+namespace fly {
+namespace net {
+
+class Message_Chunk;
+
+//low 3 bits of user_data, the rest is the pointer of the owner (8 bytes aligned)
+enum URING_TAG
+{
+    URING_TAG_RECV = 0,
+    URING_TAG_SEND = 1,
+    URING_TAG_ACCEPT = 2,
+    URING_TAG_WAKE = 3,
+    URING_TAG_EVENTFD = 4,
+    URING_TAG_IGNORE = 5,
+    URING_TAG_TIMEOUT = 6,
+    URING_TAG_POLL = 7
+};
+
+//the owner of a poll request (URING_TAG_POLL), cb gets the res and flags of each cqe
+struct Uring_Poll
+{
+    std::function<void(int32, uint32)> m_cb;
+};
+
+//io_uring state of one connection, only touched by the owning poller thread
+struct Uring_Context
+{
+    ~Uring_Context();
+    uint32 m_pending_ops = 0;
+    bool m_sending = false;
+    bool m_recv_stopped = false;
+    bool m_recv_cancelling = false;
+    std::vector<Message_Chunk*> m_send_chunks;
+    std::vector<struct iovec> m_send_iov;
+};
+
+//minimal io_uring wrapper on top of the raw syscalls
+class Uring
+{
+public:
+    Uring() = default;
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+    ~Uring();
+    bool init(uint32 entries);
+    bool init_buf_ring(uint16 group_id, uint32 count, uint32 size);
+    int32 fd();
+    struct io_uring_sqe* get_sqe();
+    int32 submit();
+    int32 submit_and_wait(uint32 wait_nr);
+    uint32 backlog();
+    struct io_uring_cqe* peek_cqe();
+    void cqe_seen();
+    char* buf(uint16 bid);
+    void recycle_buf(uint16 bid);
+    void prep_recv_multishot(int32 fd, uint64 user_data);
+    void prep_accept_multishot(int32 fd, uint64 user_data);
+    void prep_poll(int32 fd, uint32 events, bool multishot, uint64 user_data);
+    void prep_writev(int32 fd, const struct iovec *iov, uint32 count, uint64 user_data);
+    void prep_read(int32 fd, void *buf, uint32 size, uint64 user_data);
+    void prep_msg_ring(int32 ring_fd, uint64 target_user_data, uint64 user_data);
+    void prep_cancel(uint64 target_user_data, uint64 user_data);
+    void prep_timeout(struct __kernel_timespec *ts, uint64 user_data);
+    static Uring* current();
+    static void current(Uring *uring);
+    static uint64 pack(void *ptr, URING_TAG tag);
+    static void* unpack_ptr(uint64 user_data);
+    static URING_TAG unpack_tag(uint64 user_data);
+    
+private:
+    int32 enter(uint32 wait_nr);
+    int32 m_fd = -1;
+    uint32 m_sq_entries = 0;
+    uint32 m_sq_mask = 0;
+    uint32 m_cq_mask = 0;
+    uint32 m_sqe_tail = 0;
+    uint32 m_sq_submitted = 0;
+    std::deque<struct io_uring_sqe> m_backlog;
+    uint32 *m_sq_head = nullptr;
+    uint32 *m_sq_tail = nullptr;
+    uint32 *m_sq_flags = nullptr;
+    uint32 *m_cq_head = nullptr;
+    uint32 *m_cq_tail = nullptr;
+    struct io_uring_sqe *m_sqes = nullptr;
+    struct io_uring_cqe *m_cqes = nullptr;
+    void *m_sq_ring = nullptr;
+    void *m_cq_ring = nullptr;
+    uint32 m_sq_ring_size = 0;
+    uint32 m_cq_ring_size = 0;
+    uint32 m_sqes_size = 0;
+    struct io_uring_buf *m_buf_ring = nullptr;
+    uint32 m_buf_ring_size = 0;
+    uint32 m_buf_mask = 0;
+    uint32 m_buf_size = 0;
+    uint16 m_buf_group = 0;
+    char *m_bufs = nullptr;
+};
+
+}
+}
+
+#endif
@@ -20,6 +20,8 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "fly/task/executor.hpp"
+#include "fly/base/cpu_topology.hpp"
+#include "fly/base/logger.hpp"
 
 namespace fly {
 namespace task {
@@ -30,6 +32,12 @@ Executor::Executor()
 
 void Executor::run()
 {
+    //pinned before any task runs, so what the tasks allocate from here on is local to the cpus
+    if(!m_cpus.empty() && !fly::base::pin_thread(m_cpus))
+    {
+        LOG_ERROR("pin_thread failed in Executor::run");
+    }
+    
     while(auto *task = m_tasks.pop())
     {
         bool stop_executor = task->m_stop_executor;
@@ -48,6 +56,12 @@ void Executor::add_task(Task *task)
     m_tasks.push(task);
 }
 
+//call it before start
+void Executor::set_cpus(const std::vector<uint32> &cpus)
+{
+    m_cpus = cpus;
+}
+
 void Executor::start()
 {
     std::thread tmp(std::bind(&Executor::run, this));
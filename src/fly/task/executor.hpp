@@ -23,6 +23,7 @@
 #define FLY__TASK__EXECUTOR
 
 #include <thread>
+#include <vector>
 #include "fly/base/common.hpp"
 #include "fly/base/block_queue.hpp"
 #include "fly/task/task.hpp"
@@ -38,9 +39,11 @@ public:
     void start();
     void wait();
     void add_task(Task *task);
+    void set_cpus(const std::vector<uint32> &cpus);
     
 private:
     std::thread m_thread;
+    std::vector<uint32> m_cpus;
     fly::base::Block_Queue<Task*> m_tasks;
 };
 
@@ -24,11 +24,19 @@
 namespace fly {
 namespace task {
 
-Scheduler::Scheduler(uint32 num)
+//executor i is pinned to cpu_sets[i % cpu_sets.size()], no pinning if cpu_sets is empty
+Scheduler::Scheduler(uint32 num, const std::vector<std::vector<uint32>> &cpu_sets)
 {
     for(uint32 i = 0; i < num; ++i)
     {
-        m_executors.push_back(new Executor);
+        auto *executor = new Executor;
+
+        if(!cpu_sets.empty())
+        {
+            executor->set_cpus(cpu_sets[i % cpu_sets.size()]);
+        }
+        
+        m_executors.push_back(executor);
     }
 
     m_executor_num = num;
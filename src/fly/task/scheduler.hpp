@@ -31,7 +31,7 @@ namespace task {
 class Scheduler
 {
 public:
-    Scheduler(uint32 num);
+    Scheduler(uint32 num, const std::vector<std::vector<uint32>> &cpu_sets = {});
     void schedule_task(Task *task);
     void start();
     void stop();
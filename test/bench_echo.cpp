@@ -0,0 +1,214 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 11:20:05                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//usage: bench_echo [epoll|uring] [connections] [seconds] [msg_size] [reuse_port] [spin_us]
+//run it under `strace -c -f` to compare the syscall counts of the two backends
+//spin_us > 0 makes the pollers of both sides busy poll for that long after each batch
+
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <sys/resource.h>
+#include "fly/init.hpp"
+#include "fly/net/server.hpp"
+#include "fly/net/client.hpp"
+#include "fly/base/logger.hpp"
+
+using namespace std::placeholders;
+using fly::net::Json;
+
+class Bench_Echo : public fly::base::Singleton<Bench_Echo>
+{
+public:
+    static uint64 now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    bool server_init(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+        return true;
+    }
+    
+    void server_dispatch(std::unique_ptr<fly::net::Message<Json>> message)
+    {
+        const std::string &data = message->raw_data();
+        message->get_connection()->send(data.data(), data.length());
+    }
+
+    bool client_init(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+        uint32 idx = m_connected.fetch_add(1, std::memory_order_relaxed);
+        connection->key(fly::base::to_string(idx));
+        m_send_time[idx] = now_ns();
+        connection->send(m_payload.data(), m_payload.length());
+
+        return true;
+    }
+    
+    //each connection is served by one poller thread, so its m_send_time slot isn't shared
+    void client_dispatch(std::unique_ptr<fly::net::Message<Json>> message)
+    {
+        std::shared_ptr<fly::net::Connection<Json>> connection = message->get_connection();
+        uint32 idx = 0;
+        fly::base::string_to(connection->key(), idx);
+        uint64 now = now_ns();
+        uint64 latency_us = (now - m_send_time[idx]) / 1000;
+        uint32 bucket = 0;
+
+        while(bucket < 31 && (1ULL << bucket) <= latency_us)
+        {
+            ++bucket;
+        }
+        
+        m_latency_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_latency_sum_us.fetch_add(latency_us, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+
+        if(m_running.load(std::memory_order_relaxed))
+        {
+            m_send_time[idx] = now;
+            connection->send(m_payload.data(), m_payload.length());
+        }
+    }
+    
+    void close(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+    }
+    
+    void be_closed(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+        CONSOLE_LOG_INFO("connection from %s:%d be closed", connection->peer_addr().host().c_str(), connection->peer_addr().port());
+    }
+    
+    uint32 percentile_us(uint64 total, uint32 percent)
+    {
+        uint64 count = 0;
+
+        for(uint32 i = 0; i < 32; ++i)
+        {
+            count += m_latency_buckets[i].load(std::memory_order_relaxed);
+
+            if(count * 100 >= total * percent)
+            {
+                return 1U << i;
+            }
+        }
+
+        return 1U << 31;
+    }
+    
+    void main(int argc, char **argv)
+    {
+        std::string backend_name = argc > 1 ? argv[1] : "epoll";
+        uint32 conn_num = argc > 2 ? atoi(argv[2]) : 64;
+        uint32 seconds = argc > 3 ? atoi(argv[3]) : 5;
+        uint32 msg_size = argc > 4 ? atoi(argv[4]) : 64;
+        bool reuse_port = argc > 5 && std::string(argv[5]) == "reuse_port";
+        uint32 spin_us = argc > 6 ? atoi(argv[6]) : 0;
+        fly::net::POLLER_BACKEND backend = backend_name == "uring" ? fly::net::POLLER_URING : fly::net::POLLER_EPOLL;
+        m_payload = "{\"msg_type\":1,\"msg_cmd\":1,\"data\":\"";
+        m_payload.append(msg_size > m_payload.length() + 2 ? msg_size - m_payload.length() - 2 : 0, 'x');
+        m_payload += "\"}";
+        m_send_time.resize(conn_num);
+        
+        //init library
+        fly::init();
+        
+        //init logger
+        fly::base::Logger::instance()->init(fly::base::ERROR, "bench_echo", "./log/");
+        std::shared_ptr<fly::net::Poller<Json>> server_poller(new fly::net::Poller<Json>(2, backend));
+        server_poller->set_spin(spin_us);
+        server_poller->start();
+        std::unique_ptr<fly::net::Server<Json>> server(new fly::net::Server<Json>(fly::net::Addr("127.0.0.1", 8089),
+                                                                      std::bind(&Bench_Echo::server_init, this, _1),
+                                                                      std::bind(&Bench_Echo::server_dispatch, this, _1),
+                                                                      std::bind(&Bench_Echo::close, this, _1),
+                                                                      std::bind(&Bench_Echo::be_closed, this, _1),
+                                                                      server_poller, 1024 * 1024 * 1024, reuse_port));
+        
+        if(!server->start())
+        {
+            CONSOLE_LOG_FATAL("start server failed");
+            
+            return;
+        }
+        
+        std::shared_ptr<fly::net::Poller<Json>> poller(new fly::net::Poller<Json>(2, backend));
+        poller->set_spin(spin_us);
+        poller->start();
+        
+        for(uint32 i = 0; i < conn_num; ++i)
+        {
+            fly::net::Client<Json> client(fly::net::Addr("127.0.0.1", 8089),
+                                          std::bind(&Bench_Echo::client_init, this, _1),
+                                          std::bind(&Bench_Echo::client_dispatch, this, _1),
+                                          std::bind(&Bench_Echo::close, this, _1),
+                                          std::bind(&Bench_Echo::be_closed, this, _1),
+                                          poller);
+            
+            if(!client.connect(1000))
+            {
+                CONSOLE_LOG_FATAL("connect to server failed");
+                _exit(1);
+            }
+        }
+
+        struct rusage usage_begin, usage_end;
+        getrusage(RUSAGE_SELF, &usage_begin);
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        m_running.store(false, std::memory_order_relaxed);
+        getrusage(RUSAGE_SELF, &usage_end);
+        uint64 total = m_count.load(std::memory_order_relaxed);
+        
+        if(total == 0)
+        {
+            CONSOLE_LOG_FATAL("no message echoed");
+            _exit(1);
+        }
+        
+        std::cout << "backend: " << backend_name << ", connections: " << conn_num << ", msg_size: " << m_payload.length()
+                  << (reuse_port ? ", reuse_port" : "") << ", spin_us: " << spin_us << std::endl;
+        std::cout << "msgs/s: " << total / seconds << ", avg latency: " << m_latency_sum_us.load(std::memory_order_relaxed) / total << "us"
+                  << ", p50 < " << percentile_us(total, 50) << "us, p99 < " << percentile_us(total, 99) << "us" << std::endl;
+        std::cout << "context switches: voluntary " << usage_end.ru_nvcsw - usage_begin.ru_nvcsw << ", involuntary "
+                  << usage_end.ru_nivcsw - usage_begin.ru_nivcsw << std::endl;
+        std::cout << "client sends: " << poller->send_count() << ", write wakeups: " << poller->write_wakeup_count() << std::endl;
+        std::cout << "poller spins: " << poller->spin_count() + server_poller->spin_count() << ", sleeps: "
+                  << poller->sleep_count() + server_poller->sleep_count() << std::endl;
+        _exit(0);
+    }
+    
+private:
+    std::string m_payload;
+    std::vector<uint64> m_send_time;
+    std::atomic<uint32> m_connected {0};
+    std::atomic<bool> m_running {true};
+    std::atomic<uint64> m_count {0};
+    std::atomic<uint64> m_latency_sum_us {0};
+    std::atomic<uint64> m_latency_buckets[32] {};
+};
+
+int main(int argc, char **argv)
+{
+    Bench_Echo::instance()->main(argc, argv);
+}
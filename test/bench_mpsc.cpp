@@ -0,0 +1,134 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 13:52:41                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//usage: bench_mpsc [max_producers] [messages]
+//pushes from 1, 2, 4 ... max_producers threads into one queue drained in bulk by a single consumer,
+//Lock_Queue vs MPSC_Queue
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <list>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include "fly/base/common.hpp"
+#include "fly/base/lock_queue.hpp"
+#include "fly/base/mpsc_queue.hpp"
+
+struct Lock_Queue_Adapter
+{
+    void push(uint64 value)
+    {
+        m_queue.push_direct(value);
+    }
+
+    uint32 pop()
+    {
+        std::list<uint64> queue;
+
+        return m_queue.pop(queue) ? queue.size() : 0;
+    }
+    
+    fly::base::Lock_Queue<uint64> m_queue;
+};
+
+struct MPSC_Queue_Adapter
+{
+    void push(uint64 value)
+    {
+        m_queue.push(value);
+    }
+
+    uint32 pop()
+    {
+        m_buf.clear();
+
+        return m_queue.pop(m_buf) ? m_buf.size() : 0;
+    }
+    
+    fly::base::MPSC_Queue<uint64> m_queue;
+    std::vector<uint64> m_buf;
+};
+
+//returns million messages per second
+template<typename Queue>
+double run(uint32 producer_num, uint64 message_num)
+{
+    Queue queue;
+    uint64 per_producer = message_num / producer_num;
+    uint64 total = per_producer * producer_num;
+    std::vector<std::thread> producers;
+    auto begin = std::chrono::steady_clock::now();
+    
+    for(uint32 i = 0; i < producer_num; ++i)
+    {
+        producers.emplace_back([&queue, per_producer]()
+        {
+            for(uint64 j = 0; j < per_producer; ++j)
+            {
+                queue.push(j);
+            }
+        });
+    }
+
+    uint64 count = 0;
+
+    while(count < total)
+    {
+        uint32 num = queue.pop();
+
+        if(num == 0)
+        {
+            std::this_thread::yield();
+        }
+
+        count += num;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    for(auto &producer : producers)
+    {
+        producer.join();
+    }
+
+    double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() / 1000000.0;
+
+    return total / seconds / 1000000;
+}
+
+int main(int argc, char **argv)
+{
+    uint32 max_producers = argc > 1 ? atoi(argv[1]) : 64;
+    uint64 message_num = argc > 2 ? atoll(argv[2]) : 4000000;
+    std::cout << "producers  lock_queue(M/s)  mpsc_queue(M/s)" << std::endl;
+    
+    for(uint32 producer_num = 1; producer_num <= max_producers; producer_num *= 2)
+    {
+        double lock_rate = run<Lock_Queue_Adapter>(producer_num, message_num);
+        double mpsc_rate = run<MPSC_Queue_Adapter>(producer_num, message_num);
+        std::cout << std::setw(9) << producer_num << std::fixed << std::setprecision(2)
+                  << std::setw(17) << lock_rate << std::setw(17) << mpsc_rate << std::endl;
+    }
+    
+    return 0;
+}
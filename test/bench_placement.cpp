@@ -0,0 +1,281 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 14:31:12                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//usage: bench_placement [round_robin|least_connections|least_cpu|peer_hash] [epoll|uring] [connections] [hot_connections] [seconds]
+//every poller_num-th connection is hot: each of its messages costs the server about HOT_WORK_US of cpu,
+//which stacks all of them on one server poller task with the id based placement. the latency of the cold
+//connections shows how much they suffer from sharing a poller task with the hot ones
+
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include "fly/init.hpp"
+#include "fly/net/server.hpp"
+#include "fly/net/client.hpp"
+#include "fly/base/logger.hpp"
+
+using namespace std::placeholders;
+using fly::net::Json;
+
+class Bench_Placement : public fly::base::Singleton<Bench_Placement>
+{
+public:
+    static const uint32 POLLER_NUM = 4;
+    static const uint32 HOT_WORK_US = 200;
+    
+    static uint64 now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    struct Latency
+    {
+        std::atomic<uint64> m_count {0};
+        std::atomic<uint64> m_buckets[32] {};
+
+        void add(uint64 latency_us)
+        {
+            uint32 bucket = 0;
+
+            while(bucket < 31 && (1ULL << bucket) <= latency_us)
+            {
+                ++bucket;
+            }
+
+            m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+            m_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        uint32 percentile_us(uint32 permille)
+        {
+            uint64 total = m_count.load(std::memory_order_relaxed);
+            uint64 count = 0;
+
+            for(uint32 i = 0; i < 32; ++i)
+            {
+                count += m_buckets[i].load(std::memory_order_relaxed);
+
+                if(count * 1000 >= total * permille)
+                {
+                    return 1U << i;
+                }
+            }
+
+            return 1U << 31;
+        }
+    };
+    
+    bool server_init(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+        return true;
+    }
+    
+    void server_dispatch(std::unique_ptr<fly::net::Message<Json>> message)
+    {
+        //a hot message burns some cpu before it's echoed
+        if(message->cmd() == 2)
+        {
+            uint64 end = now_ns() + HOT_WORK_US * 1000;
+
+            while(now_ns() < end)
+            {
+            }
+        }
+        
+        const std::string &data = message->raw_data();
+        message->get_connection()->send(data.data(), data.length());
+    }
+
+    bool client_init(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+        uint32 idx = m_connected.fetch_add(1, std::memory_order_relaxed);
+        connection->key(fly::base::to_string(idx));
+        m_send_time[idx] = now_ns();
+        send(connection, idx);
+        
+        return true;
+    }
+
+    bool is_hot(uint32 idx)
+    {
+        return idx % POLLER_NUM == 0 && idx / POLLER_NUM < m_hot_num;
+    }
+    
+    void send(std::shared_ptr<fly::net::Connection<Json>> connection, uint32 idx)
+    {
+        const std::string &payload = is_hot(idx) ? m_hot_payload : m_cold_payload;
+        connection->send(payload.data(), payload.length());
+    }
+    
+    void client_dispatch(std::unique_ptr<fly::net::Message<Json>> message)
+    {
+        std::shared_ptr<fly::net::Connection<Json>> connection = message->get_connection();
+        uint32 idx = 0;
+        fly::base::string_to(connection->key(), idx);
+        uint64 now = now_ns();
+        uint64 latency_us = (now - m_send_time[idx]) / 1000;
+
+        if(m_measuring.load(std::memory_order_relaxed))
+        {
+            (is_hot(idx) ? m_hot_latency : m_cold_latency).add(latency_us);
+        }
+        
+        if(m_running.load(std::memory_order_relaxed))
+        {
+            m_send_time[idx] = now;
+            send(connection, idx);
+        }
+    }
+    
+    void close(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+    }
+    
+    void be_closed(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+        CONSOLE_LOG_INFO("connection from %s:%d be closed", connection->peer_addr().host().c_str(), connection->peer_addr().port());
+    }
+    
+    void main(int argc, char **argv)
+    {
+        std::string policy_name = argc > 1 ? argv[1] : "round_robin";
+        std::string backend_name = argc > 2 ? argv[2] : "epoll";
+        uint32 conn_num = argc > 3 ? atoi(argv[3]) : 32;
+        m_hot_num = argc > 4 ? atoi(argv[4]) : 4;
+        uint32 seconds = argc > 5 ? atoi(argv[5]) : 5;
+        fly::net::POLLER_BACKEND backend = backend_name == "uring" ? fly::net::POLLER_URING : fly::net::POLLER_EPOLL;
+        fly::net::PLACEMENT_POLICY policy = fly::net::PLACEMENT_ROUND_ROBIN;
+
+        if(policy_name == "least_connections")
+        {
+            policy = fly::net::PLACEMENT_LEAST_CONNECTIONS;
+        }
+        else if(policy_name == "least_cpu")
+        {
+            policy = fly::net::PLACEMENT_LEAST_CPU;
+        }
+        else if(policy_name == "peer_hash")
+        {
+            policy = fly::net::PLACEMENT_PEER_HASH;
+        }
+        
+        m_cold_payload = "{\"msg_type\":1,\"msg_cmd\":1}";
+        m_hot_payload = "{\"msg_type\":1,\"msg_cmd\":2}";
+        m_send_time.resize(conn_num);
+        
+        //init library
+        fly::init();
+        
+        //init logger
+        fly::base::Logger::instance()->init(fly::base::ERROR, "bench_placement", "./log/");
+        std::shared_ptr<fly::net::Poller<Json>> server_poller(new fly::net::Poller<Json>(POLLER_NUM, backend, policy));
+        server_poller->start();
+        std::unique_ptr<fly::net::Server<Json>> server(new fly::net::Server<Json>(fly::net::Addr("127.0.0.1", 8090),
+                                                                      std::bind(&Bench_Placement::server_init, this, _1),
+                                                                      std::bind(&Bench_Placement::server_dispatch, this, _1),
+                                                                      std::bind(&Bench_Placement::close, this, _1),
+                                                                      std::bind(&Bench_Placement::be_closed, this, _1),
+                                                                      server_poller));
+        
+        if(!server->start())
+        {
+            CONSOLE_LOG_FATAL("start server failed");
+            
+            return;
+        }
+        
+        std::shared_ptr<fly::net::Poller<Json>> poller(new fly::net::Poller<Json>(2, backend));
+        poller->start();
+        
+        for(uint32 i = 0; i < conn_num; ++i)
+        {
+            fly::net::Client<Json> client(fly::net::Addr("127.0.0.1", 8090),
+                                          std::bind(&Bench_Placement::client_init, this, _1),
+                                          std::bind(&Bench_Placement::client_dispatch, this, _1),
+                                          std::bind(&Bench_Placement::close, this, _1),
+                                          std::bind(&Bench_Placement::be_closed, this, _1),
+                                          poller);
+            
+            if(!client.connect(1000))
+            {
+                CONSOLE_LOG_FATAL("connect to server failed");
+                _exit(1);
+            }
+
+            //let the cpu sample of the server see a hot connection before the next one arrives
+            if(is_hot(i))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            }
+        }
+
+        m_measuring.store(true, std::memory_order_relaxed);
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        m_running.store(false, std::memory_order_relaxed);
+        m_measuring.store(false, std::memory_order_relaxed);
+        uint64 cold_total = m_cold_latency.m_count.load(std::memory_order_relaxed);
+        uint64 hot_total = m_hot_latency.m_count.load(std::memory_order_relaxed);
+        
+        if(cold_total == 0)
+        {
+            CONSOLE_LOG_FATAL("no message echoed");
+            _exit(1);
+        }
+        
+        std::cout << "policy: " << policy_name << ", backend: " << backend_name << ", connections: " << conn_num
+                  << ", hot connections: " << m_hot_num << std::endl;
+        std::cout << "cold msgs/s: " << cold_total / seconds << ", p50 < " << m_cold_latency.percentile_us(500) << "us, p99 < "
+                  << m_cold_latency.percentile_us(990) << "us, p99.9 < " << m_cold_latency.percentile_us(999) << "us" << std::endl;
+
+        if(hot_total > 0)
+        {
+            std::cout << "hot msgs/s: " << hot_total / seconds << ", p50 < " << m_hot_latency.percentile_us(500) << "us, p99 < "
+                      << m_hot_latency.percentile_us(990) << "us" << std::endl;
+        }
+        
+        std::vector<fly::net::Poller_Load> loads = server_poller->loads();
+
+        for(uint32 i = 0; i < loads.size(); ++i)
+        {
+            std::cout << "server poller task " << i << ": connections " << loads[i].m_connection_num << ", cpu " << loads[i].m_cpu_us / 1000
+                      << "ms" << std::endl;
+        }
+        
+        _exit(0);
+    }
+    
+private:
+    std::string m_cold_payload;
+    std::string m_hot_payload;
+    uint32 m_hot_num = 0;
+    std::vector<uint64> m_send_time;
+    std::atomic<uint32> m_connected {0};
+    std::atomic<bool> m_running {true};
+    std::atomic<bool> m_measuring {false};
+    Latency m_cold_latency;
+    Latency m_hot_latency;
+};
+
+int main(int argc, char **argv)
+{
+    Bench_Placement::instance()->main(argc, argv);
+}
@@ -0,0 +1,237 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 15:20:44                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//usage: bench_uds [epoll|uring] [connections] [seconds] [msg_size] [unix_path]
+//runs the same ping-pong echo over tcp loopback (ipv4 and ipv6) and over a unix socket, one after the other
+//a unix_path starting with @ is in the abstract namespace
+
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <sys/resource.h>
+#include "fly/init.hpp"
+#include "fly/net/server.hpp"
+#include "fly/net/client.hpp"
+#include "fly/base/logger.hpp"
+
+using namespace std::placeholders;
+using fly::net::Json;
+
+class Bench_Uds : public fly::base::Singleton<Bench_Uds>
+{
+public:
+    static uint64 now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    bool server_init(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+        return true;
+    }
+    
+    void server_dispatch(std::unique_ptr<fly::net::Message<Json>> message)
+    {
+        const std::string &data = message->raw_data();
+        message->get_connection()->send(data.data(), data.length());
+    }
+
+    bool client_init(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+        uint32 idx = m_connected.fetch_add(1, std::memory_order_relaxed);
+        connection->key(fly::base::to_string(idx));
+        m_send_time[idx] = now_ns();
+        connection->send(m_payload.data(), m_payload.length());
+
+        return true;
+    }
+    
+    //each connection is served by one poller thread, so its m_send_time slot isn't shared
+    void client_dispatch(std::unique_ptr<fly::net::Message<Json>> message)
+    {
+        std::shared_ptr<fly::net::Connection<Json>> connection = message->get_connection();
+        uint32 idx = 0;
+        fly::base::string_to(connection->key(), idx);
+        uint64 now = now_ns();
+        uint64 latency_us = (now - m_send_time[idx]) / 1000;
+        uint32 bucket = 0;
+
+        while(bucket < 31 && (1ULL << bucket) <= latency_us)
+        {
+            ++bucket;
+        }
+        
+        m_latency_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_latency_sum_us.fetch_add(latency_us, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+
+        if(m_running.load(std::memory_order_relaxed))
+        {
+            m_send_time[idx] = now;
+            connection->send(m_payload.data(), m_payload.length());
+        }
+    }
+    
+    void close(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+    }
+    
+    void be_closed(std::shared_ptr<fly::net::Connection<Json>> connection)
+    {
+        CONSOLE_LOG_INFO("connection from %s be closed", connection->peer_addr().to_string().c_str());
+    }
+    
+    uint32 percentile_us(uint64 total, uint32 percent)
+    {
+        uint64 count = 0;
+
+        for(uint32 i = 0; i < 32; ++i)
+        {
+            count += m_latency_buckets[i].load(std::memory_order_relaxed);
+
+            if(count * 100 >= total * percent)
+            {
+                return 1U << i;
+            }
+        }
+
+        return 1U << 31;
+    }
+
+    //one echo round over addr, every round has its own pollers so nothing is left over from the previous one
+    void run(const fly::net::Addr &addr)
+    {
+        m_connected.store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+        m_latency_sum_us.store(0, std::memory_order_relaxed);
+
+        for(auto &bucket : m_latency_buckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        
+        m_running.store(true, std::memory_order_relaxed);
+        std::shared_ptr<fly::net::Poller<Json>> server_poller(new fly::net::Poller<Json>(2, m_backend));
+        server_poller->start();
+        
+        //the servers are kept alive until exit, the connections of the finished rounds just idle
+        fly::net::Server<Json> *server = new fly::net::Server<Json>(addr,
+                                                                    std::bind(&Bench_Uds::server_init, this, _1),
+                                                                    std::bind(&Bench_Uds::server_dispatch, this, _1),
+                                                                    std::bind(&Bench_Uds::close, this, _1),
+                                                                    std::bind(&Bench_Uds::be_closed, this, _1),
+                                                                    server_poller);
+        
+        if(!server->start())
+        {
+            CONSOLE_LOG_FATAL("start server on %s failed", addr.to_string().c_str());
+            
+            return;
+        }
+        
+        std::shared_ptr<fly::net::Poller<Json>> poller(new fly::net::Poller<Json>(2, m_backend));
+        poller->start();
+        m_pollers.push_back(server_poller);
+        m_pollers.push_back(poller);
+        
+        for(uint32 i = 0; i < m_conn_num; ++i)
+        {
+            fly::net::Client<Json> client(addr,
+                                          std::bind(&Bench_Uds::client_init, this, _1),
+                                          std::bind(&Bench_Uds::client_dispatch, this, _1),
+                                          std::bind(&Bench_Uds::close, this, _1),
+                                          std::bind(&Bench_Uds::be_closed, this, _1),
+                                          poller);
+            
+            if(!client.connect(1000))
+            {
+                CONSOLE_LOG_FATAL("connect to %s failed", addr.to_string().c_str());
+                _exit(1);
+            }
+        }
+
+        struct rusage usage_begin, usage_end;
+        getrusage(RUSAGE_SELF, &usage_begin);
+        std::this_thread::sleep_for(std::chrono::seconds(m_seconds));
+        m_running.store(false, std::memory_order_relaxed);
+        getrusage(RUSAGE_SELF, &usage_end);
+        uint64 total = m_count.load(std::memory_order_relaxed);
+        uint64 cpu_us = (usage_end.ru_utime.tv_sec - usage_begin.ru_utime.tv_sec + usage_end.ru_stime.tv_sec - usage_begin.ru_stime.tv_sec) * 1000000
+                        + usage_end.ru_utime.tv_usec - usage_begin.ru_utime.tv_usec + usage_end.ru_stime.tv_usec - usage_begin.ru_stime.tv_usec;
+        
+        //let the last round trips of this round finish before the next one starts
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        
+        if(total == 0)
+        {
+            CONSOLE_LOG_FATAL("no message echoed over %s", addr.to_string().c_str());
+            _exit(1);
+        }
+        
+        std::cout << addr.to_string() << ": msgs/s: " << total / m_seconds << ", avg latency: "
+                  << m_latency_sum_us.load(std::memory_order_relaxed) / total << "us, p50 < " << percentile_us(total, 50)
+                  << "us, p99 < " << percentile_us(total, 99) << "us, cpu per msg: " << cpu_us * 1000 / total << "ns" << std::endl;
+    }
+    
+    void main(int argc, char **argv)
+    {
+        std::string backend_name = argc > 1 ? argv[1] : "epoll";
+        m_conn_num = argc > 2 ? atoi(argv[2]) : 64;
+        m_seconds = argc > 3 ? atoi(argv[3]) : 5;
+        uint32 msg_size = argc > 4 ? atoi(argv[4]) : 64;
+        std::string unix_path = argc > 5 ? argv[5] : "@fly_bench_uds";
+        m_backend = backend_name == "uring" ? fly::net::POLLER_URING : fly::net::POLLER_EPOLL;
+        m_payload = "{\"msg_type\":1,\"msg_cmd\":1,\"data\":\"";
+        m_payload.append(msg_size > m_payload.length() + 2 ? msg_size - m_payload.length() - 2 : 0, 'x');
+        m_payload += "\"}";
+        m_send_time.resize(m_conn_num);
+        
+        //init library
+        fly::init();
+        
+        //init logger
+        fly::base::Logger::instance()->init(fly::base::ERROR, "bench_uds", "./log/");
+        std::cout << "backend: " << backend_name << ", connections: " << m_conn_num << ", msg_size: " << m_payload.length() << std::endl;
+        run(fly::net::Addr("127.0.0.1", 8091));
+        run(fly::net::Addr("::1", 8091));
+        run(fly::net::Addr::unix_socket(unix_path));
+        _exit(0);
+    }
+    
+private:
+    fly::net::POLLER_BACKEND m_backend;
+    uint32 m_conn_num = 0;
+    uint32 m_seconds = 0;
+    std::string m_payload;
+    std::vector<uint64> m_send_time;
+    std::vector<std::shared_ptr<fly::net::Poller<Json>>> m_pollers;
+    std::atomic<uint32> m_connected {0};
+    std::atomic<bool> m_running {true};
+    std::atomic<uint64> m_count {0};
+    std::atomic<uint64> m_latency_sum_us {0};
+    std::atomic<uint64> m_latency_buckets[32] {};
+};
+
+int main(int argc, char **argv)
+{
+    Bench_Uds::instance()->main(argc, argv);
+}
@@ -48,12 +48,12 @@ public:
     
     void close(std::shared_ptr<fly::net::Connection<Json>> connection)
     {
-        CONSOLE_LOG_INFO("close connection from %s:%d", connection->peer_addr().m_host.c_str(), connection->peer_addr().m_port);
+        CONSOLE_LOG_INFO("close connection from %s:%d", connection->peer_addr().host().c_str(), connection->peer_addr().port());
     }
     
     void be_closed(std::shared_ptr<fly::net::Connection<Json>> connection)
     {
-        CONSOLE_LOG_INFO("connection from %s:%d be closed", connection->peer_addr().m_host.c_str(), connection->peer_addr().m_port);
+        CONSOLE_LOG_INFO("connection from %s:%d be closed", connection->peer_addr().host().c_str(), connection->peer_addr().port());
     }
     
     void main()
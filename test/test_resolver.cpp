@@ -0,0 +1,157 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                    _______    _                                     *
+ *                   (  ____ \  ( \     |\     /|                      * 
+ *                   | (    \/  | (     ( \   / )                      *
+ *                   | (__      | |      \ (_) /                       *
+ *                   |  __)     | |       \   /                        *
+ *                   | (        | |        ) (                         *
+ *                   | )        | (____/\  | |                         *
+ *                   |/         (_______/  \_/                         *
+ *                                                                     *
+ *                                                                     *
+ *     fly is an awesome c++11 network library.                        *
+ *                                                                     *
+ *   @author: lichuan                                                  *
+ *   @qq: 308831759                                                    *
+ *   @email: 308831759@qq.com                                          *
+ *   @github: https://github.com/lichuan/fly                           *
+ *   @date: 2026-10-18 17:58:36                                        *
+ *                                                                     *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+//usage: test_resolver
+//checks Resolver against a stub lookup, no network needed: concurrent lookups of one name share a query,
+//failures are cached for the negative ttl, names in use are refreshed in the background, expired names are
+//swept out and queued callers get EAI_AGAIN when the resolver goes away
+
+#include <netdb.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <iostream>
+#include "fly/init.hpp"
+#include "fly/net/resolver.hpp"
+#include "fly/base/logger.hpp"
+
+std::atomic<uint32> g_lookup_num {0};
+
+//backend.test is 127.0.0.1, the other names don't exist. each query takes 50ms
+int32 stub_lookup(const std::string &host, uint16 port, std::vector<fly::net::Addr> &addrs)
+{
+    ++g_lookup_num;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    if(host != "backend.test")
+    {
+        return EAI_NONAME;
+    }
+
+    addrs.push_back(fly::net::Addr("127.0.0.1", port));
+
+    return 0;
+}
+
+bool check(bool ok, const std::string &what)
+{
+    std::cout << (ok ? "ok      " : "FAILED  ") << what << std::endl;
+
+    return ok;
+}
+
+int main()
+{
+    fly::init();
+    fly::base::Logger::instance()->init(fly::base::INFO, "test_resolver", "./log/");
+    bool ok = true;
+    
+    {
+        fly::net::Resolver resolver(2, 1000, 200);
+        resolver.set_lookup(stub_lookup);
+        std::atomic<uint32> done {0};
+        std::atomic<uint32> good {0};
+        std::vector<std::thread> threads;
+
+        for(uint32 i = 0; i < 8; ++i)
+        {
+            threads.emplace_back([&]
+            {
+                for(uint32 j = 0; j < 16; ++j)
+                {
+                    resolver.resolve("backend.test", 80, [&](int32 error, const std::vector<fly::net::Addr> &addrs)
+                    {
+                        if(error == 0 && addrs.size() == 1 && addrs[0].port() == 80)
+                        {
+                            ++good;
+                        }
+
+                        ++done;
+                    });
+                }
+            });
+        }
+
+        for(auto &thread : threads)
+        {
+            thread.join();
+        }
+
+        while(done < 128)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        ok &= check(good == 128 && resolver.query_count() == 1 && resolver.coalesced_count() + resolver.hit_count() == 127,
+                    "128 concurrent lookups of one name coalesced into one query");
+
+        std::vector<fly::net::Addr> addrs;
+        ok &= check(resolver.resolve("nope.test", 80, addrs) == EAI_NONAME && resolver.resolve("nope.test", 80, addrs) == EAI_NONAME
+                    && resolver.query_count() == 2, "a failure is cached");
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        ok &= check(resolver.resolve("nope.test", 80, addrs) == EAI_NONAME && resolver.query_count() == 3,
+                    "a failure is queried again after the negative ttl");
+
+        //used every 100ms for 2s, the last quarter of each 1s ttl is hit and the name never expires
+        uint64 miss_num = resolver.miss_count();
+        bool served = true;
+        
+        for(uint32 i = 0; i < 20; ++i)
+        {
+            addrs.clear();
+            served &= resolver.resolve("backend.test", 80, addrs) == 0 && addrs.size() == 1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        ok &= check(served && resolver.refresh_count() >= 2 && resolver.miss_count() == miss_num,
+                    "a name in use is refreshed in the background");
+
+        //nope.test expired long ago, the next completed lookup sweeps it out
+        resolver.resolve("other.test", 80, addrs);
+        ok &= check(resolver.size() == 2, "expired names are swept out");
+    }
+
+    {
+        std::atomic<uint32> again {0};
+        
+        {
+            fly::net::Resolver resolver(1);
+            resolver.set_lookup(stub_lookup);
+
+            for(uint32 i = 0; i < 10; ++i)
+            {
+                resolver.resolve("queued" + std::to_string(i) + ".test", 80, [&](int32 error, const std::vector<fly::net::Addr>&)
+                {
+                    if(error == EAI_AGAIN)
+                    {
+                        ++again;
+                    }
+                });
+            }
+        }
+
+        ok &= check(again >= 9, "queued callers get EAI_AGAIN when the resolver is destroyed");
+    }
+
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+
+    return ok ? 0 : 1;
+}
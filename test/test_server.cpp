@@ -44,12 +44,12 @@ public:
     {
         std::shared_ptr<fly::net::Connection<Json>> connection = message->get_connection();
         const fly::net::Addr &addr = connection->peer_addr();
-        CONSOLE_LOG_INFO("recv message from %s:%d raw_data: %s", addr.m_host.c_str(), addr.m_port, message->raw_data().c_str());
+        CONSOLE_LOG_INFO("recv message from %s:%d raw_data: %s", addr.host().c_str(), addr.port(), message->raw_data().c_str());
     }
     
     void close(std::shared_ptr<fly::net::Connection<Json>> connection)
     {
-        CONSOLE_LOG_INFO("close connection from %s:%d", connection->peer_addr().m_host.c_str(), connection->peer_addr().m_port);
+        CONSOLE_LOG_INFO("close connection from %s:%d", connection->peer_addr().host().c_str(), connection->peer_addr().port());
         std::lock_guard<std::mutex> guard(m_mutex);
         m_connections.erase(connection->id());
         CONSOLE_LOG_INFO("connection count: %u", m_connections.size());
@@ -57,7 +57,7 @@ public:
     
     void be_closed(std::shared_ptr<fly::net::Connection<Json>> connection)
     {
-        CONSOLE_LOG_INFO("connection from %s:%d be closed", connection->peer_addr().m_host.c_str(), connection->peer_addr().m_port);
+        CONSOLE_LOG_INFO("connection from %s:%d be closed", connection->peer_addr().host().c_str(), connection->peer_addr().port());
         std::lock_guard<std::mutex> guard(m_mutex);
         m_connections.erase(connection->id());
         CONSOLE_LOG_INFO("connection count: %u", m_connections.size());